@@ -0,0 +1,262 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// clcl_bench.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// clcl_bench: runs the samples on the headless backend and collects their
+// frame time reports (CLCL_BENCH) into one JSON document.
+//
+//   usage: clcl_bench [options] [sample ...]
+//     --frames N        measured frames per run (default 1000)
+//     --warmup N        frames before measuring (default 30)
+//     --scales A,B,...  draw callback repetitions per eye, one run each (default 1)
+//     --resolution WxH  render target size per eye
+//     --replay FILE     drive the runs by a recorded session instead of
+//                       synthetic poses (replayed as fast as possible)
+//     --bin DIR         directory of the sample executables (default "bin")
+//     --out FILE        output file (default: standard output)
+//
+//   Each run is a separate process of the sample, so every sample starts
+//   from a clean state. The samples are the ones of CLCL_openvr.sln unless
+//   given on the command line.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static const char* s_DefaultSamples[] = {
+	"triangle", "snowfall", "snowfall_nav", "solar_system", "sword", "sword2"
+};
+
+static const char* REPORT_FILE = "clcl_bench_run.json";
+
+static void SetEnv(const char* name, const std::string& value)
+{
+#ifdef _WIN32
+	_putenv_s(name, value.c_str());
+#else
+	setenv(name, value.c_str(), 1);
+#endif // _WIN32
+}
+
+static bool ReadFile(const char* path, std::string& text)
+{
+	FILE* file = fopen(path, "rb");
+	if (file == nullptr) return false;
+
+	char buffer[4096];
+	size_t size;
+	text.clear();
+	while ((size = fread(buffer, 1, sizeof(buffer), file)) > 0)
+	{
+		text.append(buffer, size);
+	}
+	fclose(file);
+
+	// the report ends with a newline; it is nested in the output
+	while (!text.empty() && (text.back() == '\n' || text.back() == '\r'))
+	{
+		text.pop_back();
+	}
+	return !text.empty();
+}
+
+static std::string Indent(const std::string& text, const char* indent)
+{
+	std::string result;
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		result += text[i];
+		if (text[i] == '\n')
+		{
+			result += indent;
+		}
+	}
+	return result;
+}
+
+// a JSON string (paths on Windows contain backslashes)
+static std::string Quote(const std::string& text)
+{
+	std::string result = "\"";
+	for (size_t i = 0; i < text.size(); i++)
+	{
+		if (text[i] == '"' || text[i] == '\\')
+		{
+			result += '\\';
+		}
+		result += text[i];
+	}
+	return result + "\"";
+}
+
+static void Usage()
+{
+	fprintf(stderr, "usage: clcl_bench [--frames N] [--warmup N] [--scales A,B,...] [--resolution WxH]\n");
+	fprintf(stderr, "                  [--replay FILE] [--bin DIR] [--out FILE] [sample ...]\n");
+}
+
+int main(int argc, char** argv)
+{
+	long long frames = 1000;
+	long long warmup = 30;
+	std::vector<int> scales;
+	std::string resolution;
+	std::string replay;
+	std::string binDir = "bin";
+	std::string outPath;
+	std::vector<std::string> samples;
+
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		bool hasValue = i + 1 < argc;
+		if (arg == "--frames" && hasValue)
+		{
+			frames = atoll(argv[++i]);
+		}
+		else if (arg == "--warmup" && hasValue)
+		{
+			warmup = atoll(argv[++i]);
+		}
+		else if (arg == "--scales" && hasValue)
+		{
+			std::string list = argv[++i];
+			size_t begin = 0;
+			while (begin <= list.size())
+			{
+				size_t end = list.find(',', begin);
+				if (end == std::string::npos) end = list.size();
+				int scale = atoi(list.substr(begin, end - begin).c_str());
+				if (scale > 0) scales.push_back(scale);
+				begin = end + 1;
+			}
+		}
+		else if (arg == "--resolution" && hasValue)
+		{
+			resolution = argv[++i];
+		}
+		else if (arg == "--replay" && hasValue)
+		{
+			replay = argv[++i];
+		}
+		else if (arg == "--bin" && hasValue)
+		{
+			binDir = argv[++i];
+		}
+		else if (arg == "--out" && hasValue)
+		{
+			outPath = argv[++i];
+		}
+		else if (arg.compare(0, 2, "--") == 0)
+		{
+			Usage();
+			return EXIT_FAILURE;
+		}
+		else
+		{
+			samples.push_back(arg);
+		}
+	}
+	if (frames <= 0 || warmup < 0)
+	{
+		Usage();
+		return EXIT_FAILURE;
+	}
+	if (scales.empty())
+	{
+		scales.push_back(1);
+	}
+	if (samples.empty())
+	{
+		samples.assign(s_DefaultSamples, s_DefaultSamples + sizeof(s_DefaultSamples) / sizeof(s_DefaultSamples[0]));
+	}
+
+	// the settings common to all runs; the children inherit the environment
+	SetEnv("CLCL_BENCH", REPORT_FILE);
+	SetEnv("CLCL_BENCH_WARMUP", std::to_string(warmup));
+	if (!resolution.empty())
+	{
+		SetEnv("CLCL_NULL_RESOLUTION", resolution);
+	}
+	if (!replay.empty())
+	{
+		// the recording decides the number of frames
+		SetEnv("CLCL_REPLAY", replay);
+		SetEnv("CLCL_REPLAY_SPEED", "0");
+	}
+	else
+	{
+		SetEnv("CLCL_HMD", "null");
+		SetEnv("CLCL_NULL_RATE", "0");
+		SetEnv("CLCL_NULL_FRAMES", std::to_string(warmup + frames + 1));
+	}
+
+	std::string runs;
+	for (size_t i = 0; i < samples.size(); i++)
+	{
+		for (size_t j = 0; j < scales.size(); j++)
+		{
+			SetEnv("CLCL_BENCH_SCALE", std::to_string(scales[j]));
+			remove(REPORT_FILE);
+
+#ifdef _WIN32
+			std::string command = "\"\"" + binDir + "\\" + samples[i] + ".exe\"\"";
+#else
+			std::string command = "\"" + binDir + "/" + samples[i] + "\"";
+#endif // _WIN32
+			fprintf(stderr, "clcl_bench: %s (scale %d)\n", samples[i].c_str(), scales[j]);
+			fflush(stderr);
+			int status = system(command.c_str());
+
+			std::string report;
+			if (!ReadFile(REPORT_FILE, report))
+			{
+				fprintf(stderr, "clcl_bench: %s wrote no report\n", samples[i].c_str());
+				report = "null";
+			}
+			remove(REPORT_FILE);
+
+			if (!runs.empty())
+			{
+				runs += ",\n";
+			}
+			runs += "    {\"sample\": " + Quote(samples[i]) +
+				", \"scale\": " + std::to_string(scales[j]) +
+				", \"exit_code\": " + std::to_string(status) +
+				", \"report\": " + Indent(report, "    ") + "}";
+		}
+	}
+
+	FILE* out = stdout;
+	if (!outPath.empty() && (out = fopen(outPath.c_str(), "w")) == nullptr)
+	{
+		fprintf(stderr, "ERROR: cannot open %s\n", outPath.c_str());
+		return EXIT_FAILURE;
+	}
+	fprintf(out, "{\n");
+	fprintf(out, "  \"frames\": %lld,\n", replay.empty() ? frames : -1LL);
+	fprintf(out, "  \"warmup\": %lld,\n", warmup);
+	fprintf(out, "  \"replay\": %s,\n", replay.empty() ? "null" : Quote(replay).c_str());
+	fprintf(out, "  \"runs\": [\n%s\n  ]\n", runs.c_str());
+	fprintf(out, "}\n");
+	if (out != stdout)
+	{
+		fclose(out);
+	}
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,583 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// clcl_microbench.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// clcl_microbench: time per call of the per-frame code of CLCL.
+//
+//   usage: clcl_microbench [--filter TEXT] [--trials N] [--out FILE]
+//
+//   Each benchmark is calibrated to run for about 50 ms per trial; the
+//   median and the minimum time per call over the trials are written as
+//   JSON. No HMD runtime is needed:
+//     - the CAVE* functions run against the null HMD (CLCL_HMD=null) without
+//       starting the display thread;
+//     - the tracking update runs on MockHMD, which feeds the poses of a
+//       mocked runtime through the same steps as OpenVR::UpdateTrackingData.
+//
+//   nav_convert_check compares NavigationTransform::TransformPoints (the
+//   CAVENavConvert* functions) with glm for an affine and a projective
+//   matrix, and fails (exit code 1) if they differ.
+//
+//   frame_loop_allocations is a check rather than a timing: it runs the
+//   steady-state frame loop for a number of frames and fails (exit code 1)
+//   if the heap was allocated. The project compiles its own copy of
+//   alloc_counter.cpp with COUNT_ALLOCATIONS, so the check also counts the
+//   allocations of the library; a build without it fails the check.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define _CRT_SECURE_NO_WARNINGS
+
+#include <cave_ogl.h>
+
+#include "hmd/hmd.h"
+#include "hmd/matrix_convert.h"
+#include "hmd/nav_transform.h"
+#include "timing/alloc_counter.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <vector>
+
+static volatile float s_Sink; // keeps the results alive
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// MockRuntime: the tracking data an HMD runtime returns for a frame
+// (IVRCompositor::WaitGetPoses and IVRSystem::GetControllerState), in the
+// same row-major layout as vr::HmdMatrix34_t.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+struct MockRuntime
+{
+	static const int NUM_DEVICES = 4; // head, wand, two trackers
+
+	struct Device
+	{
+		float m[3][4];
+		int   sensor;
+		bool  isValid;
+	};
+
+	Device   devices[NUM_DEVICES];
+	uint32_t buttons;
+	float    joystick[2];
+	double   time;
+
+	MockRuntime()
+	{
+		memset(devices, 0, sizeof(devices));
+		for (int i = 0; i < NUM_DEVICES; i++)
+		{
+			devices[i].sensor = i;
+			devices[i].isValid = true;
+		}
+		buttons = 0;
+		joystick[0] = joystick[1] = 0.0f;
+		time = 0.0;
+		Advance();
+	}
+
+	// the devices turn slowly and the buttons change now and then
+	void Advance()
+	{
+		time += 1.0 / 90.0;
+		for (int i = 0; i < NUM_DEVICES; i++)
+		{
+			float angle = static_cast<float>(time * (0.5 + 0.1 * i));
+			float c = cosf(angle), s = sinf(angle);
+			float (*m)[4] = devices[i].m;
+			m[0][0] = c;    m[0][1] = 0.0f; m[0][2] = s;    m[0][3] = 0.1f * i;
+			m[1][0] = 0.0f; m[1][1] = 1.0f; m[1][2] = 0.0f; m[1][3] = 1.6f - 0.3f * i;
+			m[2][0] = -s;   m[2][1] = 0.0f; m[2][2] = c;    m[2][3] = -0.2f * i;
+		}
+		buttons = (static_cast<llong>(time * 90.0) / 45) & 1;
+		joystick[0] = static_cast<float>(sin(time));
+		joystick[1] = static_cast<float>(cos(time));
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// MockHMD: a backend without a display that tracks MockRuntime.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class MockHMD : public HMD {
+public:
+	MockRuntime runtime;
+
+	const char* name() const { return "mock"; }
+	void Init() {}
+	void InitGL() {}
+	void Terminate() {}
+	void PostProcess() {}
+	void SubmitFrame(int eyeIndex) {}
+	double GetTime() { return runtime.time; }
+
+	// the same steps as OpenVR::UpdateTrackingData
+	void UpdateTrackingData()
+	{
+		m_FrameIndex++;
+		for (int i = 0; i < MockRuntime::NUM_DEVICES; i++)
+		{
+			const MockRuntime::Device& device = runtime.devices[i];
+			if (!device.isValid) continue;
+
+			glm::mat4 pose = RowMajor34ToGLM(device.m);
+			if (device.sensor == SENSOR_HEAD)
+			{
+				m_HeadPose = pose;
+				UpdateHeadPose();
+			}
+			else if (device.sensor == SENSOR_WAND)
+			{
+				m_HandPose = pose;
+				UpdateHandPose(0.0f);
+			}
+			else
+			{
+				UpdateSensorPose(device.sensor, pose, 0.0f);
+			}
+			RecordPose(device.sensor, runtime.time, pose);
+		}
+
+		InputSnapshot snapshot;
+		memset(&snapshot, 0, sizeof(snapshot));
+		snapshot.frameIndex = m_FrameIndex;
+		snapshot.time = runtime.time;
+		snapshot.buttons = runtime.buttons;
+		snapshot.mapped = 0x7; // buttons 1-3, as OpenVR
+		snapshot.joystick[0] = runtime.joystick[0];
+		snapshot.joystick[1] = runtime.joystick[1];
+		snapshot.isConnected = true;
+		PublishInput(snapshot);
+	}
+
+	// tracking part of a display frame
+	void Step()
+	{
+		runtime.Advance();
+		UpdateTrackingData();
+		TransformPoses();
+	}
+
+	float headX() { return m_Tracking.head.translationNav.x; }
+
+	static void ComputeState(const glm::mat4& pose, const glm::mat4& navInverse, DeviceState& state)
+	{
+		ComputeDeviceState(pose, 0.0f, navInverse, state);
+	}
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// harness
+//
+////////////////////////////////////////////////////////////////////////////////
+
+struct Options
+{
+	std::string filter;
+	int         trials;
+};
+
+static std::string s_Results;
+
+template <class FUNCTION>
+static double TimeLoop(llong iterations, FUNCTION& function)
+{
+	std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+	for (llong i = 0; i < iterations; i++)
+	{
+		function();
+	}
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+template <class FUNCTION>
+static void Run(const Options& options, const char* name, FUNCTION function)
+{
+	if (!options.filter.empty() && strstr(name, options.filter.c_str()) == nullptr) return;
+
+	// calibrate to about 50 ms per trial
+	const double TRIAL_SECONDS = 0.05;
+	llong iterations = 1;
+	double seconds;
+	while ((seconds = TimeLoop(iterations, function)) < TRIAL_SECONDS / 10.0 && iterations < (1LL << 40))
+	{
+		iterations *= 2;
+	}
+	iterations = std::max(1LL, static_cast<llong>(iterations * TRIAL_SECONDS / std::max(seconds, 1.0e-9)));
+
+	std::vector<double> times;
+	for (int trial = 0; trial < options.trials; trial++)
+	{
+		times.push_back(TimeLoop(iterations, function) * 1.0e9 / iterations);
+	}
+	std::sort(times.begin(), times.end());
+
+	char line[256];
+	snprintf(line, sizeof(line),
+		"    {\"name\": \"%s\", \"iterations\": %lld, \"ns_per_op\": {\"median\": %.3f, \"min\": %.3f}}",
+		name, iterations, times[times.size() / 2], times.front());
+	if (!s_Results.empty())
+	{
+		s_Results += ",\n";
+	}
+	s_Results += line;
+	fprintf(stderr, "%-24s %10.2f ns\n", name, times[times.size() / 2]);
+}
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// benchmarks
+//
+////////////////////////////////////////////////////////////////////////////////
+
+static int s_CallbackCount = 0;
+
+static void DrawCallback(void* data, void* count)
+{
+	(*static_cast<int*>(count))++;
+}
+
+// a callback with the most arguments CAVELib allows
+static void CountCallback10(void* count, void*, void*, void*, void*, void*, void*, void*, void*, void* last)
+{
+	(*static_cast<int*>(count))++;
+	(*static_cast<int*>(last))++;
+}
+
+// the application step and the display frame, in one thread; returns the
+// allocations during "frames" frames after a warmup, or -1 if not counted
+static llong CountFrameLoopAllocations(int frames)
+{
+	const int WARMUP_FRAMES = 100;
+	MockHMD hmd;
+	SharedSnapshot& snapshot = hmd.sharedSnapshot();
+	snapshot.SetEnabled(true);
+	int* counter = static_cast<int*>(snapshot.Allocate(sizeof(int)));
+
+	HMDCallback draw, idle;
+	draw.Bind((HMDCALLBACK)CountCallback10, std::vector<void*>(CALLBACK_MAX_ARGS, counter));
+	std::vector<void*> args;
+	args.push_back(&hmd);
+	args.push_back(counter);
+	idle.Bind((HMDCALLBACK)DrawCallback, args);
+
+	uint64_t start = 0;
+	for (int frame = -WARMUP_FRAMES; frame < frames; frame++)
+	{
+		if (frame == 0)
+		{
+			start = AllocationCount();
+		}
+
+		// application: edit the shared data and end the step
+		(*counter)++;
+		snapshot.Publish();
+		hmd.input().EndStep();
+
+		// display: latch, track, then the idle and draw callbacks of both eyes
+		bool isSnapshotChanged = snapshot.Latch();
+		draw.Latch(snapshot, isSnapshotChanged);
+		idle.Latch(snapshot, isSnapshotChanged);
+		hmd.Step();
+		idle.Invoke();
+		draw.Invoke();
+		draw.Invoke();
+	}
+	uint64_t allocations = AllocationCount() - start;
+	s_Sink = static_cast<float>(*counter);
+
+	snapshot.Free(counter);
+	return IsAllocationCounted() ? static_cast<llong>(allocations) : -1;
+}
+
+static bool CheckAllocations(const Options& options, std::string& result)
+{
+	const char* name = "frame_loop_allocations";
+	if (!options.filter.empty() && strstr(name, options.filter.c_str()) == nullptr) return true;
+
+	const int FRAMES = 1000;
+	llong allocations = CountFrameLoopAllocations(FRAMES);
+	if (allocations < 0)
+	{
+		fprintf(stderr, "%-24s FAILED: not counted (build with COUNT_ALLOCATIONS)\n", name);
+		result = "null";
+		return false;
+	}
+
+	fprintf(stderr, "%-24s %lld in %d frames%s\n", name, allocations, FRAMES, allocations != 0 ? " FAILED" : "");
+	result = "{\"frames\": " + std::to_string(FRAMES) + ", \"allocations\": " + std::to_string(allocations) + "}";
+	return allocations == 0;
+}
+
+static bool CheckNavConvert(const Options& options, std::string& result)
+{
+	const char* name = "nav_convert_check";
+	if (!options.filter.empty() && strstr(name, options.filter.c_str()) == nullptr) return true;
+
+	// column-major; the second one has a non-zero bottom row
+	glm::mat4 affine = glm::mat4(
+		0.0f, 0.0f, -2.0f, 0.0f,
+		0.0f, 2.0f, 0.0f, 0.0f,
+		2.0f, 0.0f, 0.0f, 0.0f,
+		1.0f, -3.0f, 0.5f, 1.0f);
+	glm::mat4 projective = affine;
+	projective[0][3] = 0.25f;
+	projective[2][3] = -0.5f;
+	projective[3][3] = 2.0f;
+
+	// 7 points: a batch of four and the scalar tail
+	const int COUNT = 7;
+	float in[COUNT][3], out[COUNT][3];
+	for (int i = 0; i < COUNT; i++)
+	{
+		in[i][0] = 0.5f * i;
+		in[i][1] = 1.0f - i;
+		in[i][2] = 0.25f * i * i;
+	}
+
+	bool isPassed = true;
+	const glm::mat4* matrices[2] = { &affine, &projective };
+	for (int k = 0; k < 2; k++)
+	{
+		for (int isVector = 0; isVector < 2; isVector++)
+		{
+			NavigationTransform::TransformPoints(*matrices[k], in, out, COUNT, isVector != 0);
+			for (int i = 0; i < COUNT; i++)
+			{
+				glm::vec4 product = *matrices[k] * glm::vec4(in[i][0], in[i][1], in[i][2], isVector ? 0.0f : 1.0f);
+				float w = isVector ? 1.0f : product.w;
+				for (int j = 0; j < 3; j++)
+				{
+					float expected = product[j] / w;
+					if (fabsf(out[i][j] - expected) > 1.0e-4f * (1.0f + fabsf(expected)))
+					{
+						isPassed = false;
+					}
+				}
+			}
+		}
+	}
+
+	fprintf(stderr, "%-24s %s\n", name, isPassed ? "ok" : "FAILED");
+	result = isPassed ? "true" : "false";
+	return isPassed;
+}
+
+static void RunConversions(const Options& options)
+{
+	MockRuntime runtime;
+	float projection[4][4];
+	memcpy(projection, runtime.devices[0].m, sizeof(runtime.devices[0].m));
+	projection[3][0] = projection[3][1] = projection[3][3] = 0.0f;
+	projection[3][2] = -1.0f;
+
+	Run(options, "to_glm_34", [&]() {
+		for (int i = 0; i < MockRuntime::NUM_DEVICES; i++)
+		{
+			s_Sink = RowMajor34ToGLM(runtime.devices[i].m)[3][0];
+		}
+	});
+	Run(options, "to_glm_44", [&]() {
+		s_Sink = RowMajor44ToGLM(projection)[2][3];
+	});
+}
+
+static void RunTracking(const Options& options)
+{
+	MockHMD hmd;
+
+	Run(options, "tracking_update", [&]() {
+		hmd.Step();
+		s_Sink = hmd.headX();
+	});
+
+	// a draw callback with two arguments, latched and invoked once per frame
+	HMDCallback callback;
+	std::vector<void*> args;
+	args.push_back(&hmd);
+	args.push_back(&s_CallbackCount);
+	callback.Bind((HMDCALLBACK)DrawCallback, args);
+	Run(options, "callback_dispatch", [&]() {
+		callback.Latch(hmd.sharedSnapshot(), false);
+		callback.Invoke();
+	});
+}
+
+// the pose conversion of 2, 8 and 64 devices: one device at a time with
+// glm as before PoseBatch (a 4x4 inverse of the navigation per device),
+// and the batch with and without SSE
+static void RunPoseBatch(const Options& options)
+{
+	const int NUM_DEVICES[] = { 2, 8, 64 };
+	glm::mat4 navigation = glm::translate(glm::mat4(1.0f), glm::vec3(1.0f, 0.0f, -2.0f)) *
+		glm::rotate(glm::mat4(1.0f), 0.3f, glm::vec3(0.0f, 1.0f, 0.0f)) *
+		glm::scale(glm::mat4(1.0f), glm::vec3(2.0f, 2.0f, 2.0f));
+
+	for (size_t n = 0; n < sizeof(NUM_DEVICES) / sizeof(NUM_DEVICES[0]); n++)
+	{
+		int numDevices = NUM_DEVICES[n];
+		std::vector<glm::mat4> poses(numDevices);
+		for (int i = 0; i < numDevices; i++)
+		{
+			poses[i] = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.1f * i, 1.5f, -0.2f * i)),
+				0.1f * i, glm::vec3(0.0f, 1.0f, 0.0f));
+		}
+		std::vector<DeviceState> states(numDevices);
+		PoseBatch batch(numDevices);
+		char name[64];
+
+		snprintf(name, sizeof(name), "pose_glm_%d", numDevices);
+		Run(options, name, [&]() {
+			for (int i = 0; i < numDevices; i++)
+			{
+				MockHMD::ComputeState(poses[i], glm::inverse(navigation), states[i]);
+			}
+			s_Sink = states[numDevices - 1].translationNav.x;
+		});
+
+		snprintf(name, sizeof(name), "pose_batch_scalar_%d", numDevices);
+		Run(options, name, [&]() {
+			for (int i = 0; i < numDevices; i++)
+			{
+				batch.Set(i, poses[i], 0.0f);
+			}
+			batch.TransformScalar(PoseBatch::AffineInverse(navigation), 1.0f / FEET_PER_METER);
+			s_Sink = batch.translationNav(numDevices - 1).x;
+		});
+
+		snprintf(name, sizeof(name), "pose_batch_%d", numDevices);
+		Run(options, name, [&]() {
+			for (int i = 0; i < numDevices; i++)
+			{
+				batch.Set(i, poses[i], 0.0f);
+			}
+			batch.Transform(PoseBatch::AffineInverse(navigation), 1.0f / FEET_PER_METER);
+			s_Sink = batch.translationNav(numDevices - 1).x;
+		});
+	}
+}
+
+static void RunCAVEFunctions(const Options& options)
+{
+	// row-major, as CAVENavMultMatrix() takes it: the translation is in the
+	// last column
+	float matrix[4][4] = {
+		{ 1.0f, 0.0f, 0.0f, 0.01f },
+		{ 0.0f, 1.0f, 0.0f, 0.0f },
+		{ 0.0f, 0.0f, 1.0f, -0.01f },
+		{ 0.0f, 0.0f, 0.0f, 1.0f }
+	};
+	float value[3];
+
+	Run(options, "nav_translate", [&]() {
+		CAVENavTranslate(0.001f, 0.0f, -0.001f);
+	});
+	Run(options, "nav_rotate", [&]() {
+		CAVENavRot(0.1f, 'y');
+	});
+	Run(options, "nav_mult_matrix", [&]() {
+		CAVENavMultMatrix(matrix);
+	});
+	CAVENavLoadIdentity();
+
+	Run(options, "get_position", [&]() {
+		CAVEGetPosition(CAVE_HEAD, value);
+		s_Sink = value[0];
+	});
+	Run(options, "get_position_nav", [&]() {
+		CAVEGetPosition(CAVE_WAND_NAV, value);
+		s_Sink = value[0];
+	});
+	Run(options, "get_vector", [&]() {
+		CAVEGetVector(CAVE_HEAD_FRONT, value);
+		s_Sink = value[0];
+	});
+	Run(options, "get_vector_nav", [&]() {
+		CAVEGetVector(CAVE_HEAD_FRONT_NAV, value);
+		s_Sink = value[0];
+	});
+	Run(options, "button_change", [&]() {
+		s_Sink = static_cast<float>(CAVEButtonChange(1));
+	});
+}
+
+int main(int argc, char** argv)
+{
+	Options options;
+	options.trials = 7;
+	std::string outPath;
+	for (int i = 1; i < argc; i++)
+	{
+		std::string arg = argv[i];
+		if (arg == "--filter" && i + 1 < argc)
+		{
+			options.filter = argv[++i];
+		}
+		else if (arg == "--trials" && i + 1 < argc)
+		{
+			options.trials = std::max(1, atoi(argv[++i]));
+		}
+		else if (arg == "--out" && i + 1 < argc)
+		{
+			outPath = argv[++i];
+		}
+		else
+		{
+			fprintf(stderr, "usage: clcl_microbench [--filter TEXT] [--trials N] [--out FILE]\n");
+			return EXIT_FAILURE;
+		}
+	}
+
+	RunConversions(options);
+	RunTracking(options);
+	RunPoseBatch(options);
+	std::string navConvertCheck = "null";
+	bool isPassed = CheckNavConvert(options, navConvertCheck);
+	std::string allocationCheck = "null";
+	isPassed = CheckAllocations(options, allocationCheck) && isPassed;
+
+	// the CAVE* functions on the null HMD; the display thread is not started
+#ifdef _WIN32
+	_putenv_s("CLCL_HMD", "null");
+#else
+	setenv("CLCL_HMD", "null", 1);
+#endif // _WIN32
+	CAVEConfigure(&argc, argv, NULL);
+	RunCAVEFunctions(options);
+	CAVEExit();
+
+	FILE* out = stdout;
+	if (!outPath.empty() && (out = fopen(outPath.c_str(), "w")) == nullptr)
+	{
+		fprintf(stderr, "ERROR: cannot open %s\n", outPath.c_str());
+		return EXIT_FAILURE;
+	}
+	fprintf(out, "{\n  \"trials\": %d,\n  \"benchmarks\": [\n%s\n  ],\n", options.trials, s_Results.c_str());
+	fprintf(out, "  \"nav_convert_check\": %s,\n", navConvertCheck.c_str());
+	fprintf(out, "  \"frame_loop_allocations\": %s\n}\n", allocationCheck.c_str());
+	if (out != stdout)
+	{
+		fclose(out);
+	}
+	return isPassed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -55,6 +55,9 @@ main(int argc, char **argv)
 {
 	struct _snowdata *snows;
 	CAVEConfigure(&argc, argv, NULL);
+#ifdef USE_CLCL
+	CAVESetOption(CAVE_SHMEM_SNAPSHOT, 1); // draw() reads a consistent copy of the shared data
+#endif
 
 	snows = init_shmem();
 
@@ -66,7 +69,9 @@ main(int argc, char **argv)
 	{
 		compute(snows);
 		navigate();
-#ifndef _WIN32
+#if defined(USE_CLCL)
+		CAVEWaitForFrame(); // one step per display frame
+#elif !defined(_WIN32)
 		sginap(1);
 #else
 		CAVEUSleep(10);
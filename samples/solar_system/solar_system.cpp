@@ -64,6 +64,9 @@ main(int argc, char **argv)
 {
 	struct _planetdata *planet;
 	CAVEConfigure(&argc, argv, NULL);
+#ifdef USE_CLCL
+	CAVESetOption(CAVE_SHMEM_SNAPSHOT, 1); // draw() reads a consistent copy of the shared data
+#endif
 
 	planet = init_shmem();
 
@@ -74,7 +77,9 @@ main(int argc, char **argv)
 	while (!CAVEgetbutton(CAVE_ESCKEY))
 	{
 		compute(planet);
-#ifndef _WIN32
+#if defined(USE_CLCL)
+		CAVEWaitForFrame(); // one step per display frame
+#elif !defined(_WIN32)
 		sginap(1);
 #else
 		CAVEUSleep(10);
@@ -0,0 +1,269 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// camera_compositor.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "camera_compositor.h"
+
+#include <cstdio>
+#include <cstdlib>
+
+// one triangle covering the viewport, on the far plane
+static const char* VERTEX_SHADER =
+	"#version 410\n"
+	"out vec2 v_Position;\n"
+	"void main()\n"
+	"{\n"
+	"	v_Position = vec2(gl_VertexID == 1 ? 3.0 : -1.0, gl_VertexID == 2 ? 3.0 : -1.0);\n"
+	"	gl_Position = vec4(v_Position, 1.0, 1.0);\n"
+	"}\n";
+
+static const char* FRAGMENT_SHADER =
+	"#version 410\n"
+	"uniform sampler2D u_Image;\n"
+	"uniform int   u_Format;      // 0: color, 1: Bayer, 2: YUV 4:2:0\n"
+	"uniform ivec2 u_ImageSize;\n"
+	"uniform ivec2 u_BayerOffset; // position of the first red site\n"
+	"uniform vec4  u_Rect;\n"
+	"uniform vec4  u_TextureTransform;\n"
+	"uniform vec4  u_Distortion;  // k1, k2, p1, p2\n"
+	"uniform vec4  u_Lens;        // center, focal length\n"
+	"in vec2 v_Position;\n"
+	"out vec4 outputColor;\n"
+	"\n"
+	"float Fetch(ivec2 p)\n"
+	"{\n"
+	"	return texelFetch(u_Image, clamp(p, ivec2(0), u_ImageSize - 1), 0).r;\n"
+	"}\n"
+	"\n"
+	"// bilinear demosaic\n"
+	"vec3 Demosaic(ivec2 p)\n"
+	"{\n"
+	"	ivec2 site = (p - u_BayerOffset) & 1;\n"
+	"	float center = Fetch(p);\n"
+	"	float horizontal = 0.5 * (Fetch(p + ivec2(1, 0)) + Fetch(p - ivec2(1, 0)));\n"
+	"	float vertical = 0.5 * (Fetch(p + ivec2(0, 1)) + Fetch(p - ivec2(0, 1)));\n"
+	"	float cross = 0.5 * (horizontal + vertical);\n"
+	"	float diagonal = 0.25 * (Fetch(p + ivec2(1, 1)) + Fetch(p + ivec2(-1, 1)) +\n"
+	"		Fetch(p + ivec2(1, -1)) + Fetch(p + ivec2(-1, -1)));\n"
+	"	if (site == ivec2(0, 0)) return vec3(center, cross, diagonal);\n"
+	"	if (site == ivec2(1, 1)) return vec3(diagonal, cross, center);\n"
+	"	if (site == ivec2(1, 0)) return vec3(horizontal, center, vertical);\n"
+	"	return vec3(vertical, center, horizontal);\n"
+	"}\n"
+	"\n"
+	"// Y plane, then the U and V planes packed into rows of the image width\n"
+	"vec3 YUV(ivec2 p)\n"
+	"{\n"
+	"	int width = u_ImageSize.x;\n"
+	"	int chromaSize = ((u_ImageSize.x + 1) / 2) * ((u_ImageSize.y + 1) / 2);\n"
+	"	int u = (p.y / 2) * ((u_ImageSize.x + 1) / 2) + p.x / 2;\n"
+	"	int v = u + chromaSize;\n"
+	"	float y = texelFetch(u_Image, p, 0).r;\n"
+	"	float cb = texelFetch(u_Image, ivec2(u % width, u_ImageSize.y + u / width), 0).r - 0.5;\n"
+	"	float cr = texelFetch(u_Image, ivec2(v % width, u_ImageSize.y + v / width), 0).r - 0.5;\n"
+	"	float c = 1.164 * (y - 16.0 / 255.0); // BT.601, video range\n"
+	"	return clamp(vec3(c + 1.596 * cr, c - 0.392 * cb - 0.813 * cr, c + 2.017 * cb), 0.0, 1.0);\n"
+	"}\n"
+	"\n"
+	"void main()\n"
+	"{\n"
+	"	vec2 uv = (v_Position - u_Rect.xy) / (u_Rect.zw - u_Rect.xy);\n"
+	"	if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0)))) discard;\n"
+	"	uv.y = 1.0 - uv.y; // the image rows are from the top\n"
+	"	uv = uv * u_TextureTransform.xy + u_TextureTransform.zw;\n"
+	"\n"
+	"	// the point of the distorted image that shows this undistorted direction\n"
+	"	vec2 p = (uv - u_Lens.xy) / u_Lens.zw;\n"
+	"	float r2 = dot(p, p);\n"
+	"	vec2 d = p * (1.0 + r2 * (u_Distortion.x + r2 * u_Distortion.y)) +\n"
+	"		vec2(2.0 * u_Distortion.z * p.x * p.y + u_Distortion.w * (r2 + 2.0 * p.x * p.x),\n"
+	"			u_Distortion.z * (r2 + 2.0 * p.y * p.y) + 2.0 * u_Distortion.w * p.x * p.y);\n"
+	"	uv = d * u_Lens.zw + u_Lens.xy;\n"
+	"	if (any(lessThan(uv, vec2(0.0))) || any(greaterThan(uv, vec2(1.0))))\n"
+	"	{\n"
+	"		outputColor = vec4(0.0, 0.0, 0.0, 1.0);\n"
+	"		return;\n"
+	"	}\n"
+	"\n"
+	"	if (u_Format == 0)\n"
+	"	{\n"
+	"		outputColor = vec4(texture(u_Image, uv).rgb, 1.0);\n"
+	"		return;\n"
+	"	}\n"
+	"	ivec2 texel = min(ivec2(uv * vec2(u_ImageSize)), u_ImageSize - 1);\n"
+	"	outputColor = vec4(u_Format == 1 ? Demosaic(texel) : YUV(texel), 1.0);\n"
+	"}\n";
+
+CameraCompositor::CameraCompositor()
+{
+	m_Program = 0;
+	m_VertexArray = 0;
+	m_FormatLocation = m_ImageSizeLocation = m_BayerOffsetLocation = -1;
+	m_RectLocation = m_TextureTransformLocation = -1;
+	m_DistortionLocation = m_LensLocation = -1;
+
+	m_Distortion[0] = m_Distortion[1] = m_Distortion[2] = m_Distortion[3] = 0.0f;
+	m_Lens[0] = m_Lens[1] = m_Lens[2] = m_Lens[3] = 0.5f;
+	m_HasDistortion = false;
+
+	const char* env;
+	float values[4];
+	if ((env = getenv("CLCL_CAMERA_DISTORTION")) != nullptr &&
+		sscanf(env, "%f,%f,%f,%f", &values[0], &values[1], &values[2], &values[3]) == 4)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			m_Distortion[i] = values[i];
+		}
+		m_HasDistortion = true;
+	}
+	if ((env = getenv("CLCL_CAMERA_LENS")) != nullptr &&
+		sscanf(env, "%f,%f,%f,%f", &values[0], &values[1], &values[2], &values[3]) == 4 &&
+		values[2] > 0.0f && values[3] > 0.0f)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			m_Lens[i] = values[i];
+		}
+	}
+}
+
+bool CameraCompositor::InitGL()
+{
+	if (m_Program != 0) return true;
+
+	GLuint vertexShader = CompileShader(GL_VERTEX_SHADER, VERTEX_SHADER);
+	GLuint fragmentShader = CompileShader(GL_FRAGMENT_SHADER, FRAGMENT_SHADER);
+	if (vertexShader == 0 || fragmentShader == 0)
+	{
+		glDeleteShader(vertexShader);
+		glDeleteShader(fragmentShader);
+		return false;
+	}
+
+	m_Program = glCreateProgram();
+	glAttachShader(m_Program, vertexShader);
+	glAttachShader(m_Program, fragmentShader);
+	glLinkProgram(m_Program);
+	glDeleteShader(vertexShader);
+	glDeleteShader(fragmentShader);
+
+	GLint isLinked = GL_FALSE;
+	glGetProgramiv(m_Program, GL_LINK_STATUS, &isLinked);
+	if (isLinked != GL_TRUE)
+	{
+		printf("camera compositor - Error linking program %d!\n", m_Program);
+		glDeleteProgram(m_Program);
+		m_Program = 0;
+		return false;
+	}
+
+	m_FormatLocation = glGetUniformLocation(m_Program, "u_Format");
+	m_ImageSizeLocation = glGetUniformLocation(m_Program, "u_ImageSize");
+	m_BayerOffsetLocation = glGetUniformLocation(m_Program, "u_BayerOffset");
+	m_RectLocation = glGetUniformLocation(m_Program, "u_Rect");
+	m_TextureTransformLocation = glGetUniformLocation(m_Program, "u_TextureTransform");
+	m_DistortionLocation = glGetUniformLocation(m_Program, "u_Distortion");
+	m_LensLocation = glGetUniformLocation(m_Program, "u_Lens");
+
+	GLint program = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+	glUseProgram(m_Program);
+	glUniform1i(glGetUniformLocation(m_Program, "u_Image"), 0);
+	glUniform4fv(m_DistortionLocation, 1, m_Distortion);
+	glUniform4fv(m_LensLocation, 1, m_Lens);
+	glUseProgram(program);
+
+	// the vertices come from gl_VertexID, but a vertex array must be bound
+	glGenVertexArrays(1, &m_VertexArray);
+	return true;
+}
+
+void CameraCompositor::TerminateGL()
+{
+	if (m_Program != 0)
+	{
+		glDeleteProgram(m_Program);
+		m_Program = 0;
+	}
+	if (m_VertexArray != 0)
+	{
+		glDeleteVertexArrays(1, &m_VertexArray);
+		m_VertexArray = 0;
+	}
+}
+
+void CameraCompositor::Draw(GLuint texture, const CameraSource& source, const float rect[4], const float textureTransform[4])
+{
+	if (m_Program == 0 || texture == 0) return;
+
+	int format = 0;
+	if (source.pixelFormat() == CameraSource::PIXEL_BAYER)
+	{
+		format = 1;
+	}
+	else if (source.pixelFormat() == CameraSource::PIXEL_I420)
+	{
+		format = 2;
+	}
+
+	// the bindings of the caller, restored below
+	GLint program = 0, activeTexture = 0, boundTexture = 0, vertexArray = 0;
+	glGetIntegerv(GL_CURRENT_PROGRAM, &program);
+	glGetIntegerv(GL_ACTIVE_TEXTURE, &activeTexture);
+	glGetIntegerv(GL_VERTEX_ARRAY_BINDING, &vertexArray);
+
+	glPushAttrib(GL_ENABLE_BIT | GL_DEPTH_BUFFER_BIT);
+	glEnable(GL_DEPTH_TEST);
+	glDepthFunc(GL_ALWAYS);
+	glDepthMask(GL_TRUE);
+	glDisable(GL_BLEND);
+	glDisable(GL_CULL_FACE);
+
+	glUseProgram(m_Program);
+	glUniform1i(m_FormatLocation, format);
+	glUniform2i(m_ImageSizeLocation, source.width(), source.height());
+	glUniform2i(m_BayerOffsetLocation, source.bayerOffsetX(), source.bayerOffsetY());
+	glUniform4fv(m_RectLocation, 1, rect);
+	glUniform4fv(m_TextureTransformLocation, 1, textureTransform);
+
+	glActiveTexture(GL_TEXTURE0);
+	glGetIntegerv(GL_TEXTURE_BINDING_2D, &boundTexture);
+	glBindTexture(GL_TEXTURE_2D, texture);
+	glBindVertexArray(m_VertexArray);
+	glDrawArrays(GL_TRIANGLES, 0, 3);
+	glBindVertexArray(vertexArray);
+	glBindTexture(GL_TEXTURE_2D, boundTexture);
+	glActiveTexture(activeTexture);
+	glUseProgram(program);
+	glPopAttrib();
+}
+
+GLuint CameraCompositor::CompileShader(GLenum type, const char* source)
+{
+	GLuint shader = glCreateShader(type);
+	glShaderSource(shader, 1, &source, NULL);
+	glCompileShader(shader);
+
+	GLint isCompiled = GL_FALSE;
+	glGetShaderiv(shader, GL_COMPILE_STATUS, &isCompiled);
+	if (isCompiled != GL_TRUE)
+	{
+		char log[1024];
+		glGetShaderInfoLog(shader, sizeof(log), NULL, log);
+		printf("camera compositor - Unable to compile %s shader:\n%s\n",
+			type == GL_VERTEX_SHADER ? "vertex" : "fragment", log);
+		glDeleteShader(shader);
+		return 0;
+	}
+	return shader;
+}
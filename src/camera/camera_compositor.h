@@ -0,0 +1,72 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// camera_compositor.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../settings.h"
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include "camera_source.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// CameraCompositor: draws the camera image behind the scene in one
+// full-screen shader pass.
+//
+//   The fragment shader reads the image in the format of the source
+//   (BGRA / RGB, a Bayer mosaic, or planar YUV 4:2:0), so demosaicing and
+//   color conversion are done on the GPU, and corrects the lens distortion
+//   (radial k1, k2 and tangential p1, p2 about the lens center) on the way.
+//   The pass writes the far plane to the depth buffer, so the scene needs
+//   no depth clear after it, and it keeps the GL state of the caller.
+//
+//   Environment variables:
+//     CLCL_CAMERA_DISTORTION : "k1,k2,p1,p2" (default: no correction)
+//     CLCL_CAMERA_LENS       : "cx,cy,fx,fy", lens center and focal length
+//                              in image widths / heights (default
+//                              "0.5,0.5,0.5,0.5")
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class CameraCompositor {
+public:
+	CameraCompositor();
+
+	bool InitGL(); // false if the shaders are not supported
+	void TerminateGL();
+	bool IsInitializedGL() const { return m_Program != 0; }
+	bool HasDistortion() const { return m_HasDistortion; }
+
+	// rect: left, bottom, right, top in normalized device coordinates;
+	// texture: scale (x, y) and offset (z, w) of the texture coordinates
+	void Draw(GLuint texture, const CameraSource& source, const float rect[4], const float textureTransform[4]);
+
+private:
+	GLuint m_Program;
+	GLuint m_VertexArray;
+	GLint  m_FormatLocation;
+	GLint  m_ImageSizeLocation;
+	GLint  m_BayerOffsetLocation;
+	GLint  m_RectLocation;
+	GLint  m_TextureTransformLocation;
+	GLint  m_DistortionLocation;
+	GLint  m_LensLocation;
+
+	float  m_Distortion[4];
+	float  m_Lens[4];
+	bool   m_HasDistortion;
+
+	static GLuint CompileShader(GLenum type, const char* source);
+};
@@ -0,0 +1,121 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// camera_source.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "camera_source.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+
+#include "file_source.h"
+#include "synthetic_source.h"
+#ifdef USE_OVRVISION
+#include "ovrvision/ovrvision_source.h"
+#endif // USE_OVRVISION
+
+CameraSource::CameraSource()
+{
+	m_Width = 960;
+	m_Height = 950;
+	m_PixelSize = 4;
+	m_Format = GL_BGRA;
+	m_PixelFormat = PIXEL_BGRA;
+	m_BayerOffset[0] = m_BayerOffset[1] = 0;
+	m_IsRawAllowed = false;
+	m_FrameRate = 60.0;
+	m_IsPaced = false;
+}
+
+CameraSource* CameraSource::Create()
+{
+	const char* env = getenv("CLCL_CAMERA");
+	if (env == nullptr || env[0] == '\0')
+	{
+#ifdef USE_OVRVISION
+		return new OvrvisionSource();
+#else
+		return nullptr;
+#endif // USE_OVRVISION
+	}
+	if (strcmp(env, "ovrvision") == 0)
+	{
+#ifdef USE_OVRVISION
+		return new OvrvisionSource();
+#else
+		fprintf(stderr, "Camera: built without USE_OVRVISION\n");
+		return nullptr;
+#endif // USE_OVRVISION
+	}
+	if (strcmp(env, "synthetic") == 0)
+	{
+		return new SyntheticCameraSource();
+	}
+	return new FileCameraSource(env);
+}
+
+void CameraSource::ReadSettings()
+{
+	const char* env;
+	if ((env = getenv("CLCL_CAMERA_RESOLUTION")) != nullptr)
+	{
+		unsigned int width, height;
+		if (sscanf(env, "%ux%u", &width, &height) == 2 && width > 0 && height > 0)
+		{
+			m_Width = width;
+			m_Height = height;
+		}
+	}
+	if ((env = getenv("CLCL_CAMERA_RATE")) != nullptr)
+	{
+		m_FrameRate = atof(env);
+	}
+}
+
+void CameraSource::SetPixelFormat(PIXEL_FORMAT format)
+{
+	m_PixelFormat = format;
+	switch (format)
+	{
+		case PIXEL_BGRA:
+			m_PixelSize = 4;
+			m_Format = GL_BGRA;
+			break;
+		case PIXEL_RGB:
+			m_PixelSize = 3;
+			m_Format = GL_RGB;
+			break;
+		default:
+			m_PixelSize = 1;
+			m_Format = GL_RED;
+			break;
+	}
+}
+
+void CameraSource::WaitForNextFrame()
+{
+	if (m_FrameRate <= 0.0) return;
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	std::chrono::steady_clock::duration period = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+		std::chrono::duration<double>(1.0 / m_FrameRate));
+	if (!m_IsPaced || m_NextFrameTime <= now)
+	{
+		// first frame, or the reader fell behind: restart pacing from now
+		m_NextFrameTime = now + period;
+		m_IsPaced = true;
+		return;
+	}
+	std::this_thread::sleep_until(m_NextFrameTime);
+	m_NextFrameTime += period;
+}
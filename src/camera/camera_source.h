@@ -0,0 +1,96 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// camera_source.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../settings.h"
+
+#include <chrono>
+#include <cstddef>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// CameraSource: where the passthrough images come from.
+//
+//   Grab() takes the next stereo frame and keeps it until the next Grab();
+//   Retrieve() then copies one eye of it (imageSize() bytes, rows from the
+//   top). If IsBlocking(), Grab() waits for the frame, and OVRVision calls
+//   it from its own thread.
+//
+//   Create() selects the source with the environment variable CLCL_CAMERA:
+//     ovrvision : the Ovrvision camera (default if USE_OVRVISION is defined)
+//     synthetic : generated test patterns
+//     <path>    : a recorded stereo stream (".y4m" or raw frames)
+//   CLCL_CAMERA_RESOLUTION ("960x950") and CLCL_CAMERA_RATE (Hz, 0 for as
+//   fast as possible) set the size of one eye and the frame rate of the
+//   synthetic and file sources.
+//
+//   The images are BGRA or RGB unless AllowRawFormats() was called before
+//   Open(): then a source may deliver its Bayer mosaic or YUV 4:2:0 planes
+//   as they are, for CameraCompositor to convert on the GPU.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class CameraSource {
+public:
+	enum PIXEL_FORMAT {
+		PIXEL_BGRA = 0,
+		PIXEL_RGB,
+		PIXEL_BAYER, // 8 bit, red site at bayerOffset
+		PIXEL_I420   // Y, then U and V at half resolution, 8 bit planes
+	};
+
+	CameraSource();
+	virtual ~CameraSource() {}
+
+	static CameraSource* Create(); // nullptr if no source is selected
+
+	virtual const char* name() const = 0;
+	virtual bool Open() = 0;
+	virtual void Close() {}
+	virtual bool Grab() = 0;
+	virtual void Retrieve(int eyeIndex, unsigned char* pixels) = 0;
+	virtual bool IsBlocking() const { return true; }
+	virtual bool IsHardware() const { return false; } // false: the image is not flipped
+	void AllowRawFormats() { m_IsRawAllowed = true; }
+
+	int    width() const { return m_Width; }
+	int    height() const { return m_Height; }
+	int    pixelSize() const { return m_PixelSize; }
+	GLenum format() const { return m_Format; } // of the texture upload
+	PIXEL_FORMAT pixelFormat() const { return m_PixelFormat; }
+	int    bayerOffsetX() const { return m_BayerOffset[0]; }
+	int    bayerOffsetY() const { return m_BayerOffset[1]; }
+	int    uploadHeight() const { return m_PixelFormat == PIXEL_I420 ? m_Height * 3 / 2 : m_Height; }
+	size_t imageSize() const { return static_cast<size_t>(m_Width) * uploadHeight() * m_PixelSize; }
+	double frameRate() const { return m_FrameRate; }
+
+protected:
+	int    m_Width, m_Height, m_PixelSize;
+	GLenum m_Format;
+	PIXEL_FORMAT m_PixelFormat;
+	int    m_BayerOffset[2];
+	bool   m_IsRawAllowed;
+	double m_FrameRate;
+
+	void ReadSettings();     // CLCL_CAMERA_RESOLUTION, CLCL_CAMERA_RATE
+	void WaitForNextFrame(); // paces Grab() at m_FrameRate
+	void SetPixelFormat(PIXEL_FORMAT format);
+
+private:
+	std::chrono::steady_clock::time_point m_NextFrameTime;
+	bool m_IsPaced;
+};
@@ -0,0 +1,401 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// file_source.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "file_source.h"
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif // _WIN32
+
+static inline unsigned char Clamp(int value)
+{
+	return static_cast<unsigned char>(value < 0 ? 0 : (value > 255 ? 255 : value));
+}
+
+FileCameraSource::FileCameraSource(const char* path)
+{
+	m_Path = path;
+	m_IsY4M = false;
+	m_IsStereo = true;
+	m_FileFormat = PIXEL_BGRA;
+	m_Chroma = CHROMA_420;
+	m_FrameWidth = m_FrameHeight = 0;
+	p_Data = nullptr;
+	m_Size = 0;
+#ifdef _WIN32
+	m_File = INVALID_HANDLE_VALUE;
+	m_Mapping = nullptr;
+#else
+	m_File = -1;
+#endif // _WIN32
+	m_Frame = 0;
+
+	ReadSettings();
+	const char* env = getenv("CLCL_CAMERA_LAYOUT");
+	if (env != nullptr && strcmp(env, "mono") == 0)
+	{
+		m_IsStereo = false;
+	}
+	if ((env = getenv("CLCL_CAMERA_FORMAT")) != nullptr)
+	{
+		static const char* BAYER_NAMES[] = { "rggb", "grbg", "gbrg", "bggr" };
+		if (strcmp(env, "i420") == 0)
+		{
+			m_FileFormat = PIXEL_I420;
+		}
+		for (int i = 0; i < 4; i++)
+		{
+			if (strcmp(env, BAYER_NAMES[i]) == 0)
+			{
+				m_FileFormat = PIXEL_BAYER;
+				m_BayerOffset[0] = i & 1;
+				m_BayerOffset[1] = i >> 1;
+			}
+		}
+	}
+}
+
+FileCameraSource::~FileCameraSource()
+{
+	Close();
+}
+
+bool FileCameraSource::Open()
+{
+	if (!Map())
+	{
+		fprintf(stderr, "Camera: cannot open %s\n", m_Path.c_str());
+		return false;
+	}
+
+	m_IsY4M = m_Size >= 10 && memcmp(p_Data, "YUV4MPEG2 ", 10) == 0;
+	if (m_IsY4M)
+	{
+		if (!ParseY4M())
+		{
+			fprintf(stderr, "Camera: unsupported YUV4MPEG2 stream %s\n", m_Path.c_str());
+			Close();
+			return false;
+		}
+	}
+	else
+	{
+		m_FrameWidth = m_Width;
+		m_FrameHeight = m_IsStereo ? m_Height * 2 : m_Height;
+		size_t frameSize = FrameSize();
+		for (size_t offset = 0; offset + frameSize <= m_Size; offset += frameSize)
+		{
+			m_FrameOffsets.push_back(offset);
+		}
+	}
+	if (m_FrameOffsets.empty())
+	{
+		fprintf(stderr, "Camera: no %d x %d frame in %s\n", m_FrameWidth, m_FrameHeight, m_Path.c_str());
+		Close();
+		return false;
+	}
+	m_Frame = m_FrameOffsets.size() - 1; // the first Grab() wraps to frame 0
+
+	// the planes of one eye can be cut out only at even rows and columns
+	if (m_FileFormat == PIXEL_BAYER)
+	{
+		if (!m_IsRawAllowed)
+		{
+			fprintf(stderr, "Camera: Bayer frames need the shader compositor\n");
+			Close();
+			return false;
+		}
+		if (m_Width % 2 != 0 || m_Height % 2 != 0)
+		{
+			fprintf(stderr, "Camera: Bayer frames need an even width and height (%d x %d)\n", m_Width, m_Height);
+			Close();
+			return false;
+		}
+		SetPixelFormat(PIXEL_BAYER);
+	}
+	else if (m_FileFormat == PIXEL_I420 && m_Chroma == CHROMA_420 && m_IsRawAllowed &&
+		m_Width % 2 == 0 && m_Height % 2 == 0)
+	{
+		SetPixelFormat(PIXEL_I420);
+	}
+	else
+	{
+		SetPixelFormat(PIXEL_BGRA);
+	}
+
+	fprintf(stderr, "Camera: %s (%s, %d x %d %s, %zu frames @ %g Hz%s)\n", m_Path.c_str(),
+		m_IsY4M ? "y4m" : "raw", m_Width, m_Height, m_IsStereo ? "stereo" : "mono",
+		m_FrameOffsets.size(), m_FrameRate, m_PixelFormat == PIXEL_BGRA ? "" : ", raw upload");
+	return true;
+}
+
+void FileCameraSource::Close()
+{
+	Unmap();
+	m_FrameOffsets.clear();
+}
+
+bool FileCameraSource::Grab()
+{
+	if (m_FrameOffsets.empty()) return false;
+
+	WaitForNextFrame();
+	m_Frame = (m_Frame + 1) % m_FrameOffsets.size();
+	return true;
+}
+
+void FileCameraSource::Retrieve(int eyeIndex, unsigned char* pixels)
+{
+	if (m_FrameOffsets.empty()) return;
+
+	const unsigned char* frame = p_Data + m_FrameOffsets[m_Frame];
+	int firstRow = (m_IsStereo && eyeIndex == 1) ? m_Height : 0;
+	if (m_FileFormat == PIXEL_I420)
+	{
+		if (m_PixelFormat == PIXEL_I420)
+		{
+			CopyPlanes(frame, firstRow, pixels);
+		}
+		else
+		{
+			ConvertRows(frame, firstRow, pixels);
+		}
+	}
+	else
+	{
+		memcpy(pixels, frame + static_cast<size_t>(firstRow) * m_Width * m_PixelSize, imageSize());
+	}
+}
+
+// YUV4MPEG2 W<width> H<height> F<num>:<den> C<chroma> ..., then FRAME<params>\n<planes> ...
+bool FileCameraSource::ParseY4M()
+{
+	const char* begin = reinterpret_cast<const char*>(p_Data);
+	const char* end = static_cast<const char*>(memchr(begin, '\n', m_Size));
+	if (end == nullptr) return false;
+
+	std::string header(begin, end);
+	int width = 0, height = 0;
+	double rate = 0.0;
+	size_t position = 0;
+	while ((position = header.find(' ', position)) != std::string::npos)
+	{
+		position++;
+		const char* token = header.c_str() + position;
+		switch (token[0])
+		{
+			case 'W':
+				width = atoi(token + 1);
+				break;
+			case 'H':
+				height = atoi(token + 1);
+				break;
+			case 'F':
+			{
+				int numerator = 0, denominator = 0;
+				if (sscanf(token + 1, "%d:%d", &numerator, &denominator) == 2 && denominator > 0)
+				{
+					rate = static_cast<double>(numerator) / denominator;
+				}
+				break;
+			}
+			case 'C':
+				if (strncmp(token + 1, "420", 3) == 0)
+				{
+					m_Chroma = CHROMA_420;
+				}
+				else if (strncmp(token + 1, "444 ", 4) == 0 || strcmp(token + 1, "444") == 0)
+				{
+					m_Chroma = CHROMA_444;
+				}
+				else if (strncmp(token + 1, "mono", 4) == 0)
+				{
+					m_Chroma = CHROMA_NONE;
+				}
+				else
+				{
+					return false;
+				}
+				break;
+		}
+	}
+	if (width <= 0 || height <= 0 || (m_IsStereo && height % 2 != 0)) return false;
+
+	m_FileFormat = PIXEL_I420;
+	m_FrameWidth = width;
+	m_FrameHeight = height;
+	m_Width = width;
+	m_Height = m_IsStereo ? height / 2 : height;
+	if (rate > 0.0 && getenv("CLCL_CAMERA_RATE") == nullptr)
+	{
+		m_FrameRate = rate;
+	}
+	size_t frameSize = FrameSize();
+
+	// frame headers may carry parameters, so the offsets are found by a scan
+	size_t offset = (end - begin) + 1;
+	while (offset + 5 <= m_Size && memcmp(p_Data + offset, "FRAME", 5) == 0)
+	{
+		const void* newline = memchr(p_Data + offset, '\n', m_Size - offset);
+		if (newline == nullptr) break;
+		size_t data = static_cast<const unsigned char*>(newline) - p_Data + 1;
+		if (data + frameSize > m_Size) break;
+		m_FrameOffsets.push_back(data);
+		offset = data + frameSize;
+	}
+	return true;
+}
+
+size_t FileCameraSource::FrameSize() const
+{
+	size_t lumaSize = static_cast<size_t>(m_FrameWidth) * m_FrameHeight;
+	switch (m_FileFormat)
+	{
+		case PIXEL_BAYER:
+			return lumaSize;
+		case PIXEL_I420:
+			if (m_Chroma == CHROMA_420)
+			{
+				return lumaSize + 2 * static_cast<size_t>((m_FrameWidth + 1) / 2) * ((m_FrameHeight + 1) / 2);
+			}
+			return m_Chroma == CHROMA_444 ? 3 * lumaSize : lumaSize;
+		default:
+			return lumaSize * 4;
+	}
+}
+
+// Y rows of the eye, then its U rows and V rows
+void FileCameraSource::CopyPlanes(const unsigned char* frame, int firstRow, unsigned char* pixels) const
+{
+	const size_t chromaWidth = m_FrameWidth / 2;
+	const size_t lumaSize = static_cast<size_t>(m_FrameWidth) * m_FrameHeight;
+	const size_t chromaSize = chromaWidth * (m_FrameHeight / 2);
+	const size_t eyeChromaSize = chromaWidth * (m_Height / 2);
+	const size_t chromaOffset = chromaWidth * (firstRow / 2);
+
+	memcpy(pixels, frame + static_cast<size_t>(firstRow) * m_FrameWidth, static_cast<size_t>(m_Width) * m_Height);
+	pixels += static_cast<size_t>(m_Width) * m_Height;
+	memcpy(pixels, frame + lumaSize + chromaOffset, eyeChromaSize);
+	memcpy(pixels + eyeChromaSize, frame + lumaSize + chromaSize + chromaOffset, eyeChromaSize);
+}
+
+void FileCameraSource::ConvertRows(const unsigned char* frame, int firstRow, unsigned char* pixels) const
+{
+	const int width = m_FrameWidth;
+	const int chromaWidth = (m_Chroma == CHROMA_420) ? (width + 1) / 2 : width;
+	const int chromaHeight = (m_Chroma == CHROMA_420) ? (m_FrameHeight + 1) / 2 : m_FrameHeight;
+	const unsigned char* planeY = frame;
+	const unsigned char* planeU = planeY + static_cast<size_t>(width) * m_FrameHeight;
+	const unsigned char* planeV = planeU + static_cast<size_t>(chromaWidth) * chromaHeight;
+
+	for (int row = 0; row < m_Height; row++)
+	{
+		int y = firstRow + row;
+		const unsigned char* rowY = planeY + static_cast<size_t>(y) * width;
+		int chromaRow = (m_Chroma == CHROMA_420) ? y / 2 : y;
+		const unsigned char* rowU = planeU + static_cast<size_t>(chromaRow) * chromaWidth;
+		const unsigned char* rowV = planeV + static_cast<size_t>(chromaRow) * chromaWidth;
+		unsigned char* out = pixels + static_cast<size_t>(row) * m_Width * 4;
+
+		for (int x = 0; x < width; x++)
+		{
+			int c = 298 * (rowY[x] - 16) + 128;
+			int d = 0, e = 0;
+			if (m_Chroma != CHROMA_NONE)
+			{
+				int chromaX = (m_Chroma == CHROMA_420) ? x / 2 : x;
+				d = rowU[chromaX] - 128;
+				e = rowV[chromaX] - 128;
+			}
+			out[0] = Clamp((c + 516 * d) >> 8);           // B
+			out[1] = Clamp((c - 100 * d - 208 * e) >> 8); // G
+			out[2] = Clamp((c + 409 * e) >> 8);           // R
+			out[3] = 255;
+			out += 4;
+		}
+	}
+}
+
+bool FileCameraSource::Map()
+{
+#ifdef _WIN32
+	m_File = CreateFileA(m_Path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN, NULL);
+	if (m_File == INVALID_HANDLE_VALUE) return false;
+
+	LARGE_INTEGER size;
+	if (!GetFileSizeEx(m_File, &size) || size.QuadPart == 0)
+	{
+		Unmap();
+		return false;
+	}
+	m_Mapping = CreateFileMappingA(m_File, NULL, PAGE_READONLY, 0, 0, NULL);
+	if (m_Mapping == nullptr)
+	{
+		Unmap();
+		return false;
+	}
+	p_Data = static_cast<const unsigned char*>(MapViewOfFile(m_Mapping, FILE_MAP_READ, 0, 0, 0));
+	m_Size = static_cast<size_t>(size.QuadPart);
+#else
+	m_File = open(m_Path.c_str(), O_RDONLY);
+	if (m_File < 0) return false;
+
+	struct stat status;
+	if (fstat(m_File, &status) != 0 || status.st_size == 0)
+	{
+		Unmap();
+		return false;
+	}
+	void* data = mmap(nullptr, status.st_size, PROT_READ, MAP_PRIVATE, m_File, 0);
+	if (data != MAP_FAILED)
+	{
+		madvise(data, status.st_size, MADV_SEQUENTIAL);
+		p_Data = static_cast<const unsigned char*>(data);
+		m_Size = static_cast<size_t>(status.st_size);
+	}
+#endif // _WIN32
+	if (p_Data == nullptr)
+	{
+		Unmap();
+		return false;
+	}
+	return true;
+}
+
+void FileCameraSource::Unmap()
+{
+#ifdef _WIN32
+	if (p_Data != nullptr) UnmapViewOfFile(p_Data);
+	if (m_Mapping != nullptr) CloseHandle(m_Mapping);
+	if (m_File != INVALID_HANDLE_VALUE) CloseHandle(m_File);
+	m_Mapping = nullptr;
+	m_File = INVALID_HANDLE_VALUE;
+#else
+	if (p_Data != nullptr) munmap(const_cast<unsigned char*>(p_Data), m_Size);
+	if (m_File >= 0) close(m_File);
+	m_File = -1;
+#endif // _WIN32
+	p_Data = nullptr;
+	m_Size = 0;
+}
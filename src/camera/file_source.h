@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// file_source.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "camera_source.h"
+
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// FileCameraSource: replays a recorded stereo stream, looping at the end.
+//
+//   The file is memory-mapped, and each frame holds the left image above
+//   the right one. Two formats are read:
+//     - YUV4MPEG2 (".y4m") with C420* / C444 / Cmono; the size and rate
+//       come from the header.
+//     - raw frames of CLCL_CAMERA_RESOLUTION per eye, in the format given
+//       by CLCL_CAMERA_FORMAT: bgra (default), i420, or a Bayer mosaic
+//       rggb / grbg / gbrg / bggr.
+//   4:2:0 and Bayer frames are passed on as they are if raw formats are
+//   allowed; otherwise YUV is converted to BGRA (BT.601, video range) and
+//   Bayer is not supported. With CLCL_CAMERA_LAYOUT=mono a frame holds one
+//   image for both eyes.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class FileCameraSource : public CameraSource {
+public:
+	explicit FileCameraSource(const char* path);
+	~FileCameraSource();
+
+	const char* name() const { return "file"; }
+	bool Open();
+	void Close();
+	bool Grab();
+	void Retrieve(int eyeIndex, unsigned char* pixels);
+
+	size_t numFrames() const { return m_FrameOffsets.size(); }
+
+private:
+	enum CHROMA { CHROMA_NONE, CHROMA_420, CHROMA_444 };
+
+	std::string m_Path;
+	bool   m_IsY4M;
+	bool   m_IsStereo;
+	PIXEL_FORMAT m_FileFormat; // PIXEL_I420 for any YUV
+	CHROMA m_Chroma;
+	int    m_FrameWidth, m_FrameHeight; // the whole frame
+
+	const unsigned char* p_Data;
+	size_t m_Size;
+#ifdef _WIN32
+	void*  m_File;
+	void*  m_Mapping;
+#else
+	int    m_File;
+#endif // _WIN32
+
+	std::vector<size_t> m_FrameOffsets;
+	size_t m_Frame;
+
+	bool Map();
+	void Unmap();
+	bool ParseY4M();
+	size_t FrameSize() const;
+	void ConvertRows(const unsigned char* frame, int firstRow, unsigned char* pixels) const;
+	void CopyPlanes(const unsigned char* frame, int firstRow, unsigned char* pixels) const;
+};
@@ -13,88 +13,79 @@
 
 #include "ovrvision.h"
 
-#ifdef USE_OVRVISION
+#include <chrono>
+#include <cstdlib>
 
 OVRVision::OVRVision()
 {
-	p_OVRVision = nullptr;
+	p_Source = nullptr;
 	m_Width = m_Height = 0, m_PixelSize = 4;
-	m_IsOpen = m_CameraState = false;
-#ifdef USE_THREAD_FOR_CAMERA_PROCESS
-	m_IsThreadRunning = true;
-#endif // USE_THREAD_FOR_CAMERA_PROCESS
+	m_Format = GL_BGRA;
+	m_IsOpen = false;
+	m_CameraState = false;
+	m_IsThreadRunning = false;
+}
+
+OVRVision::~OVRVision()
+{
+	StopThread();
+	if (m_Thread.joinable())
+	{
+		m_Thread.join();
+	}
+	delete p_Source;
 }
 
 bool OVRVision::Init()
 {
-#ifdef USE_OVRVISION_PRO
-	p_OVRVision = new OVR::OvrvisionPro();
-	int OVRVisionState = p_OVRVision->Open(0, OVR::OV_CAMHD_FULL); // 960x950 @60fps x2
-	if (OVRVisionState == 1)
+	p_Source = CameraSource::Create();
+	if (p_Source != nullptr && m_Compositor.InitGL())
 	{
-		m_IsOpen = true;
+		p_Source->AllowRawFormats();
 	}
-#else
-	p_OVRVision = new OVR::Ovrvision();
-	int OVRVisionState = p_OVRVision->Open(0, OVR::OV_CAMVGA_FULL);	// 640 x 480 60fps
-	if (OVRVisionState == OV_RESULT_OK)
+	if (p_Source != nullptr && p_Source->Open())
 	{
 		m_IsOpen = true;
 	}
-#endif // USE_OVRVISION_PRO
-
-#if defined(USE_OVRVISION_PRO) && defined(USE_THREAD_FOR_CAMERA_PROCESS)
-	m_HMutex = CreateMutex(NULL, FALSE, NULL);
-	m_HCamera = (HANDLE)_beginthread(&OVRVision::launchThread, 0, this);
-#endif // USE_OVRVISION_PRO && USE_THREAD_FOR_CAMERA_PROCESS
 
 	if (m_IsOpen)
 	{
-#ifdef USE_OVRVISION_PRO
-		p_OVRVision->SetCameraSyncMode(false);
-		std::cout << "GetCameraWhiteBalanceAuto() = ";
-		if (p_OVRVision->GetCameraWhiteBalanceAuto() == true)
-			std::cout << "true\n";
-		else
-			std::cout << "false\n";
-		p_OVRVision->SetCameraGain(25);
-		std::cout << "GetCameraGain() = ";
-		std::cout << p_OVRVision->GetCameraGain() << std::endl;
-		m_Width = p_OVRVision->GetCamWidth();
-		m_Height = p_OVRVision->GetCamHeight();
-		m_PixelSize = p_OVRVision->GetCamPixelsize();
-		m_Format = GL_BGRA;
-#else
-		m_Width = p_OVRVision->GetImageWidth();
-		m_Height = p_OVRVision->GetImageHeight();
-		m_PixelSize = p_OVRVision->GetPixelSize();
-		m_Format = GL_RGB;
-#endif // USE_OVRVISION_PRO
+		m_Width = p_Source->width();
+		m_Height = p_Source->height();
+		m_PixelSize = p_Source->pixelSize();
+		m_Format = p_Source->format();
 
-		glGenTextures(2, m_TexID);
-		for (int i = 0; i < 2; i++)
+		m_Stream.InitGL(m_Width, p_Source->uploadHeight(), m_PixelSize, m_Format, 2);
+		glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
+
+		// a source selected explicitly is shown from the start
+		if (getenv("CLCL_CAMERA") != nullptr)
 		{
-			glBindTexture(GL_TEXTURE_2D, m_TexID[i]);
-			glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
-			glTexEnvi(GL_TEXTURE_ENV, GL_TEXTURE_ENV_MODE, GL_REPLACE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-			glTexImage2D(GL_TEXTURE_2D, 0, GL_RGB, m_Width, m_Height, 0, m_Format, GL_UNSIGNED_BYTE, NULL);
+			m_CameraState = true;
+		}
+
+		// started after the stream, which the thread writes to
+		if (p_Source->IsBlocking())
+		{
+			m_IsThreadRunning = true;
+			m_Thread = std::thread(&OVRVision::CameraThread, this);
 		}
-		glBindTexture(GL_TEXTURE_2D, 0);
 
 		std::cout << "OVRVision: ENABLE" << std::endl;
+		std::cout << "OVRVision: Source    : " << p_Source->name() << std::endl;
 		std::cout << "OVRVision: Width     : " << m_Width << std::endl;
 		std::cout << "OVRVision: Height    : " << m_Height << std::endl;
 		std::cout << "OVRVision: PixelSize : " << m_PixelSize << std::endl;
+		std::cout << "OVRVision: Upload    : " << (m_Stream.IsPersistent() ? "persistent PBO" : "glTexSubImage2D") << std::endl;
+		std::cout << "OVRVision: Draw      : " << (m_Compositor.IsInitializedGL() ? "shader" : "fixed function") << std::endl;
 		return true;
 	}
 	else
 	{
 		std::cout << "OVRVision: DISABLE" << std::endl;
-		delete p_OVRVision;
+		m_Compositor.TerminateGL();
+		delete p_Source;
+		p_Source = nullptr;
 		return false;
 	}
 }
@@ -103,54 +94,90 @@ void OVRVision::Terminate()
 {
 	if (m_IsOpen)
 	{
-#ifdef USE_THREAD_FOR_CAMERA_PROCESS
-		CloseHandle(m_HCamera);
-		CloseHandle(m_HMutex);
-#endif // USE_THREAD_FOR_CAMERA_PROCESS
-		glDeleteTextures(2, m_TexID);
-		p_OVRVision->Close();
-		delete p_OVRVision;
+		StopThread();
+		if (m_Thread.joinable())
+		{
+			m_Thread.join();
+		}
+		std::cout << "OVRVision: Frames    : " << m_Stream.writtenFrames() << " captured, "
+			<< m_Stream.displayedFrames() << " displayed, " << m_Stream.droppedFrames() << " dropped" << std::endl;
+		std::cout << "OVRVision: Latency   : " << m_Stream.averageLatency() * 1000.0 << " ms (capture to display)" << std::endl;
+		m_Stream.TerminateGL();
+		m_Compositor.TerminateGL();
+		p_Source->Close();
+		delete p_Source;
+		p_Source = nullptr;
+		m_IsOpen = false;
+	}
+}
+
+// captures a frame and copies both eyes into the stream
+void OVRVision::Capture()
+{
+	if (!p_Source->Grab()) return;
+	TextureStream::Clock::time_point captureTime = TextureStream::Clock::now();
+
+	unsigned char* pixels = m_Stream.BeginWrite();
+	if (pixels == nullptr) return; // the display is behind, drop the frame
+
+	for (int eyeIndex = 0; eyeIndex < 2; eyeIndex++)
+	{
+		p_Source->Retrieve(eyeIndex, pixels + eyeIndex * m_Stream.imageSize());
 	}
+	m_Stream.EndWrite(captureTime);
 }
 
 void OVRVision::PreStore()
 {
-	if (m_IsOpen && m_CameraState)
+	if (m_IsOpen && m_CameraState && !m_Thread.joinable())
 	{
-#ifdef USE_OVRVISION_PRO
-		p_OVRVision->PreStoreCamData(OVR::Camqt::OV_CAMQT_DMSRMP);
-#else
-		p_OVRVision->PreStoreCamData();
-#endif // USE_OVRVISION_PRO
+		Capture();
 	}
 }
 
-void OVRVision::DrawImege(int eyeIndex)
+// starts the transfer of the newest captured frame; a frame is drawn once its transfer is done
+void OVRVision::Upload()
 {
 	if (m_IsOpen && m_CameraState)
 	{
-		glUseProgram(0);
+		m_Stream.Update();
+	}
+}
 
-		unsigned char* imagePtr = nullptr;
-		if (eyeIndex == 0)
-		{
-#ifdef USE_OVRVISION_PRO
-			imagePtr = p_OVRVision->GetCamImageBGRA(OVR::OV_CAMEYE_LEFT);
-#else
-			imagePtr = p_OVRVision->GetCamImage(OVR::OV_CAMEYE_LEFT, OVR::OV_PSQT_NONE);
-#endif // USE_OVRVISION_PRO
-		}
-		else
+void OVRVision::DrawImege(int eyeIndex)
+{
+	GLuint texture = m_Stream.texture(eyeIndex);
+	if (m_IsOpen && m_CameraState && texture != 0 && m_Compositor.IsInitializedGL())
+	{
+		// the same placement as the quads below
+		float rect[4] = { -1.0f, -1.0f, 1.0f, 1.0f };
+		float textureTransform[4] = { 1.0f, 1.0f, 0.0f, 0.0f };
+		if (p_Source->IsHardware())
 		{
 #ifdef USE_OVRVISION_PRO
-			imagePtr = p_OVRVision->GetCamImageBGRA(OVR::OV_CAMEYE_RIGHT);
+#ifndef USE_SDK_0_5_0_1
+			float ipd = 0.3f; // interpupillary distance
+			float aspect = static_cast<float>(m_Height) / static_cast<float>(m_Width) * 0.82f;
+			float zoom = 1.6f;
+			float shift = (eyeIndex == 0) ? 0.0f : -ipd;
+			rect[0] = -zoom + shift;
+			rect[1] = -zoom * aspect;
+			rect[2] = zoom + shift;
+			rect[3] = zoom * aspect;
+#endif // USE_SDK_0_5_0_1
 #else
-			imagePtr = p_OVRVision->GetCamImage(OVR::OV_CAMEYE_RIGHT, OVR::OV_PSQT_NONE);
+			// rotated by 180 degrees
+			textureTransform[0] = textureTransform[1] = -1.0f;
+			textureTransform[2] = textureTransform[3] = 1.0f;
 #endif // USE_OVRVISION_PRO
 		}
+		m_Compositor.Draw(texture, *p_Source, rect, textureTransform);
+	}
+	else if (m_IsOpen && m_CameraState && texture != 0)
+	{
+		glUseProgram(0);
 
-		glBindTexture(GL_TEXTURE_2D, m_TexID[eyeIndex]);
-		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_Width, m_Height, m_Format, GL_UNSIGNED_BYTE, imagePtr);
+		glBindTexture(GL_TEXTURE_2D, texture);
 
 		glMatrixMode(GL_PROJECTION);
 		glLoadIdentity();
@@ -163,65 +190,68 @@ void OVRVision::DrawImege(int eyeIndex)
 		glDepthMask(false);
 		glColor3f(1.0f, 1.0f, 1.0f);
 		glBegin(GL_QUADS);
-#ifdef USE_OVRVISION_PRO
-#ifdef USE_SDK_0_5_0_1
-		glTexCoord2f(0.0f, 0.0f);  glVertex2f(-1.0f,  1.0f);
-		glTexCoord2f(0.0f, 1.0f);  glVertex2f(-1.0f, -1.0f);
-		glTexCoord2f(1.0f, 1.0f);  glVertex2f( 1.0f, -1.0f);
-		glTexCoord2f(1.0f, 0.0f);  glVertex2f( 1.0f,  1.0f);
-#else
-		float ipd = 0.3f; // interpupillary distance
-		float aspect = static_cast<float>(m_Height) / static_cast<float>(m_Width) * 0.82f;
-		float zoom = 1.6f;
-		if (eyeIndex == 0)
+		if (!p_Source->IsHardware())
 		{
-			glTexCoord2f(0.0f, 0.0f);  glVertex2f(-zoom,  zoom * aspect);
-			glTexCoord2f(0.0f, 1.0f);  glVertex2f(-zoom, -zoom * aspect);
-			glTexCoord2f(1.0f, 1.0f);  glVertex2f( zoom, -zoom * aspect);
-			glTexCoord2f(1.0f, 0.0f);  glVertex2f( zoom,  zoom * aspect);
+			// rows from the top, the whole viewport
+			glTexCoord2f(0.0f, 0.0f);  glVertex2f(-1.0f,  1.0f);
+			glTexCoord2f(0.0f, 1.0f);  glVertex2f(-1.0f, -1.0f);
+			glTexCoord2f(1.0f, 1.0f);  glVertex2f( 1.0f, -1.0f);
+			glTexCoord2f(1.0f, 0.0f);  glVertex2f( 1.0f,  1.0f);
 		}
 		else
 		{
-			glTexCoord2f(0.0f, 0.0f);  glVertex2f(-zoom - ipd,  zoom * aspect);
-			glTexCoord2f(0.0f, 1.0f);  glVertex2f(-zoom - ipd, -zoom * aspect);
-			glTexCoord2f(1.0f, 1.0f);  glVertex2f( zoom - ipd, -zoom * aspect);
-			glTexCoord2f(1.0f, 0.0f);  glVertex2f( zoom - ipd,  zoom * aspect);
-		}
+#ifdef USE_OVRVISION_PRO
+#ifdef USE_SDK_0_5_0_1
+			glTexCoord2f(0.0f, 0.0f);  glVertex2f(-1.0f,  1.0f);
+			glTexCoord2f(0.0f, 1.0f);  glVertex2f(-1.0f, -1.0f);
+			glTexCoord2f(1.0f, 1.0f);  glVertex2f( 1.0f, -1.0f);
+			glTexCoord2f(1.0f, 0.0f);  glVertex2f( 1.0f,  1.0f);
+#else
+			float ipd = 0.3f; // interpupillary distance
+			float aspect = static_cast<float>(m_Height) / static_cast<float>(m_Width) * 0.82f;
+			float zoom = 1.6f;
+			if (eyeIndex == 0)
+			{
+				glTexCoord2f(0.0f, 0.0f);  glVertex2f(-zoom,  zoom * aspect);
+				glTexCoord2f(0.0f, 1.0f);  glVertex2f(-zoom, -zoom * aspect);
+				glTexCoord2f(1.0f, 1.0f);  glVertex2f( zoom, -zoom * aspect);
+				glTexCoord2f(1.0f, 0.0f);  glVertex2f( zoom,  zoom * aspect);
+			}
+			else
+			{
+				glTexCoord2f(0.0f, 0.0f);  glVertex2f(-zoom - ipd,  zoom * aspect);
+				glTexCoord2f(0.0f, 1.0f);  glVertex2f(-zoom - ipd, -zoom * aspect);
+				glTexCoord2f(1.0f, 1.0f);  glVertex2f( zoom - ipd, -zoom * aspect);
+				glTexCoord2f(1.0f, 0.0f);  glVertex2f( zoom - ipd,  zoom * aspect);
+			}
 #endif // USE_SDK_0_5_0_1
 #else
-		glTexCoord2f(1.0f, 0.0f);  glVertex2f(-1.0f, -1.0f);
-		glTexCoord2f(0.0f, 0.0f);  glVertex2f( 1.0f, -1.0f);
-		glTexCoord2f(0.0f, 1.0f);  glVertex2f( 1.0f,  1.0f);
-		glTexCoord2f(1.0f, 1.0f);  glVertex2f(-1.0f,  1.0f);
+			glTexCoord2f(1.0f, 0.0f);  glVertex2f(-1.0f, -1.0f);
+			glTexCoord2f(0.0f, 0.0f);  glVertex2f( 1.0f, -1.0f);
+			glTexCoord2f(0.0f, 1.0f);  glVertex2f( 1.0f,  1.0f);
+			glTexCoord2f(1.0f, 1.0f);  glVertex2f(-1.0f,  1.0f);
 #endif // USE_OVRVISION_PRO
+		}
 		glEnd();
 		glEnable(GL_LIGHTING);
 		glEnable(GL_DEPTH_TEST);
 		glDisable(GL_TEXTURE_2D);
 		glDepthMask(true);
 		glPopMatrix();
-		glClear(GL_DEPTH_BUFFER_BIT);
 		glBindTexture(GL_TEXTURE_2D, 0);
 
 	}
 }
 
-#ifdef USE_THREAD_FOR_CAMERA_PROCESS
 void OVRVision::CameraThread()
 {
 	while (m_IsThreadRunning)
 	{
-		WaitForSingleObject(m_HMutex, INFINITE);
-
-#ifdef USE_OVRVISION_PRO
-		p_OVRVision->PreStoreCamData(OVR::Camqt::OV_CAMQT_DMSRMP);
-#else
-		p_OVRVision->PreStoreCamData();
-#endif // USE_OVRVISION_PRO
-		ReleaseMutex(m_HMutex);
+		if (!m_CameraState)
+		{
+			std::this_thread::sleep_for(std::chrono::milliseconds(10));
+			continue;
+		}
+		Capture();
 	}
-	_endthread();
 }
-#endif // USE_THREAD_FOR_CAMERA_PROCESS
-
-#endif // USE_OVRVISION
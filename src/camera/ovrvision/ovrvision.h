@@ -15,62 +15,59 @@
 
 #include "../../settings.h"
 
-#ifdef USE_OVRVISION
+#include <atomic>
 #include <iostream>
+#include <thread>
+
+#define GLEW_STATIC
 #include <GL/glew.h>
-#include <windows.h>
-//#include <GLFW/glfw3.h>
-//#include <GLFW/glfw3native.h>
 
-#ifdef USE_OVRVISION_PRO
-	#include <ovrvision_pro.h>
-	#pragma comment(lib, "ovrvision64.lib")
-	#ifdef USE_THREAD_FOR_CAMERA_PROCESS
-//		#include <thread>
-		#include <process.h>
-	#endif // USE_THREAD_FOR_CAMERA_PROCESS
-#else
-	#include <ovrvision.h>
-	#pragma comment(lib, "ovrvision_64.lib")
-#endif // USE_OVRVISION_PRO
+#include "../camera_compositor.h"
+#include "../camera_source.h"
+#include "../texture_stream.h"
 
-class OVRVision {
-#ifdef USE_OVRVISION_PRO
-	OVR::OvrvisionPro* p_OVRVision;
-#else
-	OVR::Ovrvision* p_OVRVision;
-#endif // USE_OVRVISION_PRO
+////////////////////////////////////////////////////////////////////////////////
+//
+// OVRVision: the camera passthrough drawn behind the scene.
+//
+//   The images come from a CameraSource (see camera_source.h): the
+//   Ovrvision camera, or a synthetic or recorded stream, which lets the
+//   upload and draw path run without the camera. A source that waits for
+//   its frames is read on a separate thread; otherwise PreStore() reads it
+//   on the display thread. Either way the frames go through m_Stream.
+//   If shaders are available, m_Compositor draws them and the source may
+//   deliver its raw format; otherwise they are drawn as a textured quad.
+//
+////////////////////////////////////////////////////////////////////////////////
 
-	int    OVRVisionState; // if OvrvisionPro->Open() succeeded, it return a value less than zero.
+class OVRVision {
+	CameraSource* p_Source;
 	bool   m_IsOpen;
-	bool   m_CameraState;
+	std::atomic<bool> m_CameraState; // also read by the camera thread
 	int    m_Width, m_Height, m_PixelSize;
 	GLenum m_Format;
-	GLuint m_TexID[2];
+	TextureStream m_Stream; // both eyes, filled by Capture()
+	CameraCompositor m_Compositor;
 
-#ifdef USE_THREAD_FOR_CAMERA_PROCESS
-	static void launchThread(void *obj) { reinterpret_cast<OVRVision *>(obj)->CameraThread(); }
+	void   Capture();
 	void   CameraThread();
-	HANDLE m_HMutex; // handles for the thread
-	HANDLE m_HCamera;
-	bool   m_IsThreadRunning; // flag to stop the thread for prestore image
-#endif // USE_THREAD_FOR_CAMERA_PROCESS
+	std::thread m_Thread; // only writes to m_Stream, which needs no lock
+	std::atomic<bool> m_IsThreadRunning; // flag to stop the thread for prestore image
 public:
 	OVRVision();
+	~OVRVision();
 
 	bool   Init();
 	void   Terminate();
 	void   PreStore();
+	void   Upload();
 	void   DrawImege(int eyeIndex);
 	bool   IsOpen() { return m_IsOpen; }
-	bool   cameraState() { return m_CameraState; }
-	void   toggleCameraState() { m_CameraState = !m_CameraState; }
+	bool   cameraState() { return m_CameraState.load(); }
+	void   toggleCameraState() { m_CameraState.store(!m_CameraState.load()); } // display thread only
 	int    width() { return m_Width; }
 	int    height() { return m_Height; }
 	int    pixelSize() { return m_PixelSize; }
-#ifdef USE_THREAD_FOR_CAMERA_PROCESS
+	const TextureStream& stream() const { return m_Stream; } // frame counters and latency
 	void   StopThread() { m_IsThreadRunning = false; }
-#endif // USE_THREAD_FOR_CAMERA_PROCESS
 };
-
-#endif // USE_OVRVISION
@@ -0,0 +1,122 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// ovrvision_source.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "ovrvision_source.h"
+
+#ifdef USE_OVRVISION
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+OvrvisionSource::OvrvisionSource()
+{
+	p_OVRVision = nullptr;
+#ifdef USE_OVRVISION_PRO
+	m_IsRemapped = true;
+#endif // USE_OVRVISION_PRO
+}
+
+OvrvisionSource::~OvrvisionSource()
+{
+	Close();
+}
+
+bool OvrvisionSource::Open()
+{
+	bool isOpen = false;
+#ifdef USE_OVRVISION_PRO
+	p_OVRVision = new OVR::OvrvisionPro();
+	int OVRVisionState = p_OVRVision->Open(0, OVR::OV_CAMHD_FULL); // 960x950 @60fps x2
+	if (OVRVisionState == 1)
+	{
+		isOpen = true;
+	}
+#else
+	p_OVRVision = new OVR::Ovrvision();
+	int OVRVisionState = p_OVRVision->Open(0, OVR::OV_CAMVGA_FULL);	// 640 x 480 60fps
+	if (OVRVisionState == OV_RESULT_OK)
+	{
+		isOpen = true;
+	}
+#endif // USE_OVRVISION_PRO
+
+	if (!isOpen)
+	{
+		delete p_OVRVision;
+		p_OVRVision = nullptr;
+		return false;
+	}
+
+#ifdef USE_OVRVISION_PRO
+#ifdef USE_THREAD_FOR_CAMERA_PROCESS
+	p_OVRVision->SetCameraSyncMode(true); // the camera thread waits for each new frame
+#else
+	p_OVRVision->SetCameraSyncMode(false);
+#endif // USE_THREAD_FOR_CAMERA_PROCESS
+	std::cout << "GetCameraWhiteBalanceAuto() = ";
+	if (p_OVRVision->GetCameraWhiteBalanceAuto() == true)
+		std::cout << "true\n";
+	else
+		std::cout << "false\n";
+	p_OVRVision->SetCameraGain(25);
+	std::cout << "GetCameraGain() = ";
+	std::cout << p_OVRVision->GetCameraGain() << std::endl;
+	m_Width = p_OVRVision->GetCamWidth();
+	m_Height = p_OVRVision->GetCamHeight();
+	m_PixelSize = p_OVRVision->GetCamPixelsize();
+	m_Format = GL_BGRA;
+	m_FrameRate = 60.0;
+	m_IsRemapped = !(m_IsRawAllowed && getenv("CLCL_CAMERA_DISTORTION") != nullptr);
+#else
+	m_Width = p_OVRVision->GetImageWidth();
+	m_Height = p_OVRVision->GetImageHeight();
+	m_PixelSize = p_OVRVision->GetPixelSize();
+	m_Format = GL_RGB;
+	m_FrameRate = 60.0;
+#endif // USE_OVRVISION_PRO
+	return true;
+}
+
+void OvrvisionSource::Close()
+{
+	if (p_OVRVision != nullptr)
+	{
+		p_OVRVision->Close();
+		delete p_OVRVision;
+		p_OVRVision = nullptr;
+	}
+}
+
+bool OvrvisionSource::Grab()
+{
+	if (p_OVRVision == nullptr) return false;
+
+#ifdef USE_OVRVISION_PRO
+	p_OVRVision->PreStoreCamData(m_IsRemapped ? OVR::Camqt::OV_CAMQT_DMSRMP : OVR::Camqt::OV_CAMQT_DMS);
+#else
+	p_OVRVision->PreStoreCamData();
+#endif // USE_OVRVISION_PRO
+	return true;
+}
+
+void OvrvisionSource::Retrieve(int eyeIndex, unsigned char* pixels)
+{
+#ifdef USE_OVRVISION_PRO
+	unsigned char* imagePtr = p_OVRVision->GetCamImageBGRA(eyeIndex == 0 ? OVR::OV_CAMEYE_LEFT : OVR::OV_CAMEYE_RIGHT);
+#else
+	unsigned char* imagePtr = p_OVRVision->GetCamImage(eyeIndex == 0 ? OVR::OV_CAMEYE_LEFT : OVR::OV_CAMEYE_RIGHT, OVR::OV_PSQT_NONE);
+#endif // USE_OVRVISION_PRO
+	memcpy(pixels, imagePtr, imageSize());
+}
+
+#endif // USE_OVRVISION
@@ -0,0 +1,56 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// ovrvision_source.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../camera_source.h"
+
+#ifdef USE_OVRVISION
+#ifdef USE_OVRVISION_PRO
+	#include <ovrvision_pro.h>
+	#pragma comment(lib, "ovrvision64.lib")
+#else
+	#include <ovrvision.h>
+	#pragma comment(lib, "ovrvision_64.lib")
+#endif // USE_OVRVISION_PRO
+
+// the Ovrvision / Ovrvision Pro camera; Grab() waits for a new frame only
+// with USE_THREAD_FOR_CAMERA_PROCESS, when it is called from the camera thread.
+// With the shader compositor and CLCL_CAMERA_DISTORTION, the Pro SDK only
+// demosaics and the lens is corrected on the GPU.
+class OvrvisionSource : public CameraSource {
+#ifdef USE_OVRVISION_PRO
+	OVR::OvrvisionPro* p_OVRVision;
+	bool m_IsRemapped; // undistorted by the SDK
+#else
+	OVR::Ovrvision* p_OVRVision;
+#endif // USE_OVRVISION_PRO
+
+public:
+	OvrvisionSource();
+	~OvrvisionSource();
+
+	const char* name() const { return "ovrvision"; }
+	bool Open();
+	void Close();
+	bool Grab();
+	void Retrieve(int eyeIndex, unsigned char* pixels);
+#ifdef USE_THREAD_FOR_CAMERA_PROCESS
+	bool IsBlocking() const { return true; }
+#else
+	bool IsBlocking() const { return false; }
+#endif // USE_THREAD_FOR_CAMERA_PROCESS
+	bool IsHardware() const { return true; }
+};
+
+#endif // USE_OVRVISION
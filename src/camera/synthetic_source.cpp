@@ -0,0 +1,132 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// synthetic_source.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "synthetic_source.h"
+
+#include <cstdio>
+#include <cstring>
+
+static const int EYE_SHIFT = 16; // pixels between the left and right image
+
+// 0xAARRGGBB: white, yellow, cyan, green, magenta, red, blue, black
+static const uint32_t BAR_COLORS[] = {
+	0xFFFFFFFF, 0xFFFFFF00, 0xFF00FFFF, 0xFF00FF00,
+	0xFFFF00FF, 0xFFFF0000, 0xFF0000FF, 0xFF000000
+};
+
+static inline void StorePixel(unsigned char* pixel, uint32_t argb)
+{
+	pixel[0] = argb & 0xFF;         // B
+	pixel[1] = (argb >> 8) & 0xFF;  // G
+	pixel[2] = (argb >> 16) & 0xFF; // R
+	pixel[3] = (argb >> 24) & 0xFF; // A
+}
+
+// RGGB: red on even rows and columns, blue on odd ones
+static inline unsigned char BayerSample(uint32_t argb, int x, int y)
+{
+	int shift = ((x & 1) == (y & 1)) ? ((y & 1) ? 0 : 16) : 8;
+	return (argb >> shift) & 0xFF;
+}
+
+SyntheticCameraSource::SyntheticCameraSource()
+{
+	m_Frame = 0;
+	ReadSettings();
+}
+
+bool SyntheticCameraSource::Open()
+{
+	SetPixelFormat(m_IsRawAllowed ? PIXEL_BAYER : PIXEL_BGRA);
+	fprintf(stderr, "Camera: synthetic (%d x %d%s", m_Width, m_Height,
+		m_PixelFormat == PIXEL_BAYER ? " RGGB" : "");
+	if (m_FrameRate > 0.0)
+	{
+		fprintf(stderr, " @ %g Hz)\n", m_FrameRate);
+	}
+	else
+	{
+		fprintf(stderr, ", unpaced)\n");
+	}
+	return true;
+}
+
+bool SyntheticCameraSource::Grab()
+{
+	WaitForNextFrame();
+	m_Frame++;
+	return true;
+}
+
+void SyntheticCameraSource::Retrieve(int eyeIndex, unsigned char* pixels)
+{
+	const size_t rowSize = static_cast<size_t>(m_Width) * m_PixelSize;
+	const int barWidth = m_Width / NUM_BARS > 0 ? m_Width / NUM_BARS : 1;
+	const int blockSize = m_Width / (COUNTER_BITS * 2) > 0 ? m_Width / (COUNTER_BITS * 2) : 1;
+	const int bandHeight = blockSize < m_Height ? blockSize : m_Height;
+
+	// one bar per second (one pixel per frame if unpaced)
+	double framesPerBar = m_FrameRate > 0.0 ? m_FrameRate : barWidth;
+	uint64_t period = static_cast<uint64_t>(framesPerBar * NUM_BARS);
+	if (period < 1) period = 1; // below 1 / NUM_BARS Hz
+	int scroll = static_cast<int>(static_cast<double>(m_Frame % period) * barWidth / framesPerBar);
+	scroll += (eyeIndex == 0) ? 0 : EYE_SHIFT;
+
+	// the bars are the same on every row (every other row for a mosaic):
+	// build the first two rows below the band and copy them down
+	for (int y = bandHeight; y < bandHeight + 2 && y < m_Height; y++)
+	{
+		unsigned char* row = pixels + y * rowSize;
+		for (int x = 0; x < m_Width; x++)
+		{
+			int bar = (((x - scroll) % m_Width + m_Width) % m_Width) / barWidth;
+			StoreColor(row, x, y, BAR_COLORS[bar < NUM_BARS ? bar : NUM_BARS - 1]);
+		}
+	}
+	for (int y = bandHeight + 2; y < m_Height; y++)
+	{
+		memcpy(pixels + y * rowSize, pixels + (y - 2) * rowSize, rowSize);
+	}
+
+	// frame counter along the top, most significant bit first, on a gray band
+	for (int y = 0; y < 2 && y < bandHeight; y++)
+	{
+		unsigned char* band = pixels + y * rowSize;
+		for (int x = 0; x < m_Width; x++)
+		{
+			int bit = x / blockSize;
+			uint32_t color = 0xFF808080;
+			if (bit < COUNTER_BITS)
+			{
+				color = ((m_Frame >> (COUNTER_BITS - 1 - bit)) & 1) ? 0xFFFFFFFF : 0xFF000000;
+			}
+			StoreColor(band, x, y, color);
+		}
+	}
+	for (int y = 2; y < bandHeight; y++)
+	{
+		memcpy(pixels + y * rowSize, pixels + (y - 2) * rowSize, rowSize);
+	}
+}
+
+void SyntheticCameraSource::StoreColor(unsigned char* row, int x, int y, uint32_t argb) const
+{
+	if (m_PixelFormat == PIXEL_BAYER)
+	{
+		row[x] = BayerSample(argb, x, y);
+	}
+	else
+	{
+		StorePixel(row + x * m_PixelSize, argb);
+	}
+}
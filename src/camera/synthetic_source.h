@@ -0,0 +1,48 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// synthetic_source.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "camera_source.h"
+
+#include <cstdint>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// SyntheticCameraSource: generated test patterns, in BGRA or, if raw
+// formats are allowed, as an RGGB Bayer mosaic.
+//
+//   Color bars scrolling to the right by one bar per second, shifted between
+//   the eyes, and the frame number as a row of black / white blocks along
+//   the top edge, so the displayed frame can be read back from a capture of
+//   the screen.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class SyntheticCameraSource : public CameraSource {
+public:
+	SyntheticCameraSource();
+
+	const char* name() const { return "synthetic"; }
+	bool Open();
+	bool Grab();
+	void Retrieve(int eyeIndex, unsigned char* pixels);
+
+private:
+	static const int NUM_BARS = 8;
+	static const int COUNTER_BITS = 16;
+
+	uint64_t m_Frame;
+
+	void StoreColor(unsigned char* row, int x, int y, uint32_t argb) const;
+};
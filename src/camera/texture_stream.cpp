@@ -0,0 +1,354 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// texture_stream.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "texture_stream.h"
+
+TextureStream::TextureStream()
+{
+	for (int i = 0; i < NUM_SLOTS; i++)
+	{
+		Slot& slot = m_Slots[i];
+		slot.state.store(SLOT_FREE);
+		slot.sequence.store(0);
+		slot.p_Pixels = nullptr;
+		slot.buffer = 0;
+		for (int image = 0; image < MAX_IMAGES; image++)
+		{
+			slot.texture[image] = 0;
+		}
+		slot.fence = 0;
+	}
+	m_Width = m_Height = 0;
+	m_PixelSize = 4;
+	m_Format = GL_RGBA;
+	m_NumImages = 0;
+	m_ImageSize = 0;
+	m_IsPersistent = false;
+	m_IsInitialized = false;
+	m_WriteSlot = -1;
+	m_NumWritten.store(0);
+	m_NumDropped.store(0);
+	m_DisplayedSlot = -1;
+	m_NumUploaded = 0;
+	m_NumDisplayed = 0;
+	m_LastLatency = 0.0;
+	m_TotalLatency = 0.0;
+}
+
+TextureStream::~TextureStream()
+{
+	if (!m_IsPersistent)
+	{
+		for (int i = 0; i < NUM_SLOTS; i++)
+		{
+			delete[] m_Slots[i].p_Pixels;
+		}
+	}
+}
+
+bool TextureStream::InitGL(int width, int height, int pixelSize, GLenum format, int numImages)
+{
+	if (m_IsInitialized || numImages < 1 || numImages > MAX_IMAGES) return false;
+
+	m_Width = width;
+	m_Height = height;
+	m_PixelSize = pixelSize;
+	m_Format = format;
+	m_NumImages = numImages;
+	m_ImageSize = static_cast<size_t>(width) * height * pixelSize;
+	GLsizeiptr size = static_cast<GLsizeiptr>(m_ImageSize * numImages);
+
+	m_IsPersistent = GLEW_ARB_buffer_storage != 0;
+	if (m_IsPersistent)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		for (int i = 0; i < NUM_SLOTS; i++)
+		{
+			Slot& slot = m_Slots[i];
+			glGenBuffers(1, &slot.buffer);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+			glBufferStorage(GL_PIXEL_UNPACK_BUFFER, size, nullptr, flags);
+			slot.p_Pixels = static_cast<unsigned char*>(glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size, flags));
+			if (slot.p_Pixels == nullptr)
+			{
+				m_IsPersistent = false;
+			}
+		}
+		if (!m_IsPersistent)
+		{
+			for (int i = 0; i < NUM_SLOTS; i++)
+			{
+				Slot& slot = m_Slots[i];
+				glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+				if (slot.p_Pixels != nullptr)
+				{
+					glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+				}
+				glDeleteBuffers(1, &slot.buffer);
+				slot.buffer = 0;
+				slot.p_Pixels = nullptr;
+			}
+		}
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+	}
+	if (!m_IsPersistent)
+	{
+		for (int i = 0; i < NUM_SLOTS; i++)
+		{
+			m_Slots[i].p_Pixels = new unsigned char[size];
+		}
+	}
+
+	// single channel images (Bayer, YUV planes) are converted by a shader
+	GLint internalFormat = (m_Format == GL_RED) ? GL_R8 : GL_RGB;
+	for (int i = 0; i < NUM_SLOTS; i++)
+	{
+		Slot& slot = m_Slots[i];
+		glGenTextures(numImages, slot.texture);
+		for (int image = 0; image < numImages; image++)
+		{
+			glBindTexture(GL_TEXTURE_2D, slot.texture[image]);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+			glTexImage2D(GL_TEXTURE_2D, 0, internalFormat, m_Width, m_Height, 0, m_Format, GL_UNSIGNED_BYTE, NULL);
+		}
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	m_IsInitialized = true;
+	return true;
+}
+
+// the producer must have stopped
+void TextureStream::TerminateGL()
+{
+	if (!m_IsInitialized) return;
+
+	for (int i = 0; i < NUM_SLOTS; i++)
+	{
+		Slot& slot = m_Slots[i];
+		if (slot.fence != 0)
+		{
+			glDeleteSync(slot.fence);
+			slot.fence = 0;
+		}
+		if (m_IsPersistent)
+		{
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+			glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+			glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+			glDeleteBuffers(1, &slot.buffer);
+			slot.buffer = 0;
+		}
+		else
+		{
+			delete[] slot.p_Pixels;
+		}
+		slot.p_Pixels = nullptr;
+		glDeleteTextures(m_NumImages, slot.texture);
+		slot.state.store(SLOT_FREE);
+	}
+	m_DisplayedSlot = -1;
+	m_IsInitialized = false;
+}
+
+unsigned char* TextureStream::BeginWrite()
+{
+	if (!m_IsInitialized || m_WriteSlot >= 0) return nullptr;
+
+	for (int i = 0; i < NUM_SLOTS; i++)
+	{
+		int expected = SLOT_FREE;
+		if (m_Slots[i].state.compare_exchange_strong(expected, SLOT_WRITING, std::memory_order_acquire))
+		{
+			m_WriteSlot = i;
+			return m_Slots[i].p_Pixels;
+		}
+	}
+
+	// no free slot: overwrite the oldest frame that is not being uploaded yet
+	int oldest = -1;
+	for (int i = 0; i < NUM_SLOTS; i++)
+	{
+		if (m_Slots[i].state.load(std::memory_order_relaxed) == SLOT_WRITTEN &&
+			(oldest < 0 || m_Slots[i].sequence.load(std::memory_order_relaxed) < m_Slots[oldest].sequence.load(std::memory_order_relaxed)))
+		{
+			oldest = i;
+		}
+	}
+	if (oldest >= 0)
+	{
+		int expected = SLOT_WRITTEN;
+		if (m_Slots[oldest].state.compare_exchange_strong(expected, SLOT_WRITING, std::memory_order_acquire))
+		{
+			m_NumDropped.fetch_add(1, std::memory_order_relaxed);
+			m_WriteSlot = oldest;
+			return m_Slots[oldest].p_Pixels;
+		}
+	}
+	m_NumDropped.fetch_add(1, std::memory_order_relaxed); // the caller skips this frame
+	return nullptr;
+}
+
+void TextureStream::EndWrite(Clock::time_point captureTime)
+{
+	if (m_WriteSlot < 0) return;
+
+	Slot& slot = m_Slots[m_WriteSlot];
+	slot.captureTime = captureTime;
+	slot.sequence.store(m_NumWritten.fetch_add(1, std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+	slot.state.store(SLOT_WRITTEN, std::memory_order_release);
+	m_WriteSlot = -1;
+}
+
+bool TextureStream::Update()
+{
+	if (!m_IsInitialized) return false;
+
+	bool isChanged = false;
+
+	// show the newest upload that has finished
+	int completed = -1;
+	for (int i = 0; i < NUM_SLOTS; i++)
+	{
+		Slot& slot = m_Slots[i];
+		if (slot.state.load(std::memory_order_relaxed) != SLOT_UPLOADING) continue;
+
+		GLenum result = glClientWaitSync(slot.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+		if (result != GL_ALREADY_SIGNALED && result != GL_CONDITION_SATISFIED) continue;
+
+		glDeleteSync(slot.fence);
+		slot.fence = 0;
+		if (completed < 0 || slot.sequence.load(std::memory_order_relaxed) > m_Slots[completed].sequence.load(std::memory_order_relaxed))
+		{
+			if (completed >= 0)
+			{
+				m_Slots[completed].state.store(SLOT_FREE, std::memory_order_release);
+				m_NumDropped.fetch_add(1, std::memory_order_relaxed);
+			}
+			completed = i;
+		}
+		else
+		{
+			slot.state.store(SLOT_FREE, std::memory_order_release);
+			m_NumDropped.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+	if (completed >= 0)
+	{
+		Display(completed);
+		isChanged = true;
+	}
+
+	// start uploading the newest written frame, and drop the older ones
+	int newest = -1;
+	uint64_t newestSequence = 0;
+	for (int i = 0; i < NUM_SLOTS; i++)
+	{
+		if (m_Slots[i].state.load(std::memory_order_acquire) != SLOT_WRITTEN) continue;
+
+		uint64_t sequence = m_Slots[i].sequence.load(std::memory_order_relaxed);
+		if (newest < 0 || sequence > newestSequence)
+		{
+			newest = i;
+			newestSequence = sequence;
+		}
+	}
+	if (newest < 0) return isChanged;
+
+	for (int i = 0; i < NUM_SLOTS; i++)
+	{
+		int expected = SLOT_WRITTEN;
+		if (i == newest)
+		{
+			if (m_Slots[i].state.compare_exchange_strong(expected, SLOT_UPLOADING, std::memory_order_acquire))
+			{
+				Upload(i);
+				isChanged |= !m_IsPersistent;
+			}
+		}
+		else if (m_Slots[i].sequence.load(std::memory_order_relaxed) < newestSequence)
+		{
+			// claim the slot before checking again: the producer may have
+			// overwritten it with a newer frame since the scan
+			if (m_Slots[i].state.compare_exchange_strong(expected, SLOT_UPLOADING, std::memory_order_acquire))
+			{
+				if (m_Slots[i].sequence.load(std::memory_order_relaxed) < newestSequence)
+				{
+					m_Slots[i].state.store(SLOT_FREE, std::memory_order_release);
+					m_NumDropped.fetch_add(1, std::memory_order_relaxed);
+				}
+				else
+				{
+					m_Slots[i].state.store(SLOT_WRITTEN, std::memory_order_release);
+				}
+			}
+		}
+	}
+	return isChanged;
+}
+
+GLuint TextureStream::texture(int image) const
+{
+	if (m_DisplayedSlot < 0 || image < 0 || image >= m_NumImages) return 0;
+	return m_Slots[m_DisplayedSlot].texture[image];
+}
+
+void TextureStream::Upload(int index)
+{
+	Slot& slot = m_Slots[index];
+
+	// from a bound pixel buffer the last argument is an offset, and the copy
+	// is queued instead of being done before glTexSubImage2D returns
+	if (m_IsPersistent)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, slot.buffer);
+	}
+	for (int image = 0; image < m_NumImages; image++)
+	{
+		size_t offset = image * m_ImageSize;
+		const void* pixels = m_IsPersistent ?
+			reinterpret_cast<const void*>(offset) : static_cast<const void*>(slot.p_Pixels + offset);
+		glBindTexture(GL_TEXTURE_2D, slot.texture[image]);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_Width, m_Height, m_Format, GL_UNSIGNED_BYTE, pixels);
+	}
+	glBindTexture(GL_TEXTURE_2D, 0);
+	m_NumUploaded++;
+
+	if (m_IsPersistent)
+	{
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		slot.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+	else
+	{
+		Display(index);
+	}
+}
+
+void TextureStream::Display(int index)
+{
+	if (m_DisplayedSlot >= 0 && m_DisplayedSlot != index)
+	{
+		m_Slots[m_DisplayedSlot].state.store(SLOT_FREE, std::memory_order_release);
+	}
+	m_DisplayedSlot = index;
+	m_Slots[index].state.store(SLOT_DISPLAYED, std::memory_order_relaxed);
+
+	m_LastLatency = std::chrono::duration<double>(Clock::now() - m_Slots[index].captureTime).count();
+	m_TotalLatency += m_LastLatency;
+	m_NumDisplayed++;
+}
@@ -0,0 +1,125 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// texture_stream.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../settings.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// TextureStream: streams camera images into textures without stalling the
+// display thread.
+//
+//   Each of the NUM_SLOTS slots has one pixel buffer object, persistently
+//   mapped, holding numImages images (e.g. the left and right camera), and
+//   a texture per image. The producer (the camera thread, which needs no GL
+//   context) writes a frame straight into the mapped memory of a free slot:
+//
+//     unsigned char* pixels = stream.BeginWrite();
+//     if (pixels) { copy the images to pixels + i * imageSize(); stream.EndWrite(captureTime); }
+//
+//   A slot is published only by EndWrite(), so the images of one slot are
+//   always from the same capture (a complete stereo pair).
+//
+//   Once per frame the display thread calls Update(), which starts the
+//   upload of the newest written frame from its buffer to its textures
+//   (an asynchronous DMA, followed by a fence), and switches texture() to
+//   a slot only after its fence has signaled. So the display thread never
+//   waits for the transfer; the image it shows is at most one frame older.
+//
+//   If the producer is faster than the display, a written frame that has
+//   not been uploaded yet is overwritten. Such frames are counted as dropped,
+//   and for each frame that is displayed the time from its capture to the
+//   Update() that shows it is measured. Without GL_ARB_buffer_storage the
+//   slots are plain memory and Update() uploads with glTexSubImage2D.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class TextureStream {
+public:
+	typedef std::chrono::steady_clock Clock;
+
+	static const int NUM_SLOTS = 4; // displayed, uploading, written, writing
+	static const int MAX_IMAGES = 2;
+
+	TextureStream();
+	~TextureStream();
+
+	// display thread (GL)
+	bool InitGL(int width, int height, int pixelSize, GLenum format, int numImages);
+	void TerminateGL();
+	bool Update(); // true if texture() changed
+	GLuint texture(int image) const;
+	bool IsPersistent() const { return m_IsPersistent; }
+
+	// producer
+	unsigned char* BeginWrite(); // nullptr if every slot is in use
+	void EndWrite(Clock::time_point captureTime = Clock::now());
+	size_t imageSize() const { return m_ImageSize; }
+
+	// counters
+	uint64_t writtenFrames() const { return m_NumWritten.load(std::memory_order_relaxed); }
+	uint64_t uploadedFrames() const { return m_NumUploaded; }
+	uint64_t displayedFrames() const { return m_NumDisplayed; }
+	uint64_t droppedFrames() const { return m_NumDropped.load(std::memory_order_relaxed); } // captured but never displayed
+	double lastLatency() const { return m_LastLatency; } // seconds from capture to display
+	double averageLatency() const { return m_NumDisplayed > 0 ? m_TotalLatency / m_NumDisplayed : 0.0; }
+
+private:
+	enum SLOT_STATE {
+		SLOT_FREE = 0,
+		SLOT_WRITING,
+		SLOT_WRITTEN,
+		SLOT_UPLOADING,
+		SLOT_DISPLAYED
+	};
+
+	struct Slot
+	{
+		std::atomic<int>      state;
+		std::atomic<uint64_t> sequence; // set before the slot is WRITTEN
+		Clock::time_point captureTime;
+		unsigned char* p_Pixels;
+		GLuint         buffer;
+		GLuint         texture[MAX_IMAGES];
+		GLsync         fence;
+	};
+
+	Slot     m_Slots[NUM_SLOTS];
+	int      m_Width, m_Height, m_PixelSize;
+	GLenum   m_Format;
+	int      m_NumImages;
+	size_t   m_ImageSize;
+	bool     m_IsPersistent;
+	bool     m_IsInitialized;
+
+	int      m_WriteSlot;     // producer
+	std::atomic<uint64_t> m_NumWritten;
+	std::atomic<uint64_t> m_NumDropped;
+	int      m_DisplayedSlot; // display thread
+	uint64_t m_NumUploaded;
+	uint64_t m_NumDisplayed;
+	double   m_LastLatency;
+	double   m_TotalLatency;
+
+	void Upload(int index);
+	void Display(int index);
+};
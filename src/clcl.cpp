@@ -12,28 +12,31 @@
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "hmd/openvr/openvr.h"
+#include "hmd/null/nullhmd.h"
+#include "hmd/replay/replay_hmd.h"
+#include "sync/rwlock.h"
 
 #include "clcl.h"
 
+#include <cstdarg>
+#include <cstring>
+
 CLCL *p_CLCL = nullptr;
 
-const int CONTROLLER_BUTTON1 = GLFW_MOUSE_BUTTON_LEFT;
-const int CONTROLLER_BUTTON2 = GLFW_MOUSE_BUTTON_MIDDLE;
-const int CONTROLLER_BUTTON3 = GLFW_MOUSE_BUTTON_RIGHT;
-const int CONTROLLER_BUTTON4 = GLFW_MOUSE_BUTTON_4;
+const int CONTROLLER_BUTTON1 = 0; // GLFW_MOUSE_BUTTON_LEFT
+const int CONTROLLER_BUTTON2 = 2; // GLFW_MOUSE_BUTTON_MIDDLE
+const int CONTROLLER_BUTTON3 = 1; // GLFW_MOUSE_BUTTON_RIGHT
+const int CONTROLLER_BUTTON4 = 3; // GLFW_MOUSE_BUTTON_4
 
 class CLCL::Impl
 {
 public:
-	OpenVR* p_HMD;
-	int   m_ButtonState[4];
+	HMD*  p_HMD;
 
 	bool   m_IsThreadRunning;
 
-	OpenVR* hmd() { return p_HMD; }
+	HMD*  hmd() { return p_HMD; }
 	llong frameIndex() { return p_HMD->frameIndex(); }
-	int   buttonState(int button) { return m_ButtonState[button - 1]; }
-	void  SetButtonState(int button, int state) { m_ButtonState[button - 1] = state; }
 
 	void  StartThread();
 	void  StopThread();
@@ -96,37 +99,31 @@ void CAVENavLoadMatrix(float matrix[4][4])
 
 void CAVENavTranslate(float xtrans, float ytrans, float ztrans)
 {
-//	if (p_CLCL->navLockState()) return;
 	p_CLCL->p_Impl->hmd()->Translate(xtrans, ytrans, ztrans);
 }
 
 void CAVENavRot(float angle, char axis)
 {
-//	if (p_CLCL->navLockState()) return;
 	p_CLCL->p_Impl->hmd()->Rotate(angle, axis);
 }
 
 void CAVENavScale(float xscale, float yscale, float zscale)
 {
-//	if (p_CLCL->navLockState()) return;
 	p_CLCL->p_Impl->hmd()->Scale(xscale, yscale, zscale);
 }
 
 void CAVENavWorldTranslate(float xtrans, float ytrans, float ztrans)
 {
-//	if (p_CLCL->navLockState()) return;
 	p_CLCL->p_Impl->hmd()->WorldTranslate(xtrans, ytrans, ztrans);
 }
 
 void CAVENavWorldRot(float angle, char axis)
 {
-//	if (p_CLCL->navLockState()) return;
 	p_CLCL->p_Impl->hmd()->WorldRotate(angle, axis);
 }
 
 void CAVENavWorldScale(float xscale, float yscale, float zscale)
 {
-//	if (p_CLCL->navLockState()) return;
 	p_CLCL->p_Impl->hmd()->WorldScale(xscale, yscale, zscale);
 }
 
@@ -152,14 +149,8 @@ void CAVENavPreMultMatrix(float matrix[4][4])
 
 bool CAVEgetbutton(CAVEDevice device)
 {
-	if (p_CLCL->p_Impl->hmd()->GetKey(device))
-	{
-		return true;
-	}
-	else
-	{
-		return false;
-	}
+	// keys are not in the controller snapshot; they come from the input events
+	return p_CLCL->p_Impl->hmd()->input().IsPressed(INPUT_KEY, device);
 }
 
 void CAVEGetPosition(CAVEID id, float position[3])
@@ -356,6 +347,56 @@ void CAVEGetVector(CAVEID id, float vector[3])
 	}
 }
 
+bool CAVEGetPositionAt(CAVEID id, float time, float position[3])
+{
+	TrackingState state;
+	if (!p_CLCL->p_Impl->hmd()->GetTrackingStateAt(time, state)) return false;
+
+	bool isWand = (id == CAVE_WAND || id == CAVE_WAND_NAV) && p_CLCL->p_Impl->hmd()->IsControllerConnected();
+	bool isNav = (id == CAVE_HEAD_NAV || id == CAVE_WAND_NAV);
+	const DeviceState& device = isWand ? state.hand : state.head;
+	const glm::vec3& translation = isNav ? device.translationNav : device.translation;
+	position[0] = translation.x;
+	position[1] = translation.y;
+	position[2] = translation.z;
+	return true;
+}
+
+bool CAVEGetVectorAt(CAVEID id, float time, float vector[3])
+{
+	bool isWand = false;
+	bool isNav = false;
+	VECTOR_TYPE type = VECTOR_FRONT;
+	switch (id)
+	{
+		case CAVE_HEAD_FRONT:     type = VECTOR_FRONT; break;
+		case CAVE_HEAD_UP:        type = VECTOR_UP;    break;
+		case CAVE_HEAD_RIGHT:     type = VECTOR_RIGHT; break;
+		case CAVE_HEAD_FRONT_NAV: type = VECTOR_FRONT; isNav = true; break;
+		case CAVE_HEAD_UP_NAV:    type = VECTOR_UP;    isNav = true; break;
+		case CAVE_HEAD_RIGHT_NAV: type = VECTOR_RIGHT; isNav = true; break;
+		case CAVE_WAND_FRONT:     type = VECTOR_FRONT; isWand = true; break;
+		case CAVE_WAND_UP:        type = VECTOR_UP;    isWand = true; break;
+		case CAVE_WAND_RIGHT:     type = VECTOR_RIGHT; isWand = true; break;
+		case CAVE_WAND_FRONT_NAV: type = VECTOR_FRONT; isWand = true; isNav = true; break;
+		case CAVE_WAND_UP_NAV:    type = VECTOR_UP;    isWand = true; isNav = true; break;
+		case CAVE_WAND_RIGHT_NAV: type = VECTOR_RIGHT; isWand = true; isNav = true; break;
+		default:
+			return false;
+	}
+
+	TrackingState state;
+	if (!p_CLCL->p_Impl->hmd()->GetTrackingStateAt(time, state)) return false;
+
+	isWand = isWand && p_CLCL->p_Impl->hmd()->IsControllerConnected();
+	const DeviceState& device = isWand ? state.hand : state.head;
+	const glm::vec3& result = isNav ? device.vectorNav[type] : device.vector[type];
+	vector[0] = result.x;
+	vector[1] = result.y;
+	vector[2] = result.z;
+	return true;
+}
+
 void  CAVEGetOrientation(CAVEID id, float angle[3])
 {
 	// not implemented yet
@@ -411,6 +452,27 @@ void CAVESetOption(CAVEID option, int value)
 	{
 		case CAVE_SHMEM_SIZE:
 			break;
+		case CAVE_SHMEM_SNAPSHOT:
+			p_CLCL->p_Impl->hmd()->sharedSnapshot().SetEnabled(value != 0);
+			break;
+		case CAVE_MIRROR_MODE:
+			p_CLCL->p_Impl->hmd()->SetMirrorMode(value);
+			break;
+		case CAVE_MIRROR_INTERVAL:
+			p_CLCL->p_Impl->hmd()->SetMirrorInterval(value);
+			break;
+		case CAVE_PREDICT_POSES:
+			p_CLCL->p_Impl->hmd()->SetPredictionEnabled(value != 0);
+			break;
+		case CAVE_LATE_LATCH:
+			p_CLCL->p_Impl->hmd()->SetLateLatchEnabled(value != 0);
+			break;
+		case CAVE_SIM_DRAWTIMING:
+			p_CLCL->p_Impl->hmd()->SetHUDEnabled(value != 0);
+			break;
+		case CAVE_APP_RATE:
+			p_CLCL->p_Impl->hmd()->SetApplicationRate(value);
+			break;
 		default:
 			break;
 	}
@@ -418,7 +480,7 @@ void CAVESetOption(CAVEID option, int value)
 
 float CAVEGetTime()
 {
-	return static_cast<float>(glfwGetTime());
+	return static_cast<float>(p_CLCL->p_Impl->hmd()->GetTime());
 }
 
 int CAVEButtonChange(int buttonNumber)
@@ -427,44 +489,26 @@ int CAVEButtonChange(int buttonNumber)
 	//  "1" indicates the button has been pressed
 	// "-1" indicates the button has been released
 
-	GLFWwindow* window = p_CLCL->p_Impl->hmd()->window();
-	int state = -1;
-
+	// every press and release is reported, in order and one per step, from
+	// the input events
 	if (p_CLCL->p_Impl->hmd()->IsControllerConnected())
 	{
 		// if controller is connected
-		state = p_CLCL->p_Impl->hmd()->GetButtonState(buttonNumber);
-	}
-	else
-	{
-		switch (buttonNumber)
-		{
-			case 1:
-				state = p_CLCL->p_Impl->hmd()->GetMouseButton(CONTROLLER_BUTTON1);
-				break;
-			case 2:
-				state = p_CLCL->p_Impl->hmd()->GetMouseButton(CONTROLLER_BUTTON2);
-				break;
-			case 3:
-				state = p_CLCL->p_Impl->hmd()->GetMouseButton(CONTROLLER_BUTTON3);
-				break;
-			case 4:
-				state = p_CLCL->p_Impl->hmd()->GetMouseButton(CONTROLLER_BUTTON4);
-				break;
-			default:
-				break;
-		}
+		return p_CLCL->p_Impl->hmd()->input().ButtonChange(INPUT_CONTROLLER_BUTTON, buttonNumber);
 	}
 
-	if (p_CLCL->p_Impl->buttonState(buttonNumber) == state)
+	switch (buttonNumber)
 	{
-		return 0;
-	}
-	else
-	{
-		p_CLCL->p_Impl->SetButtonState(buttonNumber, state);
-		if (state == GLFW_PRESS) return 1;
-		else if (state == GLFW_RELEASE) return -1;
+		case 1:
+			return p_CLCL->p_Impl->hmd()->input().ButtonChange(INPUT_MOUSE_BUTTON, CONTROLLER_BUTTON1);
+		case 2:
+			return p_CLCL->p_Impl->hmd()->input().ButtonChange(INPUT_MOUSE_BUTTON, CONTROLLER_BUTTON2);
+		case 3:
+			return p_CLCL->p_Impl->hmd()->input().ButtonChange(INPUT_MOUSE_BUTTON, CONTROLLER_BUTTON3);
+		case 4:
+			return p_CLCL->p_Impl->hmd()->input().ButtonChange(INPUT_MOUSE_BUTTON, CONTROLLER_BUTTON4);
+		default:
+			break;
 	}
 
 	return 0;
@@ -472,52 +516,56 @@ int CAVEButtonChange(int buttonNumber)
 
 void CAVEUSleep(unsigned long milliseconds)
 {
+	// the application loop sleeps once per simulation step
+	if (!p_CLCL->p_Impl->hmd()->IsDisplayThread())
+	{
+		p_CLCL->p_Impl->hmd()->sharedSnapshot().Publish();
+		p_CLCL->p_Impl->hmd()->TickApplication();
+		p_CLCL->p_Impl->hmd()->input().EndStep();
+	}
+
+#ifdef _WIN32
 	Sleep(milliseconds);
+#else
+	std::this_thread::sleep_for(std::chrono::milliseconds(milliseconds));
+#endif // _WIN32
+}
+
+long long CAVEWaitForFrame()
+{
+	if (p_CLCL->p_Impl->hmd()->IsDisplayThread()) return 0; // it would wait for itself
+
+	// the end of an application step, as in CAVEUSleep()
+	p_CLCL->p_Impl->hmd()->sharedSnapshot().Publish();
+	p_CLCL->p_Impl->hmd()->TickApplication();
+	p_CLCL->p_Impl->hmd()->input().EndStep();
+
+	return p_CLCL->p_Impl->hmd()->WaitForFrame();
 }
 
 bool IsButtonPressed(const int button)
 {
+	// the controller from the input snapshot of this step, the mouse from
+	// the input events
 	if (p_CLCL->p_Impl->hmd()->IsControllerConnected())
 	{
-		vr::VRControllerState_t controllerState;
-		controllerState = p_CLCL->p_Impl->hmd()->controllerState();
-		uint64_t buttonState = controllerState.ulButtonPressed;
-		uint64_t buttonMask;
-
 		switch (button)
 		{
 			case CONTROLLER_BUTTON1:
-				if (p_CLCL->p_Impl->hmd()->GetDeviceType() == OCULUS_RIFT_CV1)
-				{
-					buttonMask = vr::ButtonMaskFromId(vr::EVRButtonId::k_EButton_A); // for Oculus
-				}
-				else
-				{
-					buttonMask = vr::ButtonMaskFromId(vr::EVRButtonId::k_EButton_Grip); // for HTC VIVE
-				}
-				if (buttonState & buttonMask) return true;
-				break;
+				return p_CLCL->p_Impl->hmd()->IsControllerButtonPressed(1);
 			case CONTROLLER_BUTTON2:
-				if (controllerState.rAxis[1].x > 0.5f) return true;
-				break;
+				return p_CLCL->p_Impl->hmd()->IsControllerButtonPressed(2);
 			case CONTROLLER_BUTTON3:
-				buttonMask = vr::ButtonMaskFromId(vr::EVRButtonId::k_EButton_ApplicationMenu);
-				if (buttonState & buttonMask) return true;
-				break;
+				return p_CLCL->p_Impl->hmd()->IsControllerButtonPressed(3);
 			case CONTROLLER_BUTTON4:
-				// not implemented
-				break;
+				return p_CLCL->p_Impl->hmd()->IsControllerButtonPressed(4);
 			default:
 				break;
 		}
 	}
 	else
 	{
-		int state = p_CLCL->p_Impl->hmd()->GetMouseButton(button);
-		if (state == GLFW_PRESS)
-		{
-			return true;
-		}
+		return p_CLCL->p_Impl->hmd()->input().IsPressed(INPUT_MOUSE_BUTTON, button);
 	}
 
 	return false;
@@ -538,6 +586,7 @@ void CAVEConfigure(int *argc, char **argv, char **appdefaults)
 
 void CAVEInit()
 {
+	p_CLCL->p_Impl->hmd()->sharedSnapshot().Publish(); // initial contents
 	p_CLCL->p_Impl->StartThread();
 }
 
@@ -613,12 +662,26 @@ void CAVEFrameFunction(CAVECALLBACK callback, int arg_num, ...)
 
 void* CAVEMalloc(size_t size)
 {
-	return malloc(size);
+	return p_CLCL->p_Impl->hmd()->sharedSnapshot().Allocate(size);
 }
 
 void  CAVEFree(void* ptr)
 {
-	free(ptr);
+	p_CLCL->p_Impl->hmd()->sharedSnapshot().Free(ptr);
+}
+
+void  CAVEPublishSharedData()
+{
+	p_CLCL->p_Impl->hmd()->sharedSnapshot().Publish();
+}
+
+void* CAVESharedDataPtr(void* ptr)
+{
+	if (p_CLCL->p_Impl->hmd()->IsDisplayThread())
+	{
+		return p_CLCL->p_Impl->hmd()->sharedSnapshot().Translate(ptr);
+	}
+	return ptr;
 }
 
 long long CAVEGetFrameNumber()
@@ -640,34 +703,123 @@ CAVEID CAVEProcessType()
 	return CAVE_APP_PROCESS;
 }
 
-CAVELOCK CAVENewLock() { return nullptr; }
-void CAVEFreeLock(CAVELOCK lock) {}
-void CAVESetReadLock(CAVELOCK lock) {}
-void CAVESetWriteLock(CAVELOCK lock) {}
-void CAVEUnsetReadLock(CAVELOCK lock) {}
-void CAVEUnsetWriteLock(CAVELOCK lock) {}
+CAVELOCK CAVENewLock()
+{
+	return new RWSpinLock();
+}
+
+void CAVEFreeLock(CAVELOCK lock)
+{
+	delete static_cast<RWSpinLock*>(lock);
+}
+
+void CAVESetReadLock(CAVELOCK lock)
+{
+	if (lock == nullptr) return;
+	static_cast<RWSpinLock*>(lock)->LockRead();
+}
+
+void CAVESetWriteLock(CAVELOCK lock)
+{
+	if (lock == nullptr) return;
+	static_cast<RWSpinLock*>(lock)->LockWrite();
+}
+
+void CAVEUnsetReadLock(CAVELOCK lock)
+{
+	if (lock == nullptr) return;
+	static_cast<RWSpinLock*>(lock)->UnlockRead();
+}
+
+void CAVEUnsetWriteLock(CAVELOCK lock)
+{
+	if (lock == nullptr) return;
+	static_cast<RWSpinLock*>(lock)->UnlockWrite();
+}
+
+void CAVEGetLockStats(CAVELOCK lock, CAVELOCKSTATS *stats)
+{
+	if (stats == nullptr) return;
+	RWLockStats lockStats = {};
+	if (lock != nullptr)
+	{
+		static_cast<RWSpinLock*>(lock)->GetStats(&lockStats);
+	}
+	stats->readLocks      = lockStats.readLocks;
+	stats->writeLocks     = lockStats.writeLocks;
+	stats->readContended  = lockStats.readContended;
+	stats->writeContended = lockStats.writeContended;
+	stats->readWaitNS     = lockStats.readWaitNS;
+	stats->writeWaitNS    = lockStats.writeWaitNS;
+	stats->writeHoldNS    = lockStats.writeHoldNS;
+	stats->maxWriteHoldNS = lockStats.maxWriteHoldNS;
+	stats->readHoldSamples = lockStats.readHoldSamples;
+	stats->readHoldNS     = lockStats.readHoldNS;
+	stats->maxReadHoldNS  = lockStats.maxReadHoldNS;
+}
+
+void CAVEResetLockStats(CAVELOCK lock)
+{
+	if (lock == nullptr) return;
+	static_cast<RWSpinLock*>(lock)->ResetStats();
+}
 
-void CAVENavLock() {}
-void CAVENavUnlock() {}
+void CAVENavLock()
+{
+	p_CLCL->p_Impl->hmd()->NavigationLock();
+}
+
+void CAVENavUnlock()
+{
+	p_CLCL->p_Impl->hmd()->NavigationUnlock();
+}
+
+// the navigation matrix maps world coordinates to CAVE coordinates
+static void NavConvert(bool toWorld, bool isVector, const float in[][3], float out[][3], int count)
+{
+	if (count <= 0) return;
+	glm::mat4 matrix = p_CLCL->p_Impl->hmd()->CurrentNavigationMatrix(toWorld);
+	NavigationTransform::TransformPoints(matrix, in, out, count, isVector);
+}
 
 void CAVENavConvertCAVEToWorld(float inposition[3], float outposition[3])
 {
-	// not implemented yet
+	NavConvert(true, false, reinterpret_cast<float(*)[3]>(inposition), reinterpret_cast<float(*)[3]>(outposition), 1);
 }
 
 void CAVENavConvertVectorCAVEToWorld(float invector[3], float outvector[3])
 {
-	// not implemented yet
+	NavConvert(true, true, reinterpret_cast<float(*)[3]>(invector), reinterpret_cast<float(*)[3]>(outvector), 1);
 }
 
 void CAVENavConvertWorldToCAVE(float inposition[3], float outposition[3])
 {
-	// not implemented yet
+	NavConvert(false, false, reinterpret_cast<float(*)[3]>(inposition), reinterpret_cast<float(*)[3]>(outposition), 1);
 }
 
 void CAVENavConvertVectorWorldToCAVE(float invector[3], float outvector[3])
 {
-	// not implemented yet
+	NavConvert(false, true, reinterpret_cast<float(*)[3]>(invector), reinterpret_cast<float(*)[3]>(outvector), 1);
+}
+
+void CAVENavConvertCAVEToWorldN(int count, float inposition[][3], float outposition[][3])
+{
+	NavConvert(true, false, inposition, outposition, count);
+}
+
+void CAVENavConvertVectorCAVEToWorldN(int count, float invector[][3], float outvector[][3])
+{
+	NavConvert(true, true, invector, outvector, count);
+}
+
+void CAVENavConvertWorldToCAVEN(int count, float inposition[][3], float outposition[][3])
+{
+	NavConvert(false, false, inposition, outposition, count);
+}
+
+void CAVENavConvertVectorWorldToCAVEN(int count, float invector[][3], float outvector[][3])
+{
+	NavConvert(false, true, invector, outvector, count);
 }
 
 void CAVEGetViewport(int *origX, int *origY, int *width, int *height)
@@ -681,20 +833,34 @@ void sginap(unsigned long milliseconds)
 	CAVEUSleep(milliseconds);
 }
 
+static HMD* CreateHMD()
+{
+	const char* replay = getenv("CLCL_REPLAY");
+	if (replay != nullptr && replay[0] != '\0')
+	{
+		return new ReplayHMD();
+	}
+#ifdef USE_OPENVR
+	const char* backend = getenv("CLCL_HMD");
+	if (backend == nullptr || strcmp(backend, "null") != 0)
+	{
+		return new OpenVR();
+	}
+#endif // USE_OPENVR
+	return new NullHMD();
+}
+
 CLCL::CLCL()
 {
 	p_Impl = new Impl();
 
-	p_Impl->p_HMD = new OpenVR();
-	for (int i = 0; i < 4; i++)
-	{
-		p_Impl->m_ButtonState[i] = -1;
-	}
+	p_Impl->p_HMD = CreateHMD();
 	p_Impl->m_IsThreadRunning = true;
 }
 
 CLCL::~CLCL()
 {
+	delete p_Impl->p_HMD;
 	delete p_Impl;
 }
 
@@ -102,7 +102,15 @@ typedef enum {
 	CAVE_SIM_DRAWUSER,
 	CAVE_SIM_DRAWWAND,
 	CAVE_SIM_VIEWMODE,
-	CAVE_TRACKER_SIGNALRESET
+	CAVE_TRACKER_SIGNALRESET,
+
+	// CLCL extensions
+	CAVE_SHMEM_SNAPSHOT,
+	CAVE_MIRROR_MODE,     // 0: off, 1: left eye, 2: both eyes
+	CAVE_MIRROR_INTERVAL, // update the mirror window every N frames
+	CAVE_PREDICT_POSES,   // CAVEGetPosition/CAVEGetVector predicted to the display time
+	CAVE_LATE_LATCH,      // re-query the head pose before each eye is rendered
+	CAVE_APP_RATE         // CAVEWaitForFrame(): 0 each display frame, N at N Hz, -1 at the display rate
 
 } CAVEID;
 
@@ -258,8 +266,29 @@ void  CAVEStopApplication(CAVECALLBACK callback, int arg_num, ...);
 void* CAVEMalloc(size_t size);
 void  CAVEFree(void* ptr);
 
+// CAVE_SHMEM_SNAPSHOT: CAVEMalloc memory is triple-buffered. The application
+// thread publishes a consistent copy once per step (CAVEUSleep() publishes
+// automatically), and the display thread draws the copy latched at the start
+// of the frame. Pointers into CAVEMalloc memory passed to the callbacks are
+// translated; use CAVESharedDataPtr() for pointers reached in other ways.
+void  CAVEPublishSharedData();
+void* CAVESharedDataPtr(void* ptr);
+
+// CLCL extension: CAVEGetPosition() / CAVEGetVector() at a time of
+// CAVEGetTime(), interpolated from the recent tracking history (about one
+// second). Returns false if there is no tracking data yet.
+bool  CAVEGetPositionAt(CAVEID id, float time, float position[3]);
+bool  CAVEGetVectorAt(CAVEID id, float time, float vector[3]);
+
 long long CAVEGetFrameNumber();
 
+// CLCL extension: ends a step of the application loop like CAVEUSleep(),
+// then waits until the display thread has published the poses of a new
+// frame (or for the next tick of CAVE_APP_RATE), instead of sleeping for a
+// fixed time. Returns the number of frames since the previous call, which
+// is more than 1 if the application fell behind, and 0 on timeout.
+long long CAVEWaitForFrame();
+
 CAVEID CAVEProcessType();
 
 typedef void *CAVELOCK;
@@ -269,12 +298,40 @@ void CAVESetReadLock(CAVELOCK lock);
 void CAVESetWriteLock(CAVELOCK lock);
 void CAVEUnsetReadLock(CAVELOCK lock);
 void CAVEUnsetWriteLock(CAVELOCK lock);
+
+// CLCL extension: contention counters of a lock created by CAVENewLock().
+// Times are in nanoseconds and accumulate until CAVEResetLockStats() is
+// called, e.g. once per frame to get the per-frame hold times. Every write
+// hold is timed, but only one in 16 read holds (readHoldSamples of them),
+// so the read path stays cheap.
+typedef struct {
+	unsigned long long readLocks;
+	unsigned long long writeLocks;
+	unsigned long long readContended;
+	unsigned long long writeContended;
+	unsigned long long readWaitNS;
+	unsigned long long writeWaitNS;
+	unsigned long long writeHoldNS;
+	unsigned long long maxWriteHoldNS;
+	unsigned long long readHoldSamples;
+	unsigned long long readHoldNS;
+	unsigned long long maxReadHoldNS;
+} CAVELOCKSTATS;
+void CAVEGetLockStats(CAVELOCK lock, CAVELOCKSTATS *stats);
+void CAVEResetLockStats(CAVELOCK lock);
+// navigation edits between CAVENavLock() and CAVENavUnlock() are shown
+// to the display thread together, from the next frame on
 void CAVENavLock();
 void CAVENavUnlock();
 void CAVENavConvertCAVEToWorld(float inposition[3], float outposition[3]);
 void CAVENavConvertVectorCAVEToWorld(float invector[3], float outvector[3]);
 void CAVENavConvertWorldToCAVE(float inposition[3], float outposition[3]);
 void CAVENavConvertVectorWorldToCAVE(float invector[3], float outvector[3]);
+// CLCL extension: the above for count points / vectors in one call
+void CAVENavConvertCAVEToWorldN(int count, float inposition[][3], float outposition[][3]);
+void CAVENavConvertVectorCAVEToWorldN(int count, float invector[][3], float outvector[][3]);
+void CAVENavConvertWorldToCAVEN(int count, float inposition[][3], float outposition[][3]);
+void CAVENavConvertVectorWorldToCAVEN(int count, float invector[][3], float outvector[][3]);
 void CAVEGetViewport(int *origX, int *origY, int *width, int *height);
 void CAVESetOption(CAVEID option, int value);
 
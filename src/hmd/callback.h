@@ -0,0 +1,149 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// callback.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../sync/snapshot.h"
+#include "../sync/triple_buffer.h"
+
+#include <vector>
+#include <iostream>
+
+typedef void(*HMDCALLBACK)();
+typedef void(*HMDCALLBACK1)(void*);
+typedef void(*HMDCALLBACK2)(void*, void*);
+typedef void(*HMDCALLBACK3)(void*, void*, void*);
+typedef void(*HMDCALLBACK4)(void*, void*, void*, void*);
+typedef void(*HMDCALLBACK5)(void*, void*, void*, void*, void*);
+typedef void(*HMDCALLBACK6)(void*, void*, void*, void*, void*, void*);
+typedef void(*HMDCALLBACK7)(void*, void*, void*, void*, void*, void*, void*);
+typedef void(*HMDCALLBACK8)(void*, void*, void*, void*, void*, void*, void*, void*);
+typedef void(*HMDCALLBACK9)(void*, void*, void*, void*, void*, void*, void*, void*, void*);
+typedef void(*HMDCALLBACK10)(void*, void*, void*, void*, void*, void*, void*, void*, void*, void*);
+
+// the maximum number of arguments CAVELib allows for a callback
+const int CALLBACK_MAX_ARGS = 10;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// HMDCallback: a callback and its arguments, bound once and invoked per frame.
+//
+//   Bind() is called by the application thread (CAVEDisplay() etc.) and
+//   publishes the binding through a triple buffer. Latch() is called by the
+//   display thread at the start of a frame; it picks up a new binding and
+//   translates arguments pointing into CAVEMalloc memory to the latched
+//   snapshot. Invoke() only reads the latched copy, so the frame loop does
+//   not allocate.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class HMDCallback {
+public:
+	HMDCallback()
+	{
+		Binding empty = {};
+		m_Binding.Reset(empty);
+		m_Latched = empty;
+	}
+
+	// application thread
+	void Bind(HMDCALLBACK function, const std::vector<void*>& args)
+	{
+		Binding& binding = m_Binding.back();
+		binding.function = function;
+		binding.numArgs = static_cast<int>(args.size());
+		if (binding.numArgs > CALLBACK_MAX_ARGS)
+		{
+			std::cerr << "WARNING: too many callback arguments (max " << CALLBACK_MAX_ARGS << ")" << std::endl;
+			binding.numArgs = CALLBACK_MAX_ARGS;
+		}
+		for (int i = 0; i < binding.numArgs; i++)
+		{
+			binding.args[i] = args[i];
+		}
+		m_Binding.Publish();
+	}
+
+	// display thread
+	void Latch(const SharedSnapshot& snapshot, bool isSnapshotChanged)
+	{
+		if (!m_Binding.Acquire() && !isSnapshotChanged) return;
+
+		const Binding& binding = m_Binding.front();
+		m_Latched.function = binding.function;
+		m_Latched.numArgs = binding.numArgs;
+		for (int i = 0; i < binding.numArgs; i++)
+		{
+			m_Latched.args[i] = snapshot.Translate(binding.args[i]);
+		}
+	}
+
+	bool IsBound() const { return m_Latched.function != nullptr; }
+
+	void Invoke() const
+	{
+		HMDCALLBACK function = m_Latched.function;
+		void* const* args = m_Latched.args;
+		if (function == nullptr) return;
+
+		switch (m_Latched.numArgs)
+		{
+			case 0:
+				function();
+				break;
+			case 1:
+				((HMDCALLBACK1)function)(args[0]);
+				break;
+			case 2:
+				((HMDCALLBACK2)function)(args[0], args[1]);
+				break;
+			case 3:
+				((HMDCALLBACK3)function)(args[0], args[1], args[2]);
+				break;
+			case 4:
+				((HMDCALLBACK4)function)(args[0], args[1], args[2], args[3]);
+				break;
+			case 5:
+				((HMDCALLBACK5)function)(args[0], args[1], args[2], args[3], args[4]);
+				break;
+			case 6:
+				((HMDCALLBACK6)function)(args[0], args[1], args[2], args[3], args[4], args[5]);
+				break;
+			case 7:
+				((HMDCALLBACK7)function)(args[0], args[1], args[2], args[3], args[4], args[5], args[6]);
+				break;
+			case 8:
+				((HMDCALLBACK8)function)(args[0], args[1], args[2], args[3], args[4], args[5], args[6], args[7]);
+				break;
+			case 9:
+				((HMDCALLBACK9)function)(args[0], args[1], args[2], args[3], args[4], args[5], args[6], args[7], args[8]);
+				break;
+			case 10:
+				((HMDCALLBACK10)function)(args[0], args[1], args[2], args[3], args[4], args[5], args[6], args[7], args[8], args[9]);
+				break;
+			default:
+				break;
+		}
+	}
+
+private:
+	struct Binding
+	{
+		HMDCALLBACK function;
+		int         numArgs;
+		void*       args[CALLBACK_MAX_ARGS];
+	};
+
+	TripleBuffer<Binding> m_Binding;
+	Binding m_Latched;
+};
@@ -0,0 +1,830 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// hmd.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "hmd.h"
+
+#include <cstring>
+
+HMD::HMD() : m_PoseBatch(MAX_SENSORS)
+{
+	m_NumEyes = 2;
+	m_NearPlaneZ = 0.01f;
+	m_FarPlaneZ  = 10000.0f;
+	m_FrameBufferWidth  = 1920;
+	m_FrameBufferHeight = 1080;
+
+	m_HeadPose = glm::mat4(1.0f);
+	m_HandPose = glm::mat4(1.0f);
+	m_HandOffsetAngle = 0.0f;
+	for (int i = 0; i < m_NumEyes; i++)
+	{
+		m_EyePose[i] = glm::mat4(1.0f);
+		m_ProjectionMatrix[i] = glm::mat4(1.0f);
+		m_RenderHeadPose[i] = glm::mat4(1.0f);
+	}
+
+	m_BodyTranslation = glm::vec3(0.0f, 0.0f, 0.0f);
+	m_BodyRotation = glm::vec3(0.0f, 0.0f, 0.0f);
+
+	for (int i = 0; i < 3; i++)
+	{
+		m_Tracking.head.vector[i] = glm::vec3(0.0f, 0.0f, 0.0f);
+		m_Tracking.head.vectorNav[i] = glm::vec3(0.0f, 0.0f, 0.0f);
+	}
+	m_Tracking.head.vector[VECTOR_FRONT] = glm::vec3(0.0f, 0.0f, -1.0f);
+	m_Tracking.head.vectorNav[VECTOR_FRONT] = glm::vec3(0.0f, 0.0f, -1.0f);
+	m_Tracking.head.translation = glm::vec3(0.0f, 0.0f, 0.0f);
+	m_Tracking.head.translationNav = glm::vec3(0.0f, 0.0f, 0.0f);
+	m_Tracking.hand = m_Tracking.head;
+	m_LatchedTracking.state = m_Tracking;
+	m_LatchedTracking.headPose = m_HeadPose;
+	m_LatchedTracking.handPose = m_HandPose;
+	m_LatchedTracking.handOffsetAngle = m_HandOffsetAngle;
+	m_TrackingState.Reset(m_LatchedTracking);
+	m_ApplicationTracking = m_Tracking;
+	m_TrackingTicks = -1;
+	m_RecordedNavigationVersion = -1;
+	memset(&m_InputSnapshot, 0, sizeof(m_InputSnapshot));
+	m_InputState.Reset(m_InputSnapshot);
+	m_LatchedInput = m_InputSnapshot;
+	m_InputTicks = -1;
+	m_WaitedFrames = -1;
+	const char* env;
+	m_IsPredictionEnabled.store((env = getenv("CLCL_PREDICTION")) != nullptr && atoi(env) != 0);
+	m_IsLateLatchEnabled.store((env = getenv("CLCL_LATE_LATCH")) != nullptr && atoi(env) != 0);
+	m_FixedRate.store((env = getenv("CLCL_APP_RATE")) != nullptr ? atoi(env) : 0);
+
+	for (int i = 0; i < m_NumEyes; i++)
+	{
+		m_FrameBuffer[i] = 0;
+		m_TextureBuffer[i] = 0;
+		m_DepthBuffer[i] = 0;
+	}
+
+	m_FrameIndex = 0;
+	m_CurrentEyeIndex = 0;
+	m_NavigationLockDepth = 0;
+	m_NavigationVersion = 0;
+	m_LatchedNavigation.matrix  = glm::mat4(1.0f);
+	m_LatchedNavigation.inverse = glm::mat4(1.0f);
+	m_LatchedNavigation.version = 0;
+	m_NavigationState.Reset(m_LatchedNavigation);
+	m_ModelMatrix = glm::mat4(1.0f);
+
+	m_IsThreadRunning.store(true);
+	m_IsInitializedGL.store(false);
+	m_IsInitFunctionExecuted = false;
+
+	m_DeviceType = HTC_VIVE;
+	m_IsControllerConnected = false;
+	m_DisplayFrequency = 90.0f;
+	m_MirrorMode.store(MIRROR_LEFT_EYE);
+	m_MirrorInterval.store(1);
+
+	m_IsHUDEnabled.store(false);
+	m_ApplicationTicks.store(0);
+	m_RateTicks = 0;
+	m_RateTime = 0.0;
+	m_ApplicationRate = 0.0;
+
+	m_StartTime = std::chrono::steady_clock::now();
+
+	m_FrameTimer.Init();
+}
+
+HMD::~HMD()
+{
+}
+
+void HMD::CreateBuffers()
+{
+	glGenFramebuffers(m_NumEyes, m_FrameBuffer);
+	glGenTextures(m_NumEyes, m_TextureBuffer);
+	glGenTextures(m_NumEyes, m_DepthBuffer);
+	for (int eyeIndex = 0; eyeIndex < m_NumEyes; eyeIndex++)
+	{
+		glBindTexture(GL_TEXTURE_2D, m_TextureBuffer[eyeIndex]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_FrameBufferWidth, m_FrameBufferHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+
+		glBindTexture(GL_TEXTURE_2D, m_DepthBuffer[eyeIndex]);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, m_FrameBufferWidth, m_FrameBufferHeight, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
+
+		glBindFramebuffer(GL_FRAMEBUFFER, m_FrameBuffer[eyeIndex]);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_TextureBuffer[eyeIndex], 0);
+		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_DepthBuffer[eyeIndex], 0);
+	}
+	glBindRenderbuffer(GL_RENDERBUFFER, 0);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
+	{
+		glDeleteFramebuffers(m_NumEyes, m_FrameBuffer);
+		glDeleteTextures(m_NumEyes, m_TextureBuffer);
+		glDeleteRenderbuffers(m_NumEyes, m_DepthBuffer);
+		exit(EXIT_FAILURE);
+	}
+}
+
+void HMD::DeleteBuffers()
+{
+	glDeleteFramebuffers(m_NumEyes, m_FrameBuffer);
+	glDeleteTextures(m_NumEyes, m_TextureBuffer);
+	glDeleteTextures(m_NumEyes, m_DepthBuffer);
+}
+
+void HMD::SetMatrix(int eyeIndex)
+{
+	m_CurrentEyeIndex = eyeIndex;
+
+	glBindFramebuffer(GL_FRAMEBUFFER, m_FrameBuffer[eyeIndex]);
+	glViewport(0, 0, m_FrameBufferWidth, m_FrameBufferHeight);
+
+	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+	DrawBackground(eyeIndex);
+
+	glEnable(GL_DEPTH_TEST);
+
+	glUseProgram(0);
+	glMatrixMode(GL_PROJECTION);
+	glLoadMatrixf(&(m_ProjectionMatrix[eyeIndex][0][0]));
+	// late latch: re-query the head pose predicted for this eye
+	m_RenderHeadPose[eyeIndex] = m_HeadPose;
+	if (m_IsLateLatchEnabled.load(std::memory_order_relaxed))
+	{
+		PredictPoses(SecondsToPhotons(), &m_RenderHeadPose[eyeIndex], nullptr);
+	}
+
+	glMatrixMode(GL_MODELVIEW);
+	glLoadMatrixf(&(glm::inverse(m_EyePose[eyeIndex] * m_RenderHeadPose[eyeIndex]))[0][0]);
+}
+
+double HMD::GetTime()
+{
+	std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - m_StartTime;
+	return elapsed.count();
+}
+
+void HMD::ComputeDeviceState(const glm::mat4& pose, float offset_angle, const glm::mat4& navInverse, DeviceState& state)
+{
+	glm::mat4 newMatrix = glm::transpose(glm::mat4(
+		pose[0][0], pose[1][0], pose[2][0], pose[3][0] / FEET_PER_METER,
+		pose[0][1], pose[1][1], pose[2][1], pose[3][1] / FEET_PER_METER,
+		pose[0][2], pose[1][2], pose[2][2], pose[3][2] / FEET_PER_METER,
+		pose[0][3], pose[1][3], pose[2][3], pose[3][3]));
+	if (offset_angle != 0.0f)
+	{
+		newMatrix = glm::rotate(newMatrix, offset_angle, glm::vec3(1.0f, 0.0f, 0.0f));
+	}
+	state.translation = glm::vec3(
+		pose[3][0] / FEET_PER_METER,
+		pose[3][1] / FEET_PER_METER,
+		pose[3][2] / FEET_PER_METER);
+	state.vector[VECTOR_RIGHT] = glm::normalize(glm::vec3( newMatrix[0][0],  newMatrix[0][1],  newMatrix[0][2]));
+	state.vector[VECTOR_UP]    = glm::normalize(glm::vec3( newMatrix[1][0],  newMatrix[1][1],  newMatrix[1][2]));
+	state.vector[VECTOR_FRONT] = glm::normalize(glm::vec3(-newMatrix[2][0], -newMatrix[2][1], -newMatrix[2][2]));
+
+	glm::mat4 navMatrix = navInverse * newMatrix;
+	state.translationNav = glm::vec3(navMatrix[3][0], navMatrix[3][1], navMatrix[3][2]);
+	state.vectorNav[VECTOR_RIGHT] = glm::normalize(glm::vec3( navMatrix[0][0],  navMatrix[0][1],  navMatrix[0][2]));
+	state.vectorNav[VECTOR_UP]    = glm::normalize(glm::vec3( navMatrix[1][0],  navMatrix[1][1],  navMatrix[1][2]));
+	state.vectorNav[VECTOR_FRONT] = glm::normalize(glm::vec3(-navMatrix[2][0], -navMatrix[2][1], -navMatrix[2][2]));
+}
+
+void HMD::UpdateHeadPose()
+{
+//	float angle_x, angle_y, angle_z;
+//	finalRollPitchYaw.ToEulerAngles<OVR::Axis_Y, OVR::Axis_X, OVR::Axis_Z, OVR::Rotate_CCW, OVR::Handed_R>(&angle_x, &angle_y, &angle_z);
+//	m_HeadOrientation = glm::vec3(angle_x, angle_y, angle_z);
+
+	UpdateSensorPose(SENSOR_HEAD, m_HeadPose, 0.0f);
+}
+
+void HMD::UpdateHandPose(float offset_angle)
+{
+	m_HandOffsetAngle = offset_angle;
+	UpdateSensorPose(SENSOR_WAND, m_HandPose, offset_angle);
+}
+
+void HMD::UpdateSensorPose(int sensor, const glm::mat4& pose, float offset_angle)
+{
+	m_PoseBatch.Set(sensor, pose, offset_angle);
+}
+
+void HMD::TransformPoses()
+{
+	m_PoseBatch.Transform(m_LatchedNavigation.inverse, 1.0f / FEET_PER_METER);
+	GetSensorState(SENSOR_HEAD, m_Tracking.head);
+	if (m_PoseBatch.size() > SENSOR_WAND)
+	{
+		GetSensorState(SENSOR_WAND, m_Tracking.hand);
+	}
+
+	TrackingSnapshot& snapshot = m_TrackingState.back();
+	snapshot.state = m_Tracking;
+	snapshot.headPose = m_HeadPose;
+	snapshot.handPose = m_HandPose;
+	snapshot.handOffsetAngle = m_HandOffsetAngle;
+	m_TrackingState.Publish();
+}
+
+bool HMD::GetSensorState(int sensor, DeviceState& state)
+{
+	if (sensor < 0 || sensor >= m_PoseBatch.size()) return false;
+
+	static const PoseBatch::AXIS axes[3] = { PoseBatch::AXIS_UP, PoseBatch::AXIS_FRONT, PoseBatch::AXIS_RIGHT }; // VECTOR_TYPE order
+	state.translation = m_PoseBatch.translation(sensor);
+	state.translationNav = m_PoseBatch.translationNav(sensor);
+	for (int type = 0; type < 3; type++)
+	{
+		state.vector[type] = m_PoseBatch.vector(sensor, axes[type]);
+		state.vectorNav[type] = m_PoseBatch.vectorNav(sensor, axes[type]);
+	}
+	return true;
+}
+
+void HMD::RecordPose(int sensor, double time, const glm::mat4& pose)
+{
+	if (sensor < 0 || sensor >= MAX_SENSORS) return;
+	m_PoseHistory[sensor].Push(time, pose);
+	m_Recorder.RecordPose(sensor, time, pose);
+}
+
+bool HMD::GetPoseAt(int sensor, double time, glm::mat4& pose)
+{
+	if (sensor < 0 || sensor >= MAX_SENSORS) return false;
+	return m_PoseHistory[sensor].Sample(time, pose);
+}
+
+bool HMD::GetTrackingStateAt(double time, TrackingState& state)
+{
+	glm::mat4 headPose, handPose;
+	if (!m_PoseHistory[SENSOR_HEAD].Sample(time, headPose)) return false;
+	if (!m_PoseHistory[SENSOR_WAND].Sample(time, handPose))
+	{
+		handPose = headPose;
+	}
+
+	glm::mat4 navInverse;
+	float handOffsetAngle;
+	if (IsDisplayThread())
+	{
+		navInverse = m_LatchedNavigation.inverse;
+		handOffsetAngle = m_HandOffsetAngle;
+	}
+	else
+	{
+		trackingState(); // latches the published snapshot for this step
+		navInverse = GetNavigationInverseMatrix();
+		handOffsetAngle = m_LatchedTracking.handOffsetAngle;
+	}
+	ComputeDeviceState(headPose, 0.0f, navInverse, state.head);
+	ComputeDeviceState(handPose, handOffsetAngle, navInverse, state.hand);
+	return true;
+}
+
+const TrackingState& HMD::trackingState()
+{
+	if (IsDisplayThread())
+	{
+		return m_Tracking;
+	}
+
+	// latched (and predicted) once per application step
+	llong ticks = m_ApplicationTicks.load(std::memory_order_relaxed);
+	if (ticks != m_TrackingTicks)
+	{
+		if (m_TrackingState.Acquire())
+		{
+			m_LatchedTracking = m_TrackingState.front();
+		}
+		m_ApplicationTracking = m_LatchedTracking.state;
+		if (m_IsPredictionEnabled.load(std::memory_order_relaxed))
+		{
+			glm::mat4 headPose, handPose = m_LatchedTracking.handPose;
+			if (PredictPoses(SecondsToPhotons(), &headPose, &handPose))
+			{
+				glm::mat4 navInverse = GetNavigationInverseMatrix();
+				ComputeDeviceState(headPose, 0.0f, navInverse, m_ApplicationTracking.head);
+				ComputeDeviceState(handPose, m_LatchedTracking.handOffsetAngle, navInverse, m_ApplicationTracking.hand);
+			}
+		}
+		m_TrackingTicks = ticks;
+	}
+	return m_ApplicationTracking;
+}
+
+void HMD::Translate(float x, float y, float z)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_NavigationMutex);
+	m_Navigation.PreTranslate(glm::vec3(-x, -y, -z));
+	PublishNavigation();
+}
+
+static glm::quat AxisRotation(float angle_degree, char axis)
+{
+	float angle_radian = -angle_degree * (float)M_PI / 180.0f;
+	switch (tolower(axis))
+	{
+		case 'x':
+			return glm::angleAxis(angle_radian, glm::vec3(1.0f, 0.0f, 0.0f));
+		case 'y':
+			return glm::angleAxis(angle_radian, glm::vec3(0.0f, 1.0f, 0.0f));
+		case 'z':
+			return glm::angleAxis(angle_radian, glm::vec3(0.0f, 0.0f, 1.0f));
+		default:
+			return glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	}
+}
+
+void HMD::Rotate(float angle_degree, char axis)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_NavigationMutex);
+	m_Navigation.PreRotate(AxisRotation(angle_degree, axis));
+	PublishNavigation();
+}
+
+void HMD::Scale(float x, float y, float z)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_NavigationMutex);
+	m_Navigation.PreScale(glm::vec3(1.0f / x, 1.0f / y, 1.0f / z));
+	PublishNavigation();
+}
+
+void HMD::WorldTranslate(float x, float y, float z)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_NavigationMutex);
+	m_Navigation.PostTranslate(glm::vec3(-x, -y, -z));
+	PublishNavigation();
+}
+
+void HMD::WorldRotate(float angle_degree, char axis)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_NavigationMutex);
+	m_Navigation.PostRotate(AxisRotation(angle_degree, axis));
+	PublishNavigation();
+}
+
+void HMD::WorldScale(float x, float y, float z)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_NavigationMutex);
+	m_Navigation.PostScale(glm::vec3(1.0f / x, 1.0f / y, 1.0f / z));
+	PublishNavigation();
+}
+
+glm::mat4 HMD::GetNavigationMatrix()
+{
+	std::lock_guard<std::recursive_mutex> lock(m_NavigationMutex);
+	return m_Navigation.matrix();
+}
+
+glm::mat4 HMD::GetNavigationInverseMatrix()
+{
+	std::lock_guard<std::recursive_mutex> lock(m_NavigationMutex);
+	return m_Navigation.inverse();
+}
+
+glm::mat4 HMD::CurrentNavigationMatrix(bool isInverse)
+{
+	if (IsDisplayThread())
+	{
+		return isInverse ? m_LatchedNavigation.inverse : m_LatchedNavigation.matrix;
+	}
+	return isInverse ? GetNavigationInverseMatrix() : GetNavigationMatrix();
+}
+
+void HMD::LoadNavigationMatrix(glm::mat4 matrix)
+{
+	std::lock_guard<std::recursive_mutex> lock(m_NavigationMutex);
+	m_Navigation.Load(matrix);
+	PublishNavigation();
+}
+
+void HMD::SetNavigationMatrix()
+{
+	glMatrixMode(GL_MODELVIEW);
+	glMultMatrixf(&m_LatchedNavigation.matrix[0][0]);
+}
+
+void HMD::SetNavigationInverseMatrix()
+{
+	glMatrixMode(GL_MODELVIEW);
+	glMultMatrixf(&m_LatchedNavigation.inverse[0][0]);
+}
+
+void HMD::SetNavigationMatrixIdentity()
+{
+	std::lock_guard<std::recursive_mutex> lock(m_NavigationMutex);
+	m_Navigation.LoadIdentity();
+	PublishNavigation();
+}
+
+void HMD::MultiNavigationMatrix(float matrix[4][4])
+{
+	std::lock_guard<std::recursive_mutex> lock(m_NavigationMutex);
+	glm::mat4 InMatrix = glm::mat4(
+		matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0],
+		matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1],
+		matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2],
+		matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3]);
+	m_Navigation.PreMultiply(InMatrix);
+	PublishNavigation();
+}
+
+void HMD::PreMultiNavigationMatrix(float matrix[4][4])
+{
+	std::lock_guard<std::recursive_mutex> lock(m_NavigationMutex);
+	glm::mat4 InMatrix = glm::mat4(
+		matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0],
+		matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1],
+		matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2],
+		matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3]);
+	m_Navigation.PostMultiply(InMatrix);
+	PublishNavigation();
+}
+
+void HMD::StoreNavigationMatrix()
+{
+	std::lock_guard<std::recursive_mutex> lock(m_NavigationMutex);
+	m_NavigationBackup = m_Navigation;
+}
+
+void HMD::RestoreNavigationMatrix()
+{
+	std::lock_guard<std::recursive_mutex> lock(m_NavigationMutex);
+	m_Navigation = m_NavigationBackup;
+	PublishNavigation();
+}
+
+// edits between NavigationLock() and NavigationUnlock() are published together
+void HMD::NavigationLock()
+{
+	m_NavigationMutex.lock();
+	m_NavigationLockOwner = std::this_thread::get_id();
+	m_NavigationLockDepth++;
+}
+
+// ignored unless the calling thread holds the lock of NavigationLock()
+void HMD::NavigationUnlock()
+{
+	if (!m_NavigationMutex.try_lock()) return; // held by another thread
+
+	if (m_NavigationLockDepth > 0 && m_NavigationLockOwner == std::this_thread::get_id())
+	{
+		if (--m_NavigationLockDepth == 0)
+		{
+			m_NavigationLockOwner = std::thread::id();
+		}
+		PublishNavigation();
+		m_NavigationMutex.unlock(); // the lock of NavigationLock()
+	}
+	m_NavigationMutex.unlock();
+}
+
+// called with m_NavigationMutex held
+void HMD::PublishNavigation()
+{
+	if (m_NavigationLockDepth > 0) return;
+
+	NavigationState& state = m_NavigationState.back();
+	state.matrix  = m_Navigation.matrix();
+	state.inverse = m_Navigation.inverse();
+	state.version = ++m_NavigationVersion;
+	m_NavigationState.Publish();
+}
+
+void HMD::LatchNavigation()
+{
+	if (m_NavigationState.Acquire())
+	{
+		m_LatchedNavigation = m_NavigationState.front();
+	}
+}
+
+void HMD::PublishInput(InputSnapshot& snapshot)
+{
+	uint32_t previous = m_InputSnapshot.buttons;
+	snapshot.pressed = snapshot.buttons & ~previous;
+	snapshot.released = previous & ~snapshot.buttons;
+	uint32_t changed = snapshot.pressed | snapshot.released;
+	for (int i = 0; i < MAX_CONTROLLER_BUTTONS; i++)
+	{
+		snapshot.changes[i] = m_InputSnapshot.changes[i];
+		if (changed & (1u << i))
+		{
+			snapshot.changes[i]++;
+			int action = (snapshot.buttons & (1u << i)) ? BUTTON_PRESS : BUTTON_RELEASE;
+			PushInput(INPUT_CONTROLLER_BUTTON, i + 1, action, snapshot.time);
+		}
+	}
+	m_Recorder.RecordInput(snapshot);
+	m_InputSnapshot = snapshot;
+	m_InputState.Publish(snapshot);
+}
+
+void HMD::PushInput(INPUT_DEVICE device, int code, int action, double time)
+{
+	if (m_Input.Push(device, code, action, time, m_FrameIndex) && m_Recorder.IsOpen())
+	{
+		InputEvent event;
+		event.time = time;
+		event.frameIndex = m_FrameIndex;
+		event.device = device;
+		event.code = code;
+		event.action = action;
+		m_Recorder.RecordEvent(event);
+	}
+}
+
+const InputSnapshot& HMD::inputSnapshot()
+{
+	if (IsDisplayThread())
+	{
+		return m_InputSnapshot;
+	}
+
+	// latched once per application step (CAVEUSleep, CAVEWaitForFrame), so
+	// all the queries of a step agree. The edges are those of the step: a
+	// press released again within the step is in both "pressed" and
+	// "released", even if the frames in between were not latched.
+	llong ticks = m_ApplicationTicks.load(std::memory_order_relaxed);
+	if (ticks != m_InputTicks)
+	{
+		InputSnapshot previous = m_LatchedInput;
+		if (m_InputState.Acquire())
+		{
+			m_LatchedInput = m_InputState.front();
+		}
+		m_LatchedInput.pressed = 0;
+		m_LatchedInput.released = 0;
+		for (int i = 0; i < MAX_CONTROLLER_BUTTONS; i++)
+		{
+			uint32_t changes = m_LatchedInput.changes[i] - previous.changes[i];
+			bool isDown = (m_LatchedInput.buttons & (1u << i)) != 0;
+			if (changes >= 2 || (changes == 1 && isDown))
+			{
+				m_LatchedInput.pressed |= 1u << i;
+			}
+			if (changes >= 2 || (changes == 1 && !isDown))
+			{
+				m_LatchedInput.released |= 1u << i;
+			}
+		}
+		m_InputTicks = ticks;
+	}
+	return m_LatchedInput;
+}
+
+int HMD::GetButtonState(int buttonNumber)
+{
+	if (buttonNumber < 1 || buttonNumber > MAX_CONTROLLER_BUTTONS) return -1;
+	const InputSnapshot& snapshot = inputSnapshot();
+	uint32_t bit = 1u << (buttonNumber - 1);
+	if (!(snapshot.mapped & bit)) return -1;
+	return (snapshot.buttons & bit) ? BUTTON_PRESS : BUTTON_RELEASE;
+}
+
+// down, or pressed and released again since the previous step
+bool HMD::IsControllerButtonPressed(int buttonNumber)
+{
+	if (buttonNumber < 1 || buttonNumber > MAX_CONTROLLER_BUTTONS) return false;
+	const InputSnapshot& snapshot = inputSnapshot();
+	return ((snapshot.buttons | snapshot.pressed) & (1u << (buttonNumber - 1))) != 0;
+}
+
+std::pair<float, float> HMD::GetJoyStickValue()
+{
+	const InputSnapshot& snapshot = inputSnapshot();
+	return std::pair<float, float>(snapshot.joystick[0], snapshot.joystick[1]);
+}
+
+llong HMD::WaitForFrame()
+{
+	int rate = m_FixedRate.load();
+	if (rate != 0)
+	{
+		double hz = rate > 0 ? rate : m_DisplayFrequency;
+		if (hz != m_FixedRateTimer.rate())
+		{
+			m_FixedRateTimer.SetRate(hz > 0.0 ? hz : 90.0);
+		}
+		return m_FixedRateTimer.Wait();
+	}
+
+	// the first call waits for the next frame, not for the ones before
+	if (m_WaitedFrames < 0)
+	{
+		m_WaitedFrames = m_FrameSignal.count();
+	}
+	return m_FrameSignal.Wait(m_WaitedFrames, 0.1); // the display thread may be stalled
+}
+
+void HMD::StartThread()
+{
+	m_MainThreadID = std::this_thread::get_id();
+
+	m_DisplayThread = std::thread(&HMD::MainThreadEX, this);
+
+	while (!m_IsInitializedGL.load()) // waiting the initialization of GL
+	{
+		std::this_thread::yield();
+	}
+}
+
+void HMD::StopThread()
+{
+	m_IsThreadRunning.store(false);
+	if (m_DisplayThread.joinable())
+	{
+		m_DisplayThread.join();
+	}
+}
+
+void HMD::MainThreadEX()
+{
+	m_DisplayThreadID = std::this_thread::get_id();
+
+	Init();
+	InitGL();
+	CreateBuffers();
+	m_FrameTimer.InitGL();
+	StartRecording();
+
+	m_IsInitializedGL.store(true);
+
+	while (m_IsThreadRunning.load())
+	{
+		m_FrameTimer.SetMeasuring(m_IsHUDEnabled.load());
+		m_FrameTimer.BeginFrame(m_FrameIndex);
+		m_Bench.BeginFrame(m_ApplicationTicks.load(std::memory_order_relaxed));
+		LatchCallbacks(m_SharedSnapshot.Latch());
+		LatchNavigation();
+		ExecInitCallback();
+		UpdateHUD();
+		m_FrameTimer.Begin(STAGE_TRACKING);
+		UpdateTrackingData();
+		TransformPoses();
+		PollEvents();
+		RecordFrame();
+		m_FrameSignal.Notify();
+		m_FrameTimer.End(STAGE_TRACKING);
+		m_FrameTimer.Begin(STAGE_IDLE);
+		ExecIdleCallback();
+		m_FrameTimer.End(STAGE_IDLE);
+		m_FrameTimer.Begin(STAGE_PREPROCESS);
+		PreProcess();
+		m_FrameTimer.End(STAGE_PREPROCESS);
+		for (int eyeIndex = 0; eyeIndex < m_NumEyes; eyeIndex++)
+		{
+			m_FrameTimer.BeginGPU(eyeIndex);
+			m_FrameTimer.Begin(STAGE_SETMATRIX, eyeIndex);
+			SetMatrix(eyeIndex);
+			m_FrameTimer.End(STAGE_SETMATRIX, eyeIndex);
+			m_FrameTimer.Begin(STAGE_DRAW, eyeIndex);
+			glPushMatrix();
+			glScalef(FEET_PER_METER, FEET_PER_METER, FEET_PER_METER);
+			for (int i = 0; i < m_Bench.drawScale(); i++)
+			{
+				ExecDrawCallback();
+			}
+			glPopMatrix();
+			m_FrameTimer.End(STAGE_DRAW, eyeIndex);
+
+			m_FrameTimer.Begin(STAGE_DEVICES, eyeIndex);
+			DrawDevices(eyeIndex);
+			if (m_IsHUDEnabled.load())
+			{
+				m_HUD.Draw(m_ProjectionMatrix[eyeIndex], glm::inverse(m_EyePose[eyeIndex]));
+			}
+			m_FrameTimer.End(STAGE_DEVICES, eyeIndex);
+			m_FrameTimer.EndGPU(eyeIndex);
+
+			m_FrameTimer.Begin(STAGE_SUBMIT, eyeIndex);
+			SubmitFrame(eyeIndex);
+			m_FrameTimer.End(STAGE_SUBMIT, eyeIndex);
+		}
+		m_FrameTimer.Begin(STAGE_POSTPROCESS);
+		PostProcess();
+		m_FrameTimer.End(STAGE_POSTPROCESS);
+		m_FrameTimer.EndFrame();
+
+		if (m_FrameTimer.IsEnabled())
+		{
+			m_FrameTimer.CheckDumpKey(GetKey(TIMING_DUMP_KEY));
+		}
+	}
+
+	m_FrameSignal.Stop();
+	m_Recorder.Close();
+	LatchCallbacks(m_SharedSnapshot.Latch());
+	ExecStopCallback();
+	m_FrameTimer.TerminateGL();
+	if (m_HUD.IsInitializedGL())
+	{
+		m_HUD.TerminateGL();
+	}
+	m_FrameTimer.Dump();
+	m_Bench.Write(name(), m_FrameBufferWidth, m_FrameBufferHeight);
+	Terminate();
+}
+
+void HMD::StartRecording()
+{
+	const char* env = getenv("CLCL_RECORD");
+	if (env == nullptr || env[0] == '\0') return;
+
+	SessionFileHeader header;
+	memset(&header, 0, sizeof(header));
+	memcpy(header.magic, SESSION_MAGIC, sizeof(header.magic));
+	header.version = SESSION_VERSION;
+	header.deviceType = m_DeviceType;
+	header.displayFrequency = m_DisplayFrequency;
+	header.renderWidth = m_FrameBufferWidth;
+	header.renderHeight = m_FrameBufferHeight;
+	m_Recorder.Open(env, header);
+	m_RecordedNavigationVersion = -1;
+}
+
+// closes the records of this frame
+void HMD::RecordFrame()
+{
+	if (!m_Recorder.IsOpen()) return;
+
+	if (m_LatchedNavigation.version != m_RecordedNavigationVersion)
+	{
+		m_Recorder.RecordNavigation(m_LatchedNavigation.version, m_LatchedNavigation.matrix);
+		m_RecordedNavigationVersion = m_LatchedNavigation.version;
+	}
+	m_Recorder.EndFrame(m_FrameIndex, GetTime());
+}
+
+void HMD::UpdateHUD()
+{
+	if (!m_IsHUDEnabled.load()) return;
+
+	if (!m_HUD.IsInitializedGL())
+	{
+		m_HUD.InitGL();
+	}
+
+	// the application rate is averaged over half a second
+	double now = GetTime();
+	if (now - m_RateTime >= 0.5)
+	{
+		llong ticks = m_ApplicationTicks.load(std::memory_order_relaxed);
+		m_ApplicationRate = (ticks - m_RateTicks) / (now - m_RateTime);
+		m_RateTicks = ticks;
+		m_RateTime = now;
+	}
+
+	HUDStats stats;
+	stats.applicationRate = m_ApplicationRate;
+	stats.frameTime = m_FrameTimer.lastFrameInterval();
+	stats.gpuTime[0] = m_FrameTimer.lastGPUTime(0);
+	stats.gpuTime[1] = m_FrameTimer.lastGPUTime(1);
+	stats.deadline = m_DisplayFrequency > 0.0f ? 1.0 / m_DisplayFrequency : 0.0;
+	m_HUD.Update(stats);
+}
+
+bool HMD::IsMainThread()
+{
+	if (std::this_thread::get_id() == m_MainThreadID)
+	{
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+}
+
+bool HMD::IsDisplayThread()
+{
+	if (std::this_thread::get_id() == m_DisplayThreadID)
+	{
+		return true;
+	}
+	else
+	{
+		return false;
+	}
+}
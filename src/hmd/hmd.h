@@ -0,0 +1,437 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// hmd.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "../settings.h"
+#include "../sync/snapshot.h"
+#include "../sync/triple_buffer.h"
+#include "../sync/frame_signal.h"
+
+const float FEET_PER_METER = 3.280840f;
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX // to use "std::max()"
+#include <windows.h>
+#endif // _WIN32
+
+#define _USE_MATH_DEFINES
+#include <vector>
+#include <cmath>
+#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <chrono>
+#include <mutex>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#define GLM_ENABLE_EXPERIMENTAL
+#include <glm/vec3.hpp> // glm::vec3
+#include <glm/vec4.hpp> // glm::vec4
+#include <glm/mat4x4.hpp> // glm::mat4
+#include <glm/gtx/transform.hpp> // glm::scale
+#include <glm/gtc/matrix_transform.hpp> // glm::translate, glm::rotate, glm::scale, glm::perspective
+#include <glm/gtc/type_ptr.hpp> // glm::value_ptr
+
+#include "callback.h"
+#include "pose_history.h"
+#include "pose_batch.h"
+#include "input_queue.h"
+#include "nav_transform.h"
+#include "../timing/frame_timer.h"
+#include "../timing/hud.h"
+#include "../timing/bench_report.h"
+#include "../timing/rate_timer.h"
+#include "../record/session_recorder.h"
+
+// button states reported by the backends (same values as GLFW)
+const int BUTTON_RELEASE = 0; // GLFW_RELEASE
+const int BUTTON_PRESS   = 1; // GLFW_PRESS
+
+typedef enum {
+	VECTOR_UP = 0,
+	VECTOR_FRONT,
+	VECTOR_RIGHT
+} VECTOR_TYPE;
+
+// navigation matrix published to the display thread
+struct NavigationState
+{
+	glm::mat4 matrix;
+	glm::mat4 inverse;
+	llong     version;
+};
+
+// CAVE coordinates of a tracked device, derived from its pose
+struct DeviceState
+{
+	glm::vec3 translation;
+	glm::vec3 vector[3];
+	glm::vec3 translationNav;
+	glm::vec3 vectorNav[3];
+};
+
+struct TrackingState
+{
+	DeviceState head;
+	DeviceState hand;
+};
+
+// tracking of one frame, published to the other threads
+struct TrackingSnapshot
+{
+	TrackingState state;
+	glm::mat4     headPose; // tracking space
+	glm::mat4     handPose;
+	float         handOffsetAngle;
+};
+
+// pose history slots, by CAVE sensor number
+typedef enum {
+	SENSOR_HEAD = 0,
+	SENSOR_WAND,
+	MAX_SENSORS = 16
+} SENSOR_INDEX;
+
+// desktop mirror window
+typedef enum {
+	MIRROR_OFF = 0,
+	MIRROR_LEFT_EYE,
+	MIRROR_BOTH_EYES,
+	NUM_MIRROR_MODES
+} MIRROR_MODE;
+
+typedef enum {
+	HTC_VIVE = 0,
+	OCULUS_RIFT_CV1,
+	WINDOWS_MR
+} DEVICE_TYPE;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// HMD: the interface between the CAVE* functions and an HMD backend.
+//
+//   The display thread, the navigation matrix, the callbacks and the derived
+//   head/wand vectors are common to all backends. A backend implements the
+//   device specific parts: tracking update, per-eye matrices, frame submission
+//   and input.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class HMD {
+public:
+	HMD();
+	virtual ~HMD();
+
+	// backend
+	virtual const char* name() const = 0;
+	virtual void Init() = 0;
+	virtual void InitGL() = 0;
+	virtual void CreateBuffers();
+	virtual void Terminate() = 0;
+	virtual void UpdateTrackingData() = 0;
+	virtual void PreProcess() {}
+	virtual void PostProcess() = 0;
+	virtual void SubmitFrame(int eyeIndex) = 0;
+	virtual void SetMatrix(int eyeIndex);
+	virtual double GetTime();
+
+	// poses predicted to the given time from now (tracking space); handPose is
+	// only written if the controller is tracked. Returns false if not supported.
+	virtual bool PredictPoses(float secondsFromNow, glm::mat4* headPose, glm::mat4* handPose) { return false; }
+	// time from now until the next frame reaches the user's eyes
+	virtual float SecondsToPhotons() { return 1.0f / m_DisplayFrequency; }
+
+	// input, polled on the display thread; other threads use input().
+	// PollEvents() pushes the window events of the frame before it is recorded.
+	virtual void PollEvents() {}
+	virtual bool GetKey(int key) { return false; }
+	virtual int  GetMouseButton(int button) { return BUTTON_RELEASE; }
+
+	// controller, from inputSnapshot(); buttons are numbered from 1.
+	// GetButtonState() is -1 for a button the controller does not have.
+	int  GetButtonState(int buttonNumber);
+	bool IsControllerButtonPressed(int buttonNumber);
+	std::pair<float, float> GetJoyStickValue();
+
+	// navigation
+	void Translate(float x, float y, float z);
+	void Rotate(float angle_degree, char axis);
+	void Scale(float x, float y, float z);
+	void WorldTranslate(float x, float y, float z);
+	void WorldRotate(float angle, char axis);
+	void WorldScale(float x, float y, float z);
+	glm::mat4 GetNavigationMatrix();
+	glm::mat4 GetNavigationInverseMatrix();
+	// the latched matrix on the display thread, the working one elsewhere
+	glm::mat4 CurrentNavigationMatrix(bool isInverse);
+	void LoadNavigationMatrix(glm::mat4 matrix);
+	void SetNavigationMatrixIdentity();
+	void SetNavigationMatrix();
+	void SetNavigationInverseMatrix();
+	void MultiNavigationMatrix(float matrix[4][4]);
+	void PreMultiNavigationMatrix(float matrix[4][4]);
+	void StoreNavigationMatrix();
+	void RestoreNavigationMatrix();
+	void NavigationLock();
+	void NavigationUnlock();
+	llong navigationVersion() { return m_LatchedNavigation.version; }
+
+	glm::mat4 projectionMatrix(int eyeIndex) { return m_ProjectionMatrix[eyeIndex]; }
+	glm::vec3 bodyTranslation() { return m_BodyTranslation; }
+	// the display thread gets the state of the current frame; other threads
+	// get the one latched once per application step (as inputSnapshot()),
+	// predicted to the next display time if prediction is enabled
+	const TrackingState& trackingState();
+	glm::vec3 headTranslation() { return trackingState().head.translation; }
+	glm::vec3 headOrientation() { return m_HeadOrientation; }
+	glm::vec3 headVector(VECTOR_TYPE type) { return trackingState().head.vector[type]; }
+	glm::vec3 headVectorNav(VECTOR_TYPE type) { return trackingState().head.vectorNav[type]; }
+	glm::vec3 headTranslationNav() { return trackingState().head.translationNav; }
+	glm::vec3 headOrientationNav() { return m_HeadOrientationNav; }
+
+	glm::vec3 handTranslation() { return trackingState().hand.translation; }
+	glm::vec3 handTranslationNav() { return trackingState().hand.translationNav; }
+	glm::vec3 handVector(VECTOR_TYPE type) { return trackingState().hand.vector[type]; }
+	glm::vec3 handVectorNav(VECTOR_TYPE type) { return trackingState().hand.vectorNav[type]; }
+
+	// poses of the tracked devices at a time of GetTime(), interpolated from
+	// the pose history; safe to call from any thread
+	bool GetPoseAt(int sensor, double time, glm::mat4& pose);
+	bool GetTrackingStateAt(double time, TrackingState& state);
+	// display thread: CAVE coordinates of any tracked device in this frame
+	bool GetSensorState(int sensor, DeviceState& state);
+
+	// CAVE_PREDICT_POSES / CAVE_LATE_LATCH
+	void SetPredictionEnabled(bool enabled) { m_IsPredictionEnabled.store(enabled); }
+	void SetLateLatchEnabled(bool enabled) { m_IsLateLatchEnabled.store(enabled); }
+
+	int renderTargetWidth() { return m_FrameBufferWidth; }
+	int renderTargetHeight() { return m_FrameBufferHeight; }
+	llong frameIndex() { return m_FrameIndex; }
+
+	bool IsControllerConnected() { return m_IsControllerConnected; }
+	DEVICE_TYPE GetDeviceType() { return m_DeviceType; }
+
+	SharedSnapshot& sharedSnapshot() { return m_SharedSnapshot; }
+	InputQueue& input() { return m_Input; }
+	// the display thread gets the snapshot of the current frame; other
+	// threads get the one latched once per application step (CAVEUSleep,
+	// CAVEWaitForFrame), with the edges since the previous step. A thread
+	// that never ends a step keeps the snapshot of its first query.
+	const InputSnapshot& inputSnapshot();
+	FrameTimer& frameTimer() { return m_FrameTimer; }
+
+	// mirror window: shown every "interval" frames
+	void SetMirrorMode(int mode) { if (mode >= 0 && mode < NUM_MIRROR_MODES) m_MirrorMode.store(mode); }
+	void SetMirrorInterval(int interval) { m_MirrorInterval.store(interval > 0 ? interval : 1); }
+	MIRROR_MODE mirrorMode() { return static_cast<MIRROR_MODE>(m_MirrorMode.load()); }
+
+	// CAVE_SIM_DRAWTIMING
+	void SetHUDEnabled(bool enabled) { m_IsHUDEnabled.store(enabled); }
+	void TickApplication() { m_ApplicationTicks.fetch_add(1, std::memory_order_relaxed); }
+
+	// CAVEWaitForFrame(): waits until the display thread has published the
+	// poses of a new frame, or for the next tick of the fixed rate; returns
+	// the number of frames (ticks) since the previous call, 0 on timeout
+	llong WaitForFrame();
+	// CAVE_APP_RATE: 0 follows the display frames, > 0 a fixed rate in Hz,
+	// < 0 a fixed rate at the display frequency
+	void SetApplicationRate(int rate) { m_FixedRate.store(rate); }
+
+	void StartThread();
+	void StopThread();
+	bool IsMainThread();
+	bool IsDisplayThread();
+
+	void SetInitFunction(HMDCALLBACK callback, std::vector<void*> arg_list) { m_InitCallback.Bind(callback, arg_list); }
+	void SetStopFunction(HMDCALLBACK callback, std::vector<void*> arg_list) { m_StopCallback.Bind(callback, arg_list); }
+	void SetDrawFunction(HMDCALLBACK callback, std::vector<void*> arg_list) { m_DrawCallback.Bind(callback, arg_list); }
+	void SetIdleFunction(HMDCALLBACK callback, std::vector<void*> arg_list) { m_IdleCallback.Bind(callback, arg_list); }
+
+protected:
+	int m_NumEyes;
+
+	float m_NearPlaneZ;
+	float m_FarPlaneZ;
+	uint32_t m_FrameBufferWidth;
+	uint32_t m_FrameBufferHeight;
+	glm::mat4 m_HeadPose;
+	glm::mat4 m_EyePose[2];
+	glm::mat4 m_ProjectionMatrix[2];
+	GLuint   m_FrameBuffer[2];
+	GLuint   m_TextureBuffer[2];
+	GLuint   m_DepthBuffer[2];
+	llong    m_FrameIndex;
+
+	TrackingState m_Tracking;
+	glm::vec3 m_HeadOrientation;
+	glm::vec3 m_HeadOrientationNav;
+	glm::vec3 m_BodyTranslation;
+	glm::vec3 m_BodyRotation;
+
+	glm::mat4 m_HandPose;
+	float     m_HandOffsetAngle; // display thread; published in TrackingSnapshot
+
+	PoseHistory m_PoseHistory[MAX_SENSORS];
+	void RecordPose(int sensor, double time, const glm::mat4& pose);
+
+	// poses set during UpdateTrackingData() are converted together afterwards
+	PoseBatch m_PoseBatch;
+	void UpdateSensorPose(int sensor, const glm::mat4& pose, float offset_angle);
+	// converts the batch and publishes the tracking of the frame
+	void TransformPoses();
+
+	// head pose each eye was rendered with (late-latched or m_HeadPose)
+	glm::mat4 m_RenderHeadPose[2];
+	std::atomic<bool> m_IsLateLatchEnabled;
+
+	int m_CurrentEyeIndex;
+
+	// The navigation matrix is edited by the application (m_Navigation)
+	// and published as a whole. The display thread latches the newest state
+	// once per frame, so both eyes and the *_NAV vectors use the same matrix.
+	NavigationTransform m_Navigation;
+	NavigationTransform m_NavigationBackup;
+	std::recursive_mutex m_NavigationMutex;
+	int       m_NavigationLockDepth; // with m_NavigationMutex held
+	std::thread::id m_NavigationLockOwner;
+	llong     m_NavigationVersion;
+	TripleBuffer<NavigationState> m_NavigationState;
+	NavigationState m_LatchedNavigation;
+	glm::mat4 m_ModelMatrix;
+
+	bool m_IsControllerConnected;
+	DEVICE_TYPE m_DeviceType;
+	float m_DisplayFrequency; // Hz, for the compositor deadline
+
+	std::atomic<int> m_MirrorMode;
+	std::atomic<int> m_MirrorInterval;
+	bool IsMirrorFrame()
+	{
+		return m_MirrorMode.load() != MIRROR_OFF && m_FrameIndex % m_MirrorInterval.load() == 0;
+	}
+
+	std::atomic<bool> m_IsThreadRunning; // flag to stop the thread
+	std::atomic<bool> m_IsInitializedGL;
+
+	// compute the CAVE coordinates from m_HeadPose / m_HandPose (tracking space)
+	void UpdateHeadPose();
+	void UpdateHandPose(float offset_angle);
+	static void ComputeDeviceState(const glm::mat4& pose, float offset_angle, const glm::mat4& navInverse, DeviceState& state);
+
+	void PublishNavigation();
+	void LatchNavigation();
+
+	// called by the backend once per tracking update; fills in the edges
+	// and queues the button changes to input()
+	void PublishInput(InputSnapshot& snapshot);
+	// a key, mouse or controller button change seen on the display thread
+	void PushInput(INPUT_DEVICE device, int code, int action, double time);
+
+	void DeleteBuffers();
+
+	// hooks for the backend around the application's draw callback
+	virtual void DrawBackground(int eyeIndex) {}
+	virtual void DrawDevices(int eyeIndex) {}
+
+private:
+	std::thread m_DisplayThread;
+	std::thread::id m_MainThreadID;
+	std::thread::id m_DisplayThreadID;
+	std::chrono::steady_clock::time_point m_StartTime;
+
+	SharedSnapshot      m_SharedSnapshot;
+	InputQueue          m_Input;
+	InputSnapshot       m_InputSnapshot; // display thread
+	TripleBuffer<InputSnapshot> m_InputState;
+	InputSnapshot       m_LatchedInput;  // application thread
+	llong               m_InputTicks;
+	FrameTimer          m_FrameTimer;
+	BenchReport         m_Bench;
+	PerformanceHUD      m_HUD;
+	std::atomic<bool>   m_IsHUDEnabled;
+	std::atomic<llong>  m_ApplicationTicks;
+	FrameSignal         m_FrameSignal;
+	llong               m_WaitedFrames;  // application thread
+	std::atomic<int>    m_FixedRate;
+	RateTimer           m_FixedRateTimer; // application thread
+	llong               m_RateTicks;
+	double              m_RateTime;
+	double              m_ApplicationRate;
+
+	void UpdateHUD();
+
+	// CLCL_RECORD: tracking, input and navigation of every frame
+	SessionRecorder     m_Recorder;
+	llong               m_RecordedNavigationVersion;
+	void StartRecording();
+	void RecordFrame();
+
+	std::atomic<bool>   m_IsPredictionEnabled;
+	TripleBuffer<TrackingSnapshot> m_TrackingState;
+	TrackingSnapshot    m_LatchedTracking;      // application thread
+	TrackingState       m_ApplicationTracking;  // the latched one, or predicted
+	llong               m_TrackingTicks;
+
+	bool                m_IsInitFunctionExecuted;
+	HMDCallback         m_InitCallback;
+	HMDCallback         m_StopCallback;
+	HMDCallback         m_DrawCallback;
+	HMDCallback         m_IdleCallback;
+
+	void LatchCallbacks(bool isSnapshotChanged)
+	{
+		m_InitCallback.Latch(m_SharedSnapshot, isSnapshotChanged);
+		m_StopCallback.Latch(m_SharedSnapshot, isSnapshotChanged);
+		m_DrawCallback.Latch(m_SharedSnapshot, isSnapshotChanged);
+		m_IdleCallback.Latch(m_SharedSnapshot, isSnapshotChanged);
+	}
+
+	void ExecInitCallback()
+	{
+		if (m_IsInitFunctionExecuted) return;
+
+		if (m_InitCallback.IsBound())
+		{
+			m_InitCallback.Invoke();
+			m_IsInitFunctionExecuted = true;
+		}
+	}
+
+	void ExecStopCallback()
+	{
+		m_StopCallback.Invoke();
+	}
+
+	void ExecDrawCallback()
+	{
+		if (!m_IsInitFunctionExecuted) return;
+
+		m_DrawCallback.Invoke();
+	}
+
+	void ExecIdleCallback()
+	{
+		if (!m_IsInitFunctionExecuted) return;
+
+		m_IdleCallback.Invoke();
+	}
+
+	void MainThreadEX();
+};
@@ -0,0 +1,169 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// input_queue.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "input_queue.h"
+
+#include <cstring>
+
+InputQueue::InputQueue(size_t capacity)
+	: m_Events(capacity)
+{
+	for (int device = 0; device < NUM_INPUT_DEVICES; device++)
+	{
+		for (int code = 0; code < MAX_CODES; code++)
+		{
+			m_Level[device][code].store(0);
+		}
+	}
+	m_IsOverflowed.store(false);
+	m_DroppedEvents.store(0);
+	memset(m_State, 0, sizeof(m_State));
+	memset(&m_LastEvent, 0, sizeof(m_LastEvent));
+	m_Step = 0;
+	m_LatchedStep = -1;
+}
+
+bool InputQueue::Push(INPUT_DEVICE device, int code, int action, double time, llong frameIndex)
+{
+	if (!IsValid(device, code)) return false;
+
+	uint8_t level = (action != 0) ? 1 : 0;
+	if (m_Level[device][code].load(std::memory_order_relaxed) == level) return false;
+	m_Level[device][code].store(level, std::memory_order_relaxed);
+
+	InputEvent event;
+	event.time = time;
+	event.frameIndex = frameIndex;
+	event.device = device;
+	event.code = code;
+	event.action = level;
+	if (!m_Events.Push(event))
+	{
+		// the application has not read its input for a while
+		m_IsOverflowed.store(true, std::memory_order_release);
+		m_DroppedEvents.fetch_add(1, std::memory_order_relaxed);
+	}
+	return true;
+}
+
+void InputQueue::Update()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Drain();
+}
+
+void InputQueue::EndStep()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Drain();
+	m_Step++;
+}
+
+bool InputQueue::IsPressed(INPUT_DEVICE device, int code)
+{
+	if (!IsValid(device, code)) return false;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Latch();
+	return m_State[device][code].stepPressed;
+}
+
+int InputQueue::ButtonChange(INPUT_DEVICE device, int code)
+{
+	if (!IsValid(device, code)) return 0;
+
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	Latch();
+	return m_State[device][code].stepChange;
+}
+
+void InputQueue::Latch()
+{
+	if (m_LatchedStep == m_Step) return;
+
+	Drain();
+	for (int device = 0; device < NUM_INPUT_DEVICES; device++)
+	{
+		for (int code = 0; code < MAX_CODES; code++)
+		{
+			ButtonState& state = m_State[device][code];
+			state.stepPressed = state.isDown || state.isLatched;
+			state.isLatched = false;
+
+			// the oldest change not yet reported
+			state.stepChange = 0;
+			if (!state.isReported && state.numPresses > 0)
+			{
+				state.numPresses--;
+				state.isReported = true;
+				state.stepChange = 1;
+			}
+			else if (state.isReported && state.numReleases > 0)
+			{
+				state.numReleases--;
+				state.isReported = false;
+				state.stepChange = -1;
+			}
+		}
+	}
+	m_LatchedStep = m_Step;
+}
+
+void InputQueue::Drain()
+{
+	InputEvent event;
+	while (m_Events.Pop(event))
+	{
+		Apply(event.device, event.code, event.action != 0);
+		m_LastEvent = event;
+	}
+
+	// the events are incomplete: take the current levels instead
+	if (m_IsOverflowed.exchange(false, std::memory_order_acquire))
+	{
+		while (m_Events.Pop(event))
+		{
+			m_LastEvent = event;
+		}
+		for (int device = 0; device < NUM_INPUT_DEVICES; device++)
+		{
+			for (int code = 0; code < MAX_CODES; code++)
+			{
+				Apply(device, code, m_Level[device][code].load(std::memory_order_relaxed) != 0);
+			}
+		}
+	}
+}
+
+void InputQueue::Apply(int device, int code, bool isDown)
+{
+	ButtonState& state = m_State[device][code];
+	if (state.isDown == isDown) return;
+
+	state.isDown = isDown;
+	if (isDown)
+	{
+		state.isLatched = true;
+		state.numPresses++;
+	}
+	else
+	{
+		state.numReleases++;
+	}
+	// a button nobody asks for keeps only its last press and release
+	while (state.numPresses > 1 && state.numReleases > 1)
+	{
+		state.numPresses--;
+		state.numReleases--;
+	}
+}
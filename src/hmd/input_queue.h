@@ -0,0 +1,126 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// input_queue.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../settings.h"
+#include "../sync/spsc_ring.h"
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+
+typedef enum {
+	INPUT_KEY = 0,           // GLFW key code
+	INPUT_MOUSE_BUTTON,      // GLFW mouse button
+	INPUT_CONTROLLER_BUTTON, // CAVE button number (1-4)
+	NUM_INPUT_DEVICES
+} INPUT_DEVICE;
+
+const int MAX_CONTROLLER_BUTTONS = 4;
+
+// controller state of one frame, published once per tracking update
+struct InputSnapshot
+{
+	llong    frameIndex;
+	double   time;        // seconds, HMD::GetTime()
+	uint32_t buttons;     // bit n - 1: CAVE button n is down
+	uint32_t mapped;      // bit n - 1: the controller has CAVE button n
+	uint32_t pressed;     // buttons that went down since the previous frame
+	uint32_t released;    // buttons that went up
+	float    joystick[2]; // x, y
+	bool     isConnected;
+	uint32_t changes[MAX_CONTROLLER_BUTTONS]; // presses and releases since the start
+};
+
+struct InputEvent
+{
+	double time;       // seconds, HMD::GetTime()
+	llong  frameIndex; // display frame in which the event was seen
+	int    device;     // INPUT_DEVICE
+	int    code;
+	int    action;     // BUTTON_PRESS / BUTTON_RELEASE
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// InputQueue: key, mouse and controller button events from the display
+// thread to the application.
+//
+//   The display thread owns the window and the controller, and pushes each
+//   change of a button into a lock-free ring as it sees it (Push() never
+//   blocks). The queries drain the ring into the button states, so the
+//   application never calls GLFW or OpenVR for its input. The consumer side
+//   is guarded by a mutex, which only other application-side callers can
+//   hold.
+//
+//   The answers are frozen once per application step (EndStep() is called
+//   by CAVEUSleep and CAVEWaitForFrame; the first query of the next step
+//   latches), so every caller in a step sees the same state and a query
+//   does not consume it. IsPressed() is true while the button is down, and
+//   also for a press released again before the latch, so a press shorter
+//   than one iteration of the application loop is not lost. ButtonChange()
+//   reports the presses and releases in order, one per step. If the ring
+//   overflows, the button states are resynchronized from the levels kept
+//   by the display thread.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class InputQueue {
+public:
+	static const int MAX_CODES = 512; // GLFW_KEY_LAST is 348
+
+	explicit InputQueue(size_t capacity = 1024);
+
+	// display thread; false if the button was already in this state
+	bool Push(INPUT_DEVICE device, int code, int action, double time, llong frameIndex);
+
+	// any other thread
+	void Update();  // drains the ring; the queries call it too
+	void EndStep(); // drains the ring; the next query latches a new step
+	bool IsPressed(INPUT_DEVICE device, int code);
+	int  ButtonChange(INPUT_DEVICE device, int code); // 1: pressed, -1: released, 0: no change
+	const InputEvent& lastEvent() const { return m_LastEvent; } // after Update()
+	uint64_t droppedEvents() const { return m_DroppedEvents.load(std::memory_order_relaxed); }
+
+private:
+	struct ButtonState
+	{
+		bool isDown;
+		bool isLatched;    // pressed since the last step was latched
+		bool isReported;   // down, as reported by ButtonChange()
+		int  numPresses;   // not yet reported by ButtonChange()
+		int  numReleases;
+		bool stepPressed;  // answers of the latched step
+		int  stepChange;
+	};
+
+	SPSCRing<InputEvent> m_Events;
+	std::atomic<uint8_t> m_Level[NUM_INPUT_DEVICES][MAX_CODES]; // display thread view
+	std::atomic<bool>    m_IsOverflowed;
+	std::atomic<uint64_t> m_DroppedEvents;
+
+	std::mutex  m_Mutex;
+	ButtonState m_State[NUM_INPUT_DEVICES][MAX_CODES];
+	InputEvent  m_LastEvent;
+	llong       m_Step;        // steps ended by EndStep()
+	llong       m_LatchedStep; // step of the answers
+
+	static bool IsValid(int device, int code)
+	{
+		return device >= 0 && device < NUM_INPUT_DEVICES && code >= 0 && code < MAX_CODES;
+	}
+	void Drain(); // with m_Mutex held
+	void Latch(); // with m_Mutex held
+	void Apply(int device, int code, bool isDown);
+};
@@ -0,0 +1,40 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// matrix_convert.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <glm/mat4x4.hpp> // glm::mat4
+
+// row-major matrices of the HMD runtimes (e.g. vr::HmdMatrix34_t::m) to the
+// column-major glm::mat4; kept apart from OpenVR so they can be measured
+// without the runtime
+
+// 3x4 pose: rotation and translation
+inline glm::mat4 RowMajor34ToGLM(const float m[3][4])
+{
+	return glm::mat4(
+		m[0][0], m[1][0], m[2][0], 0.0f,
+		m[0][1], m[1][1], m[2][1], 0.0f,
+		m[0][2], m[1][2], m[2][2], 0.0f,
+		m[0][3], m[1][3], m[2][3], 1.0f);
+}
+
+// 4x4, e.g. a projection
+inline glm::mat4 RowMajor44ToGLM(const float m[4][4])
+{
+	return glm::mat4(
+		m[0][0], m[1][0], m[2][0], m[3][0],
+		m[0][1], m[1][1], m[2][1], m[3][1],
+		m[0][2], m[1][2], m[2][2], m[3][2],
+		m[0][3], m[1][3], m[2][3], m[3][3]);
+}
@@ -0,0 +1,316 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// nav_transform.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "nav_transform.h"
+
+#include <cmath>
+
+#include <glm/mat3x3.hpp> // glm::mat3
+
+#include "pose_batch.h" // PoseBatch::AffineInverse
+
+#ifdef USE_SSE
+#include <emmintrin.h>
+#endif // USE_SSE
+
+static const float SCALE_EPSILON = 1.0e-6f; // relative
+static const float ORTHO_EPSILON = 1.0e-4f;
+
+NavigationTransform::NavigationTransform()
+{
+	LoadIdentity();
+}
+
+void NavigationTransform::LoadIdentity()
+{
+	m_IsDecomposed = true;
+	m_Translation = glm::vec3(0.0f, 0.0f, 0.0f);
+	m_Rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+	m_Scale = glm::vec3(1.0f, 1.0f, 1.0f);
+	m_General = glm::mat4(1.0f);
+	Invalidate();
+}
+
+void NavigationTransform::Load(const glm::mat4& matrix)
+{
+	SetGeneral(matrix);
+}
+
+void NavigationTransform::PreTranslate(const glm::vec3& translation)
+{
+	if (!m_IsDecomposed)
+	{
+		SetGeneral(glm::translate(glm::mat4(1.0f), translation) * m_General);
+		return;
+	}
+	m_Translation += translation;
+	Invalidate();
+}
+
+void NavigationTransform::PreRotate(const glm::quat& rotation)
+{
+	if (!m_IsDecomposed)
+	{
+		SetGeneral(glm::mat4_cast(rotation) * m_General);
+		return;
+	}
+	// R' T R S = T(R' t) (R' R) S
+	m_Translation = rotation * m_Translation;
+	m_Rotation = glm::normalize(rotation * m_Rotation);
+	Invalidate();
+}
+
+void NavigationTransform::PreScale(const glm::vec3& scale)
+{
+	// S' T R S = T(S' t) R (S' S) only if S' commutes with R
+	bool isAxisAligned = fabsf(fabsf(m_Rotation.w) - 1.0f) < SCALE_EPSILON;
+	if (!m_IsDecomposed || !(IsScaleUniform(scale) || isAxisAligned))
+	{
+		SetGeneral(glm::scale(glm::mat4(1.0f), scale) * matrix());
+		return;
+	}
+	m_Translation *= scale;
+	m_Scale *= scale;
+	Invalidate();
+}
+
+void NavigationTransform::PreMultiply(const glm::mat4& matrix)
+{
+	SetGeneral(matrix * this->matrix());
+}
+
+void NavigationTransform::PostTranslate(const glm::vec3& translation)
+{
+	if (!m_IsDecomposed)
+	{
+		SetGeneral(m_General * glm::translate(glm::mat4(1.0f), translation));
+		return;
+	}
+	m_Translation += m_Rotation * (m_Scale * translation);
+	Invalidate();
+}
+
+void NavigationTransform::PostRotate(const glm::quat& rotation)
+{
+	// T R S R' = T (R R') S only if S is uniform
+	if (!m_IsDecomposed || !IsScaleUniform(m_Scale))
+	{
+		SetGeneral(matrix() * glm::mat4_cast(rotation));
+		return;
+	}
+	m_Rotation = glm::normalize(m_Rotation * rotation);
+	Invalidate();
+}
+
+void NavigationTransform::PostScale(const glm::vec3& scale)
+{
+	if (!m_IsDecomposed)
+	{
+		SetGeneral(m_General * glm::scale(glm::mat4(1.0f), scale));
+		return;
+	}
+	m_Scale *= scale;
+	Invalidate();
+}
+
+void NavigationTransform::PostMultiply(const glm::mat4& matrix)
+{
+	SetGeneral(this->matrix() * matrix);
+}
+
+const glm::mat4& NavigationTransform::matrix()
+{
+	if (m_IsMatrixValid) return m_Matrix;
+
+	if (m_IsDecomposed)
+	{
+		glm::mat3 rotation = glm::mat3_cast(m_Rotation);
+		for (int column = 0; column < 3; column++)
+		{
+			m_Matrix[column] = glm::vec4(rotation[column] * m_Scale[column], 0.0f);
+		}
+		m_Matrix[3] = glm::vec4(m_Translation, 1.0f);
+	}
+	else
+	{
+		m_Matrix = m_General;
+	}
+	m_IsMatrixValid = true;
+	return m_Matrix;
+}
+
+const glm::mat4& NavigationTransform::inverse()
+{
+	if (m_IsInverseValid) return m_Inverse;
+
+	if (m_IsDecomposed)
+	{
+		// (T R S)^-1 = S^-1 R^T T(-t)
+		glm::mat3 rotation = glm::mat3_cast(glm::conjugate(m_Rotation));
+		glm::mat3 linear;
+		for (int column = 0; column < 3; column++)
+		{
+			for (int row = 0; row < 3; row++)
+			{
+				linear[column][row] = rotation[column][row] / m_Scale[row];
+			}
+		}
+		m_Inverse = glm::mat4(linear);
+		m_Inverse[3] = glm::vec4(-(linear * m_Translation), 1.0f);
+	}
+	else if (m_General[0][3] == 0.0f && m_General[1][3] == 0.0f && m_General[2][3] == 0.0f && m_General[3][3] == 1.0f)
+	{
+		m_Inverse = PoseBatch::AffineInverse(m_General);
+	}
+	else
+	{
+		// projective
+		m_Inverse = glm::inverse(m_General);
+	}
+	m_IsInverseValid = true;
+	return m_Inverse;
+}
+
+void NavigationTransform::SetGeneral(const glm::mat4& matrix)
+{
+	m_IsDecomposed = Decompose(matrix);
+	m_General = matrix;
+	Invalidate();
+}
+
+// splits an affine matrix without shear into translation, rotation and scale
+bool NavigationTransform::Decompose(const glm::mat4& matrix)
+{
+	if (matrix[0][3] != 0.0f || matrix[1][3] != 0.0f || matrix[2][3] != 0.0f || matrix[3][3] != 1.0f)
+	{
+		return false;
+	}
+
+	glm::vec3 axis[3];
+	glm::vec3 scale;
+	for (int column = 0; column < 3; column++)
+	{
+		axis[column] = glm::vec3(matrix[column][0], matrix[column][1], matrix[column][2]);
+		scale[column] = glm::length(axis[column]);
+		if (scale[column] < SCALE_EPSILON) return false;
+		axis[column] /= scale[column];
+	}
+	if (fabsf(glm::dot(axis[0], axis[1])) > ORTHO_EPSILON ||
+		fabsf(glm::dot(axis[1], axis[2])) > ORTHO_EPSILON ||
+		fabsf(glm::dot(axis[2], axis[0])) > ORTHO_EPSILON)
+	{
+		return false; // shear
+	}
+	if (glm::dot(glm::cross(axis[0], axis[1]), axis[2]) < 0.0f)
+	{
+		// mirrored: keep a proper rotation and move the sign to the scale
+		axis[0] = -axis[0];
+		scale[0] = -scale[0];
+	}
+
+	// Gram-Schmidt, so the rotation is orthonormal to float precision
+	axis[1] = glm::normalize(axis[1] - axis[0] * glm::dot(axis[0], axis[1]));
+	axis[2] = glm::cross(axis[0], axis[1]);
+
+	m_Translation = glm::vec3(matrix[3][0], matrix[3][1], matrix[3][2]);
+	m_Rotation = glm::normalize(glm::quat_cast(glm::mat3(axis[0], axis[1], axis[2])));
+	m_Scale = scale;
+	return true;
+}
+
+bool NavigationTransform::IsScaleUniform(const glm::vec3& scale) const
+{
+	float tolerance = SCALE_EPSILON * fabsf(scale.x);
+	return fabsf(scale.y - scale.x) <= tolerance && fabsf(scale.z - scale.x) <= tolerance;
+}
+
+void NavigationTransform::TransformPoints(const glm::mat4& matrix, const float in[][3], float out[][3], int count, bool isVector)
+{
+	// a projective matrix: the full product and the perspective divide. The
+	// bottom row changes only w, so vectors (w = 0) take the affine path.
+	bool isAffine = matrix[0][3] == 0.0f && matrix[1][3] == 0.0f && matrix[2][3] == 0.0f && matrix[3][3] == 1.0f;
+	if (!isVector && !isAffine)
+	{
+		for (int i = 0; i < count; i++)
+		{
+			glm::vec4 point = matrix * glm::vec4(in[i][0], in[i][1], in[i][2], 1.0f);
+			float w = (point.w != 0.0f) ? point.w : 1.0f;
+			for (int row = 0; row < 3; row++)
+			{
+				out[i][row] = point[row] / w;
+			}
+		}
+		return;
+	}
+
+	float m[12]; // [column][row], the translation is zero for vectors
+	for (int column = 0; column < 4; column++)
+	{
+		for (int row = 0; row < 3; row++)
+		{
+			m[column * 3 + row] = (isVector && column == 3) ? 0.0f : matrix[column][row];
+		}
+	}
+
+	int i = 0;
+#ifdef USE_SSE
+	__m128 c[12];
+	for (int k = 0; k < 12; k++)
+	{
+		c[k] = _mm_set1_ps(m[k]);
+	}
+
+	// four points (12 floats) at a time, transposed to x / y / z vectors
+	for (; i + 4 <= count; i += 4)
+	{
+		const float* src = in[i];
+		__m128 a = _mm_loadu_ps(src);
+		__m128 b = _mm_loadu_ps(src + 4);
+		__m128 d = _mm_loadu_ps(src + 8);
+		__m128 t0 = _mm_shuffle_ps(b, d, _MM_SHUFFLE(2, 1, 3, 2)); // x2 y2 x3 y3
+		__m128 t1 = _mm_shuffle_ps(a, b, _MM_SHUFFLE(1, 0, 2, 1)); // y0 z0 y1 z1
+		__m128 x = _mm_shuffle_ps(a, t0, _MM_SHUFFLE(2, 0, 3, 0));
+		__m128 y = _mm_shuffle_ps(t1, t0, _MM_SHUFFLE(3, 1, 2, 0));
+		__m128 z = _mm_shuffle_ps(t1, d, _MM_SHUFFLE(3, 0, 3, 1));
+
+		__m128 r[3];
+		for (int row = 0; row < 3; row++)
+		{
+			r[row] = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c[row], x), _mm_mul_ps(c[3 + row], y)),
+				_mm_add_ps(_mm_mul_ps(c[6 + row], z), c[9 + row]));
+		}
+
+		// back to x y z x | y z x y | z x y z
+		__m128 p, q;
+		float* dst = out[i];
+		p = _mm_shuffle_ps(r[0], r[1], _MM_SHUFFLE(0, 0, 1, 0));
+		q = _mm_shuffle_ps(r[2], r[0], _MM_SHUFFLE(1, 1, 0, 0));
+		_mm_storeu_ps(dst, _mm_shuffle_ps(p, q, _MM_SHUFFLE(2, 0, 2, 0)));
+		p = _mm_shuffle_ps(r[1], r[2], _MM_SHUFFLE(1, 1, 1, 1));
+		q = _mm_shuffle_ps(r[0], r[1], _MM_SHUFFLE(2, 2, 2, 2));
+		_mm_storeu_ps(dst + 4, _mm_shuffle_ps(p, q, _MM_SHUFFLE(2, 0, 2, 0)));
+		p = _mm_shuffle_ps(r[2], r[0], _MM_SHUFFLE(3, 3, 2, 2));
+		q = _mm_shuffle_ps(r[1], r[2], _MM_SHUFFLE(3, 3, 3, 3));
+		_mm_storeu_ps(dst + 8, _mm_shuffle_ps(p, q, _MM_SHUFFLE(2, 0, 2, 0)));
+	}
+#endif // USE_SSE
+
+	for (; i < count; i++)
+	{
+		float x = in[i][0], y = in[i][1], z = in[i][2];
+		for (int row = 0; row < 3; row++)
+		{
+			out[i][row] = m[row] * x + m[3 + row] * y + m[6 + row] * z + m[9 + row];
+		}
+	}
+}
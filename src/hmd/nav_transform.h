@@ -0,0 +1,83 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// nav_transform.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../settings.h"
+
+#include <glm/vec3.hpp> // glm::vec3
+#include <glm/mat4x4.hpp> // glm::mat4
+#include <glm/gtc/quaternion.hpp> // glm::quat
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// NavigationTransform: the navigation matrix kept as translation * rotation
+// * scale.
+//
+//   Translate / rotate / scale edits update the three parts directly; the
+//   rotation quaternion is normalized after every edit, so it does not
+//   drift however many small rotations are applied. The matrix and its
+//   inverse are built only when asked for, and cached until the next edit.
+//
+//   An edit that cannot be expressed this way (non-uniform scale across a
+//   rotation, shear, projection) switches to a general matrix. Each later
+//   edit tries to split it again, which also re-orthonormalizes it.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class NavigationTransform {
+public:
+	NavigationTransform();
+
+	void LoadIdentity();
+	void Load(const glm::mat4& matrix);
+
+	// edit * current
+	void PreTranslate(const glm::vec3& translation);
+	void PreRotate(const glm::quat& rotation);
+	void PreScale(const glm::vec3& scale);
+	void PreMultiply(const glm::mat4& matrix);
+
+	// current * edit
+	void PostTranslate(const glm::vec3& translation);
+	void PostRotate(const glm::quat& rotation);
+	void PostScale(const glm::vec3& scale);
+	void PostMultiply(const glm::mat4& matrix);
+
+	const glm::mat4& matrix();
+	const glm::mat4& inverse();
+
+	bool IsDecomposed() const { return m_IsDecomposed; }
+
+	// out = matrix * in for count xyz points (w = 1, divided by the result's
+	// w if the matrix is projective) or vectors (w = 0); in and out may be
+	// the same array
+	static void TransformPoints(const glm::mat4& matrix, const float in[][3], float out[][3], int count, bool isVector);
+
+private:
+	bool      m_IsDecomposed;
+	glm::vec3 m_Translation;
+	glm::quat m_Rotation;
+	glm::vec3 m_Scale;
+	glm::mat4 m_General; // used when m_IsDecomposed is false
+
+	glm::mat4 m_Matrix;
+	glm::mat4 m_Inverse;
+	bool      m_IsMatrixValid;
+	bool      m_IsInverseValid;
+
+	void SetGeneral(const glm::mat4& matrix);
+	bool Decompose(const glm::mat4& matrix);
+	bool IsScaleUniform(const glm::vec3& scale) const;
+	void Invalidate() { m_IsMatrixValid = m_IsInverseValid = false; }
+};
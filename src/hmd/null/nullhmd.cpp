@@ -0,0 +1,286 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// nullhmd.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "nullhmd.h"
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+const int NULL_HMD_ESCKEY = 256; // CAVE_ESCKEY
+
+NullHMD::NullHMD()
+{
+#ifdef _WIN32
+	m_Window = nullptr;
+#else
+	m_Display = EGL_NO_DISPLAY;
+	m_Context = EGL_NO_CONTEXT;
+#endif // _WIN32
+
+	m_MaxFrames = 0;
+	m_FrameRate = 0.0;
+	m_NextFrameTime = 0.0;
+	m_InterpupillaryDistance = 0.064f;
+	m_FieldOfView = static_cast<float>(100.0 * M_PI / 180.0);
+	m_FrameBufferWidth  = 1440;
+	m_FrameBufferHeight = 1600;
+
+	const char* env;
+	if ((env = getenv("CLCL_NULL_FRAMES")) != nullptr)
+	{
+		m_MaxFrames = atoll(env);
+	}
+	if ((env = getenv("CLCL_NULL_RATE")) != nullptr)
+	{
+		m_FrameRate = atof(env);
+		if (m_FrameRate > 0.0)
+		{
+			m_DisplayFrequency = static_cast<float>(m_FrameRate);
+		}
+	}
+	if ((env = getenv("CLCL_NULL_RESOLUTION")) != nullptr)
+	{
+		unsigned int width, height;
+		if (sscanf(env, "%ux%u", &width, &height) == 2 && width > 0 && height > 0)
+		{
+			m_FrameBufferWidth  = width;
+			m_FrameBufferHeight = height;
+		}
+	}
+}
+
+NullHMD::~NullHMD()
+{
+}
+
+void NullHMD::Init()
+{
+	fprintf(stderr, "HMD: null (%d x %d", m_FrameBufferWidth, m_FrameBufferHeight);
+	if (m_FrameRate > 0.0)
+	{
+		fprintf(stderr, " @ %g Hz)\n", m_FrameRate);
+	}
+	else
+	{
+		fprintf(stderr, ", unpaced)\n");
+	}
+
+	m_IsControllerConnected = true;
+}
+
+void NullHMD::InitGL()
+{
+#ifdef _WIN32
+	if (!glfwInit())
+	{
+		exit(EXIT_FAILURE);
+	}
+	glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+	m_Window = glfwCreateWindow(64, 64, "CLCL (null)", NULL, NULL);
+	if (!m_Window)
+	{
+		glfwTerminate();
+		exit(EXIT_FAILURE);
+	}
+	glfwMakeContextCurrent(m_Window);
+	glfwSwapInterval(0);
+#else
+	PFNEGLGETPLATFORMDISPLAYEXTPROC eglGetPlatformDisplayEXT =
+		(PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+	if (eglGetPlatformDisplayEXT != nullptr)
+	{
+		m_Display = eglGetPlatformDisplayEXT(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, nullptr);
+	}
+	if (m_Display == EGL_NO_DISPLAY)
+	{
+		m_Display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+
+	EGLint major, minor;
+	if (!eglInitialize(m_Display, &major, &minor))
+	{
+		std::cerr << "ERROR: Could not initialize EGL." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	eglBindAPI(EGL_OPENGL_API);
+
+	const EGLint configAttribs[] = {
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_NONE
+	};
+	EGLConfig config;
+	EGLint numConfigs = 0;
+	if (!eglChooseConfig(m_Display, configAttribs, &config, 1, &numConfigs) || numConfigs < 1)
+	{
+		std::cerr << "ERROR: No EGL config for desktop OpenGL." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+
+	// compatibility profile: the CAVE applications use fixed-function OpenGL
+	m_Context = eglCreateContext(m_Display, config, EGL_NO_CONTEXT, nullptr);
+	if (m_Context == EGL_NO_CONTEXT ||
+		!eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, m_Context))
+	{
+		std::cerr << "ERROR: Could not create a surfaceless EGL context." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+#endif // _WIN32
+
+	glewExperimental = GL_TRUE;
+	GLenum err = glewInit();
+#ifdef GLEW_ERROR_NO_GLX_DISPLAY
+	// GLEW built without EGL support cannot find a GLX display, but the entry points are loaded
+	if (err == GLEW_ERROR_NO_GLX_DISPLAY) err = GLEW_OK;
+#endif // GLEW_ERROR_NO_GLX_DISPLAY
+	if (err != GLEW_OK) {
+		std::cout << "glewInit failed, aborting." << std::endl;
+		exit(EXIT_FAILURE);
+	}
+	std::cerr << "GL: " << glGetString(GL_RENDERER) << " (" << glGetString(GL_VERSION) << ")" << std::endl;
+
+	m_OVRVision.Init();
+}
+
+void NullHMD::CreateBuffers()
+{
+	float aspect = static_cast<float>(m_FrameBufferWidth) / static_cast<float>(m_FrameBufferHeight);
+	for (int eyeIndex = 0; eyeIndex < m_NumEyes; eyeIndex++)
+	{
+		m_ProjectionMatrix[eyeIndex] = glm::perspective(m_FieldOfView, aspect, m_NearPlaneZ, m_FarPlaneZ);
+	}
+
+	HMD::CreateBuffers();
+}
+
+void NullHMD::Terminate()
+{
+	m_OVRVision.Terminate();
+	DeleteBuffers();
+
+#ifdef _WIN32
+	glfwDestroyWindow(m_Window);
+	glfwTerminate();
+#else
+	eglMakeCurrent(m_Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+	eglDestroyContext(m_Display, m_Context);
+	eglTerminate(m_Display);
+#endif // _WIN32
+}
+
+void NullHMD::UpdateTrackingData()
+{
+	WaitForNextFrame();
+
+	m_FrameIndex++;
+
+	double now = GetTime();
+	if (m_MaxFrames > 0 && m_FrameIndex == m_MaxFrames)
+	{
+		PushInput(INPUT_KEY, NULL_HMD_ESCKEY, BUTTON_PRESS, now);
+	}
+	SynthesizePoses(now, &m_HeadPose, &m_HandPose);
+	UpdateHeadPose();
+	UpdateHandPose(0.0f);
+	RecordPose(SENSOR_HEAD, now, m_HeadPose);
+	RecordPose(SENSOR_WAND, now, m_HandPose);
+
+	// a controller without buttons
+	InputSnapshot snapshot;
+	memset(&snapshot, 0, sizeof(snapshot));
+	snapshot.frameIndex = m_FrameIndex;
+	snapshot.time = now;
+	snapshot.isConnected = m_IsControllerConnected;
+	PublishInput(snapshot);
+}
+
+void NullHMD::PreProcess()
+{
+	for (int eyeIndex = 0; eyeIndex < m_NumEyes; eyeIndex++)
+	{
+		float offset = (eyeIndex == 0 ? -0.5f : 0.5f) * m_InterpupillaryDistance;
+		m_EyePose[eyeIndex] = glm::translate(glm::mat4(1.0f), glm::vec3(offset, 0.0f, 0.0f));
+	}
+
+	m_OVRVision.PreStore();
+	frameTimer().Begin(STAGE_CAMERA_UPLOAD);
+	m_OVRVision.Upload();
+	frameTimer().End(STAGE_CAMERA_UPLOAD);
+}
+
+void NullHMD::SubmitFrame(int eyeIndex)
+{
+	// nothing to submit: the frame stays in the offscreen FBO
+}
+
+void NullHMD::DrawBackground(int eyeIndex)
+{
+	m_OVRVision.DrawImege(eyeIndex);
+}
+
+void NullHMD::PostProcess()
+{
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glFlush();
+}
+
+bool NullHMD::GetKey(int key)
+{
+	if (key == NULL_HMD_ESCKEY && m_MaxFrames > 0)
+	{
+		return m_FrameIndex >= m_MaxFrames;
+	}
+	return false;
+}
+
+// the synthetic motion is known ahead, so prediction is exact
+bool NullHMD::PredictPoses(float secondsFromNow, glm::mat4* headPose, glm::mat4* handPose)
+{
+	SynthesizePoses(GetTime() + secondsFromNow, headPose, handPose);
+	return true;
+}
+
+void NullHMD::SynthesizePoses(double t, glm::mat4* headPose, glm::mat4* handPose)
+{
+	// head: seated user looking around slowly (tracking space, meters)
+	float yaw  = static_cast<float>(20.0 * M_PI / 180.0 * sin(2.0 * M_PI * 0.25 * t));
+	float bob  = static_cast<float>(0.02 * sin(2.0 * M_PI * 0.5 * t));
+	if (headPose != nullptr)
+	{
+		*headPose = glm::rotate(glm::translate(glm::mat4(1.0f), glm::vec3(0.0f, bob, 0.0f)),
+			yaw, glm::vec3(0.0f, 1.0f, 0.0f));
+	}
+	if (handPose == nullptr) return;
+
+	// wand: right hand in front of the body, sweeping left and right
+	float sweep = static_cast<float>(30.0 * M_PI / 180.0 * sin(2.0 * M_PI * 0.2 * t));
+	float lift  = static_cast<float>(0.05 * sin(2.0 * M_PI * 0.3 * t));
+	*handPose = glm::translate(glm::mat4(1.0f), glm::vec3(0.2f, -0.3f + lift, -0.4f));
+	*handPose = glm::rotate(*handPose, sweep, glm::vec3(0.0f, 1.0f, 0.0f));
+	*handPose = glm::rotate(*handPose, static_cast<float>(-20.0 * M_PI / 180.0), glm::vec3(1.0f, 0.0f, 0.0f));
+}
+
+void NullHMD::WaitForNextFrame()
+{
+	if (m_FrameRate <= 0.0) return;
+
+	double now = GetTime();
+	if (m_NextFrameTime <= now)
+	{
+		// first frame, or the loop fell behind: restart pacing from now
+		m_NextFrameTime = now + 1.0 / m_FrameRate;
+		return;
+	}
+	std::this_thread::sleep_for(std::chrono::duration<double>(m_NextFrameTime - now));
+	m_NextFrameTime += 1.0 / m_FrameRate;
+}
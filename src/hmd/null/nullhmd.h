@@ -0,0 +1,87 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// nullhmd.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../hmd.h"
+#include "../../camera/ovrvision/ovrvision.h"
+
+#ifdef _WIN32
+#include <GLFW/glfw3.h>
+#pragma comment(lib, "GLFW3.lib")
+#pragma comment(lib, "GLEW32s.lib")
+#pragma comment(lib, "opengl32.lib")
+#else
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+#endif // _WIN32
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// NullHMD: headless backend without an HMD runtime.
+//
+//   Both eyes are rendered into offscreen FBOs of a software GL context
+//   (a hidden GLFW window on Windows, EGL surfaceless on the other platforms)
+//   and head/wand poses are synthesized. It is used to run and profile CLCL
+//   applications on machines without a headset.
+//
+//   Environment variables:
+//     CLCL_NULL_FRAMES     : report CAVE_ESCKEY after the given number of frames
+//     CLCL_NULL_RATE       : pace the display loop at the given rate [Hz]
+//                            (default: 0, run as fast as possible)
+//     CLCL_NULL_RESOLUTION : render target size per eye, e.g. "1440x1600"
+//
+//   The camera passthrough is drawn if CLCL_CAMERA selects a source
+//   (see camera_source.h), e.g. "synthetic" to time its upload headlessly.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class NullHMD : public HMD {
+public:
+	NullHMD();
+	~NullHMD();
+
+	const char* name() const { return "null"; }
+	void Init();
+	void InitGL();
+	void CreateBuffers();
+	void Terminate();
+	void UpdateTrackingData();
+	void PreProcess();
+	void PostProcess();
+	void SubmitFrame(int eyeIndex);
+	void DrawBackground(int eyeIndex);
+	bool PredictPoses(float secondsFromNow, glm::mat4* headPose, glm::mat4* handPose);
+
+	bool GetKey(int key);
+
+	llong maxFrames() { return m_MaxFrames; }
+
+private:
+#ifdef _WIN32
+	GLFWwindow* m_Window;
+#else
+	EGLDisplay  m_Display;
+	EGLContext  m_Context;
+#endif // _WIN32
+
+	llong  m_MaxFrames;
+	double m_FrameRate;
+	double m_NextFrameTime;
+	float  m_InterpupillaryDistance;
+	float  m_FieldOfView;
+	OVRVision m_OVRVision;
+
+	static void SynthesizePoses(double t, glm::mat4* headPose, glm::mat4* handPose);
+	void WaitForNextFrame();
+};
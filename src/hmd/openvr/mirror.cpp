@@ -0,0 +1,187 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// mirror.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "mirror.h"
+
+#ifdef USE_OPENVR
+
+Mirror::Mirror()
+{
+	m_Window = nullptr;
+	m_IsThreadEnabled = false;
+	m_Texture = 0;
+	m_FrameBuffer = 0;
+	m_Width = 0;
+	m_Height = 0;
+	m_IsRunning = false;
+	m_IsFrameReady = false;
+	m_Fence = 0;
+}
+
+Mirror::~Mirror()
+{
+}
+
+void Mirror::InitGL(GLFWwindow* window, bool useThread)
+{
+	m_Window = window;
+	m_IsThreadEnabled = useThread;
+	if (!m_IsThreadEnabled) return;
+
+	glfwGetFramebufferSize(m_Window, &m_Width, &m_Height);
+
+	glGenTextures(1, &m_Texture);
+	glBindTexture(GL_TEXTURE_2D, m_Texture);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_Width, m_Height, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+	glBindTexture(GL_TEXTURE_2D, 0);
+
+	glGenFramebuffers(1, &m_FrameBuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, m_FrameBuffer);
+	glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Texture, 0);
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+
+	m_IsRunning = true;
+	m_Thread = std::thread(&Mirror::ThreadMain, this);
+}
+
+void Mirror::TerminateGL()
+{
+	if (m_IsThreadEnabled)
+	{
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_IsRunning = false;
+		}
+		m_Condition.notify_one();
+		if (m_Thread.joinable())
+		{
+			m_Thread.join();
+		}
+		if (m_Fence != 0)
+		{
+			glDeleteSync(m_Fence);
+			m_Fence = 0;
+		}
+		glDeleteFramebuffers(1, &m_FrameBuffer);
+		glDeleteTextures(1, &m_Texture);
+	}
+}
+
+void Mirror::Present(MIRROR_MODE mode, const GLuint frameBuffer[2], int width, int height)
+{
+	if (!m_IsThreadEnabled)
+	{
+		int windowWidth, windowHeight;
+		glfwGetFramebufferSize(m_Window, &windowWidth, &windowHeight);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GL_NONE);
+		Blit(mode, frameBuffer, width, height, windowWidth, windowHeight);
+		glfwSwapBuffers(m_Window);
+		return;
+	}
+
+	{
+		// the mirror thread has not taken the previous copy yet
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (m_IsFrameReady) return;
+	}
+
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, m_FrameBuffer);
+	Blit(mode, frameBuffer, width, height, m_Width, m_Height);
+	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GL_NONE);
+	GLsync fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	glFlush();
+
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		if (m_Fence != 0)
+		{
+			glDeleteSync(m_Fence);
+		}
+		m_Fence = fence;
+		m_IsFrameReady = true;
+	}
+	m_Condition.notify_one();
+}
+
+// draw framebuffer must be bound
+void Mirror::Blit(MIRROR_MODE mode, const GLuint frameBuffer[2], int width, int height, int windowWidth, int windowHeight)
+{
+	glViewport(0, 0, windowWidth, windowHeight);
+	glClear(GL_COLOR_BUFFER_BIT);
+	if (mode == MIRROR_BOTH_EYES)
+	{
+		for (int eyeIndex = 0; eyeIndex < 2; eyeIndex++)
+		{
+			int x0 = eyeIndex * windowWidth / 2;
+			glBindFramebuffer(GL_READ_FRAMEBUFFER, frameBuffer[eyeIndex]);
+			glBlitFramebuffer(0, 0, width, height, x0, 0, x0 + windowWidth / 2, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		}
+	}
+	else
+	{
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, frameBuffer[0]);
+		glBlitFramebuffer(0, 0, width, height, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+	}
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, GL_NONE);
+}
+
+void Mirror::ThreadMain()
+{
+	glfwMakeContextCurrent(m_Window);
+	glfwSwapInterval(1); // only this thread waits for the desktop vsync
+
+	// framebuffer objects are not shared between contexts
+	GLuint frameBuffer;
+	glGenFramebuffers(1, &frameBuffer);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, frameBuffer);
+	glFramebufferTexture2D(GL_READ_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_Texture, 0);
+	glBindFramebuffer(GL_READ_FRAMEBUFFER, GL_NONE);
+
+	for (;;)
+	{
+		GLsync fence;
+		{
+			std::unique_lock<std::mutex> lock(m_Mutex);
+			m_Condition.wait(lock, [this] { return m_IsFrameReady || !m_IsRunning; });
+			if (!m_IsRunning) break;
+			fence = m_Fence;
+			m_Fence = 0;
+		}
+
+		glWaitSync(fence, 0, GL_TIMEOUT_IGNORED);
+		glDeleteSync(fence);
+
+		int windowWidth, windowHeight;
+		glfwGetFramebufferSize(m_Window, &windowWidth, &windowHeight);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, frameBuffer);
+		glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GL_NONE);
+		glViewport(0, 0, windowWidth, windowHeight);
+		glBlitFramebuffer(0, 0, m_Width, m_Height, 0, 0, windowWidth, windowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
+		glBindFramebuffer(GL_READ_FRAMEBUFFER, GL_NONE);
+		glFinish(); // the copy has been read, the display thread may write it again
+
+		{
+			std::lock_guard<std::mutex> lock(m_Mutex);
+			m_IsFrameReady = false;
+		}
+
+		glfwSwapBuffers(m_Window);
+	}
+
+	glDeleteFramebuffers(1, &frameBuffer);
+	glfwMakeContextCurrent(nullptr);
+}
+
+#endif // USE_OPENVR
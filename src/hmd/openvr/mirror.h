@@ -0,0 +1,74 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// mirror.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../hmd.h"
+
+#ifdef USE_OPENVR
+
+#include <condition_variable>
+#include <mutex>
+
+#include <GLFW/glfw3.h>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Mirror: presents the eye images in the desktop window.
+//
+//   Without a thread, Present() blits the eyes to the window and swaps with
+//   swap interval 0, so the mirror never waits for the desktop vsync in
+//   series with WaitGetPoses().
+//
+//   With a thread, the display thread renders with a hidden window's
+//   context, and Present() only copies the eyes into a window-sized texture
+//   shared with the mirror window's context, then wakes the mirror thread,
+//   which draws the texture and swaps at its own pace. A new copy is made
+//   only after the mirror thread has taken the previous one.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class Mirror {
+public:
+	Mirror();
+	~Mirror();
+
+	// display thread, with the rendering context current
+	void InitGL(GLFWwindow* window, bool useThread);
+	void TerminateGL();
+	void Present(MIRROR_MODE mode, const GLuint frameBuffer[2], int width, int height);
+
+	bool IsThreadEnabled() const { return m_IsThreadEnabled; }
+
+private:
+	GLFWwindow* m_Window;
+	bool        m_IsThreadEnabled;
+
+	// copy of the eyes shared with the mirror thread
+	GLuint      m_Texture;
+	GLuint      m_FrameBuffer;
+	int         m_Width;
+	int         m_Height;
+
+	std::thread m_Thread;
+	std::mutex  m_Mutex;
+	std::condition_variable m_Condition;
+	bool        m_IsRunning;
+	bool        m_IsFrameReady;
+	GLsync      m_Fence;
+
+	void Blit(MIRROR_MODE mode, const GLuint frameBuffer[2], int width, int height, int windowWidth, int windowHeight);
+	void ThreadMain();
+};
+
+#endif // USE_OPENVR
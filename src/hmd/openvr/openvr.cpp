@@ -13,6 +13,10 @@
 
 #include "openvr.h"
 
+#include <cstring>
+
+#ifdef USE_OPENVR
+
 #ifdef ENABLE_CONTROLLER_MODEL
 
 #if defined(_WIN32)
@@ -293,7 +297,7 @@ void OpenVR::DrawController(int eyeIndex)
 
 	glUseProgram(m_unRenderModelProgramID);
 	int eHand = 0; // reft:1, right:0
-	glm::mat4 MVPMatrix = m_ProjectionMatrix[eyeIndex] * glm::inverse(m_EyePose[eyeIndex] * m_HeadPose) * m_HandPose;
+	glm::mat4 MVPMatrix = m_ProjectionMatrix[eyeIndex] * glm::inverse(m_EyePose[eyeIndex] * m_RenderHeadPose[eyeIndex]) * m_HandPose;
 	glUniformMatrix4fv(m_nRenderModelMatrixLocation, 1, GL_FALSE, &(MVPMatrix[0][0]));
 	m_rHand[eHand].m_pRenderModel->Draw();
 	glUseProgram(0);
@@ -304,58 +308,60 @@ OpenVR::OpenVR()
 {
 	m_HmdSession = nullptr;
 
-	m_NumEyes = 2;
+	m_Window = nullptr;
+	m_RenderWindow = nullptr;
+	m_UseMirrorThread = false;
+	m_VsyncToPhotons = 0.0f;
+	m_HandDeviceIndex.store(vr::k_unTrackedDeviceIndexInvalid);
+	for (int i = 0; i < vr::k_unMaxTrackedDeviceCount; i++)
+	{
+		m_Devices[i].isActive = false;
+		m_Devices[i].deviceClass = vr::TrackedDeviceClass_Invalid;
+		m_Devices[i].role = vr::TrackedControllerRole_Invalid;
+		m_Devices[i].sensor = -1;
+		m_SensorIndex[i] = -1;
+	}
+	m_NumActiveDevices = 0;
+	m_NumSensors = SENSOR_WAND + 1;
 	m_WindowHeight = 1080;
-	m_NearPlaneZ   = 0.01f;
-	m_FarPlaneZ    = 10000.0f;
 	m_VerticalFieldOfView = static_cast<float>(45.0 * M_PI / 180.0);
-	m_FrameBufferWidth  = 1920;
-	m_FrameBufferHeight = 1080;
-
-	m_BodyTranslation = glm::vec3(0.0f, 0.0f, 0.0f);
-	m_BodyRotation = glm::vec3(0.0f, 0.0f, 0.0f);
-
-	for (int i = 0; i < 3; i++)
-	{
-		m_HeadVector[i] = glm::vec3(0.0f, 0.0f, 0.0f);
-	}
-	m_HeadVector[VECTOR_FRONT] = glm::vec3(0.0f, 0.0f, -1.0f);
-
-	for (int i = 0; i < m_NumEyes; i++)
-	{
-		m_FrameBuffer[i] = 0;
-		m_TextureBuffer[i] = 0;
-		m_DepthBuffer[i] = 0;
-	}
-
-	m_FrameIndex = 0;
-//	m_SnapNo = 0;
-	m_NavigationMatrix = glm::mat4(1.0f);
-	m_ModelMatrix = glm::mat4(1.0f);
 
 	for (int i = 0; i < 4; i++)
 	{
 		m_ButtonState[i] = -1;
 	}
-
-	m_IsThreadRunning = true;
-	m_IsInitializedGLFW.store(false);
-	m_HMutex = nullptr;
-	m_HRender = nullptr;
-	p_InitFunction = nullptr;
-	p_StopFunction = nullptr;
-	p_DrawFunction = nullptr;
-	p_IdleFunction = nullptr;
-
-	m_IsInitFunctionExecuted = false;
-
-	m_DeviceType = HTC_VIVE;
-	m_IsControllerConnected = false;
+	memset(&m_ControllerState, 0, sizeof(m_ControllerState));
+	m_ControllerMapping = MakeControllerMapping(m_DeviceType);
 
 #ifdef ENABLE_CONTROLLER_MODEL
 	m_IsControllerModelLoaded = false;
 	m_IsControllerModelVisible = false;
 #endif // ENABLE_CONTROLLER_MODEL
+
+	const char* env;
+	if ((env = getenv("CLCL_MIRROR")) != nullptr)
+	{
+		if (stricmp(env, "off") == 0)
+		{
+			SetMirrorMode(MIRROR_OFF);
+		}
+		else if (stricmp(env, "left") == 0)
+		{
+			SetMirrorMode(MIRROR_LEFT_EYE);
+		}
+		else if (stricmp(env, "both") == 0)
+		{
+			SetMirrorMode(MIRROR_BOTH_EYES);
+		}
+	}
+	if ((env = getenv("CLCL_MIRROR_INTERVAL")) != nullptr)
+	{
+		SetMirrorInterval(atoi(env));
+	}
+	if ((env = getenv("CLCL_MIRROR_THREAD")) != nullptr)
+	{
+		m_UseMirrorThread = (atoi(env) != 0);
+	}
 }
 
 OpenVR::~OpenVR()
@@ -379,6 +385,11 @@ void OpenVR::Init()
 	const std::string& serial = GetHMDString(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_SerialNumber_String, nullptr);
 	const float freq = m_HmdSession->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_DisplayFrequency_Float);
 	fprintf(stderr, "HMD: %s '%s' #%s (%d x %d @ %g Hz)\n", driver.c_str(), model.c_str(), serial.c_str(), m_FrameBufferWidth, m_FrameBufferHeight, freq);
+	if (freq > 0.0f)
+	{
+		m_DisplayFrequency = freq;
+	}
+	m_VsyncToPhotons = m_HmdSession->GetFloatTrackedDeviceProperty(vr::k_unTrackedDeviceIndex_Hmd, vr::Prop_SecondsFromVsyncToPhotons_Float);
 
 	if (model.find("Oculus") != std::string::npos)
 	{
@@ -388,6 +399,7 @@ void OpenVR::Init()
 	{
 		m_DeviceType = WINDOWS_MR;
 	}
+	m_ControllerMapping = MakeControllerMapping(m_DeviceType);
 
 	if (!vr::VRCompositor())
 	{
@@ -398,6 +410,16 @@ void OpenVR::Init()
 
 //	vr::VRCompositor()->SetTrackingSpace(vr::ETrackingUniverseOrigin::TrackingUniverseStanding);
 	vr::VRCompositor()->SetTrackingSpace(vr::ETrackingUniverseOrigin::TrackingUniverseSeated);
+
+	// devices connected before we started do not send activation events
+	for (vr::TrackedDeviceIndex_t nDevice = 0; nDevice < vr::k_unMaxTrackedDeviceCount; nDevice++)
+	{
+		if (m_HmdSession->IsTrackedDeviceConnected(nDevice))
+		{
+			RefreshDevice(nDevice);
+		}
+	}
+	UpdateActiveDevices();
 }
 
 void OpenVR::InitGL()
@@ -420,8 +442,23 @@ void OpenVR::InitGL()
 
 	glfwSetWindowUserPointer(m_Window, this); // technique for registering member functions as callback functions
 
-	glfwMakeContextCurrent(m_Window);
-	glfwSwapInterval(1);
+	// with the mirror thread, the display thread renders with a hidden window
+	// sharing its objects with the mirror window
+	m_RenderWindow = m_Window;
+	if (m_UseMirrorThread)
+	{
+		glfwWindowHint(GLFW_VISIBLE, GL_FALSE);
+		m_RenderWindow = glfwCreateWindow(64, 64, "CLCL", NULL, m_Window);
+		glfwWindowHint(GLFW_VISIBLE, GL_TRUE);
+		if (!m_RenderWindow)
+		{
+			m_RenderWindow = m_Window;
+			m_UseMirrorThread = false;
+		}
+	}
+
+	glfwMakeContextCurrent(m_RenderWindow);
+	glfwSwapInterval(0); // the HMD paces the loop (WaitGetPoses)
 	glfwSetKeyCallback(m_Window, KeyCallback);
 	glfwSetMouseButtonCallback(m_Window, MouseButtonCallback);
 	glfwSetCursorPosCallback(m_Window, MouseCursorPositionCallback);
@@ -436,10 +473,10 @@ void OpenVR::InitGL()
 		exit(EXIT_FAILURE);
 	}
 
-#ifdef USE_OVRVISION
 	m_OVRVision.Init();
 //	m_OVRVision.toggleCameraState(); // change value from "false" to "true" (default: false)
-#endif // USE_OVRVISION
+
+	m_Mirror.InitGL(m_Window, m_UseMirrorThread);
 }
 
 std::string OpenVR::GetHMDString(
@@ -462,23 +499,24 @@ std::string OpenVR::GetHMDString(
 
 glm::mat4 OpenVR::ToGLM(vr::HmdMatrix44_t InMatrix)
 {
-	glm::mat4 OutMatrix(
-		InMatrix.m[0][0], InMatrix.m[1][0], InMatrix.m[2][0], InMatrix.m[3][0],
-		InMatrix.m[0][1], InMatrix.m[1][1], InMatrix.m[2][1], InMatrix.m[3][1],
-		InMatrix.m[0][2], InMatrix.m[1][2], InMatrix.m[2][2], InMatrix.m[3][2],
-		InMatrix.m[0][3], InMatrix.m[1][3], InMatrix.m[2][3], InMatrix.m[3][3]
-	);
-	return OutMatrix;
+	return RowMajor44ToGLM(InMatrix.m);
 }
 
 glm::mat4 OpenVR::ToGLM(vr::HmdMatrix34_t InMatrix)
 {
-	glm::mat4 OutMatrix(
-		InMatrix.m[0][0], InMatrix.m[1][0], InMatrix.m[2][0], 0.0,
-		InMatrix.m[0][1], InMatrix.m[1][1], InMatrix.m[2][1], 0.0,
-		InMatrix.m[0][2], InMatrix.m[1][2], InMatrix.m[2][2], 0.0,
-		InMatrix.m[0][3], InMatrix.m[1][3], InMatrix.m[2][3], 1.0f
-	);
+	return RowMajor34ToGLM(InMatrix.m);
+}
+
+vr::HmdMatrix34_t OpenVR::ToHmdMatrix34(const glm::mat4& InMatrix)
+{
+	vr::HmdMatrix34_t OutMatrix;
+	for (int row = 0; row < 3; row++)
+	{
+		for (int column = 0; column < 4; column++)
+		{
+			OutMatrix.m[row][column] = InMatrix[column][row];
+		}
+	}
 	return OutMatrix;
 }
 
@@ -489,40 +527,7 @@ void OpenVR::CreateBuffers()
 		m_ProjectionMatrix[eyeIndex] = ToGLM(m_HmdSession->GetProjectionMatrix(vr::EVREye(eyeIndex), m_NearPlaneZ, m_FarPlaneZ)); // openvr 1.0.5
 	}
 
-	glGenFramebuffers(m_NumEyes, m_FrameBuffer);
-	glGenTextures(m_NumEyes, m_TextureBuffer);
-	glGenTextures(m_NumEyes, m_DepthBuffer);
-	for (int eyeIndex = 0; eyeIndex < m_NumEyes; eyeIndex++)
-	{
-		glBindTexture(GL_TEXTURE_2D, m_TextureBuffer[eyeIndex]);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, m_FrameBufferWidth, m_FrameBufferHeight, 0, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
-
-		glBindTexture(GL_TEXTURE_2D, m_DepthBuffer[eyeIndex]);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
-		glTexImage2D(GL_TEXTURE_2D, 0, GL_DEPTH_COMPONENT24, m_FrameBufferWidth, m_FrameBufferHeight, 0, GL_DEPTH_COMPONENT, GL_UNSIGNED_INT, nullptr);
-
-		glBindFramebuffer(GL_FRAMEBUFFER, m_FrameBuffer[eyeIndex]);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, m_TextureBuffer[eyeIndex], 0);
-		glFramebufferTexture2D(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_TEXTURE_2D, m_DepthBuffer[eyeIndex], 0);
-	}
-	glBindRenderbuffer(GL_RENDERBUFFER, 0);
-	glBindTexture(GL_TEXTURE_2D, 0);
-	glBindFramebuffer(GL_FRAMEBUFFER, 0);
-
-	if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE)
-	{
-		glDeleteFramebuffers(m_NumEyes, m_FrameBuffer);
-		glDeleteTextures(m_NumEyes, m_TextureBuffer);
-		glDeleteRenderbuffers(m_NumEyes, m_DepthBuffer);
-		exit(EXIT_FAILURE);
-	}
+	HMD::CreateBuffers();
 
 #ifdef ENABLE_CONTROLLER_MODEL
 	if (!CreateShader())
@@ -532,10 +537,14 @@ void OpenVR::CreateBuffers()
 
 void OpenVR::Terminate()
 {
-	glDeleteFramebuffers(m_NumEyes, m_FrameBuffer);
-	glDeleteTextures(2, m_TextureBuffer);
-	glDeleteRenderbuffers(2, m_DepthBuffer);
+	m_Mirror.TerminateGL();
+	m_OVRVision.Terminate();
+	DeleteBuffers();
 
+	if (m_RenderWindow != m_Window)
+	{
+		glfwDestroyWindow(m_RenderWindow);
+	}
 	glfwDestroyWindow(m_Window);
 	glfwTerminate();
 
@@ -549,258 +558,238 @@ void OpenVR::UpdateTrackingData()
 {
 	m_FrameIndex++;
 
+	ProcessEvents();
+
 	vr::TrackedDevicePose_t trackedDevicePose[vr::k_unMaxTrackedDeviceCount];
 	vr::VRCompositor()->WaitGetPoses(trackedDevicePose, vr::k_unMaxTrackedDeviceCount, nullptr, 0);
 
-	for (int nDevice = 0; nDevice < vr::k_unMaxTrackedDeviceCount; ++nDevice)
+	// the poses are predicted to the time this frame is displayed
+	double poseTime = GetTime() + SecondsToPhotons();
+
+	for (int i = 0; i < m_NumActiveDevices; i++)
 	{
-		if (trackedDevicePose[nDevice].bPoseIsValid)
+		vr::TrackedDeviceIndex_t nDevice = m_ActiveDevices[i];
+		if (!trackedDevicePose[nDevice].bPoseIsValid) continue;
+
+		const TrackedDevice& device = m_Devices[nDevice];
+		glm::mat4 pose = ToGLM(trackedDevicePose[nDevice].mDeviceToAbsoluteTracking);
+		if (device.deviceClass == vr::TrackedDeviceClass_HMD)
+		{
+			m_HeadPose = pose;
+			UpdateHeadPose();
+		}
+		else if (device.sensor == SENSOR_WAND)
 		{
-			switch (m_HmdSession->GetTrackedDeviceClass(nDevice))
+			vr::VRSystem()->GetControllerState(nDevice, &m_ControllerState, sizeof(vr::VRControllerState_t));
+
+			float offset_angle = 0.0;
+			if (m_DeviceType == OCULUS_RIFT_CV1)
 			{
-				case vr::TrackedDeviceClass_HMD:
-					vr::HmdMatrix34_t headPose_SteamVR = trackedDevicePose[vr::k_unTrackedDeviceIndex_Hmd].mDeviceToAbsoluteTracking;
-					m_HeadPose = ToGLM(headPose_SteamVR);
-					glm::mat4 newMatrix = glm::transpose(glm::mat4(
-						m_HeadPose[0][0], m_HeadPose[1][0], m_HeadPose[2][0], m_HeadPose[3][0] / FEET_PER_METER,
-						m_HeadPose[0][1], m_HeadPose[1][1], m_HeadPose[2][1], m_HeadPose[3][1] / FEET_PER_METER,
-						m_HeadPose[0][2], m_HeadPose[1][2], m_HeadPose[2][2], m_HeadPose[3][2] / FEET_PER_METER,
-						m_HeadPose[0][3], m_HeadPose[1][3], m_HeadPose[2][3], m_HeadPose[3][3]));
-					m_HeadTranslation = glm::vec3(
-						m_HeadPose[3][0] / FEET_PER_METER,
-						m_HeadPose[3][1] / FEET_PER_METER,
-						m_HeadPose[3][2] / FEET_PER_METER);
-					m_HeadVector[VECTOR_RIGHT] = glm::normalize(glm::vec3(newMatrix[0][0], newMatrix[0][1], newMatrix[0][2]));
-					m_HeadVector[VECTOR_UP] = glm::normalize(glm::vec3(newMatrix[1][0], newMatrix[1][1], newMatrix[1][2]));
-					m_HeadVector[VECTOR_FRONT] = glm::normalize(glm::vec3(-newMatrix[2][0], -newMatrix[2][1], -newMatrix[2][2]));
-//					float angle_x, angle_y, angle_z;
-//					finalRollPitchYaw.ToEulerAngles<OVR::Axis_Y, OVR::Axis_X, OVR::Axis_Z, OVR::Rotate_CCW, OVR::Handed_R>(&angle_x, &angle_y, &angle_z);
-//					m_HeadOrientation = glm::vec3(angle_x, angle_y, angle_z);
-
-					glm::mat4 navMatrix = glm::inverse(m_NavigationMatrix) * newMatrix;
-					m_HeadTranslationNav = glm::vec3(navMatrix[3][0], navMatrix[3][1], navMatrix[3][2]);
-					m_HeadVectorNav[VECTOR_RIGHT] = glm::normalize(glm::vec3( navMatrix[0][0],  navMatrix[0][1],  navMatrix[0][2]));
-					m_HeadVectorNav[VECTOR_UP]    = glm::normalize(glm::vec3( navMatrix[1][0],  navMatrix[1][1],  navMatrix[1][2]));
-					m_HeadVectorNav[VECTOR_FRONT] = glm::normalize(glm::vec3(-navMatrix[2][0], -navMatrix[2][1], -navMatrix[2][2]));
-					break;
-				case vr::TrackedDeviceClass_Controller:
-					vr::ETrackedControllerRole trackedControllerRoll;
-					trackedControllerRoll = vr::VRSystem()->GetControllerRoleForTrackedDeviceIndex(nDevice);
-					if (trackedControllerRoll == vr::TrackedControllerRole_RightHand)
-					{
-						vr::VRSystem()->GetControllerState(nDevice, &m_ControllerState, sizeof(vr::VRControllerState_t));
-
-						float offset_angle = 0.0;
-						if (m_DeviceType == OCULUS_RIFT_CV1)
-						{
-							offset_angle = static_cast<float>(-30.0 / 180.0 * M_PI);
-						}
-						m_HandPose = ToGLM(trackedDevicePose[nDevice].mDeviceToAbsoluteTracking);
-						glm::mat4 newMatrix = glm::rotate(glm::transpose(glm::mat4(
-							m_HandPose[0][0], m_HandPose[1][0], m_HandPose[2][0], m_HandPose[3][0] / FEET_PER_METER,
-							m_HandPose[0][1], m_HandPose[1][1], m_HandPose[2][1], m_HandPose[3][1] / FEET_PER_METER,
-							m_HandPose[0][2], m_HandPose[1][2], m_HandPose[2][2], m_HandPose[3][2] / FEET_PER_METER,
-							m_HandPose[0][3], m_HandPose[1][3], m_HandPose[2][3], m_HandPose[3][3])),
-							offset_angle, glm::vec3(1.0f, 0.0f, 0.0f));
-						m_HandTranslation = glm::vec3(
-							m_HandPose[3][0] / FEET_PER_METER,
-							m_HandPose[3][1] / FEET_PER_METER,
-							m_HandPose[3][2] / FEET_PER_METER);
-						m_HandVector[VECTOR_RIGHT] = glm::normalize(glm::vec3( newMatrix[0][0],  newMatrix[0][1],  newMatrix[0][2]));
-						m_HandVector[VECTOR_UP]    = glm::normalize(glm::vec3( newMatrix[1][0],  newMatrix[1][1],  newMatrix[1][2]));
-						m_HandVector[VECTOR_FRONT] = glm::normalize(glm::vec3(-newMatrix[2][0], -newMatrix[2][1], -newMatrix[2][2]));
-						glm::mat4 navMatrix = glm::inverse(m_NavigationMatrix) * newMatrix;
-						m_HandTranslationNav = glm::vec3(navMatrix[3][0], navMatrix[3][1], navMatrix[3][2]);
-						m_HandVectorNav[VECTOR_RIGHT] = glm::normalize(glm::vec3( navMatrix[0][0],  navMatrix[0][1],  navMatrix[0][2]));
-						m_HandVectorNav[VECTOR_UP]    = glm::normalize(glm::vec3( navMatrix[1][0],  navMatrix[1][1],  navMatrix[1][2]));
-						m_HandVectorNav[VECTOR_FRONT] = glm::normalize(glm::vec3(-navMatrix[2][0], -navMatrix[2][1], -navMatrix[2][2]));
-
-						m_IsControllerConnected = true;
+				offset_angle = static_cast<float>(-30.0 / 180.0 * M_PI);
+			}
+			m_HandPose = pose;
+			UpdateHandPose(offset_angle);
+
+			m_IsControllerConnected = true;
 
 #ifdef ENABLE_CONTROLLER_MODEL
-						if (!m_IsControllerModelLoaded)
-						{
-							const std::string& renderModelName = GetHMDString(
-								nDevice, vr::Prop_RenderModelName_String, nullptr);
-							int eHand = 0; // reft:1, right:0
-							m_rHand[eHand].m_pRenderModel = FindOrLoadRenderModel(renderModelName.c_str());
-							if (m_rHand[eHand].m_pRenderModel == NULL)
-								std::cout << "ERROR: m_rHand[eHand].m_pRenderModel = NULL" << std::endl;
-							m_rHand[eHand].m_sRenderModelName = renderModelName;
-							m_IsControllerModelLoaded = true;
-						}
-#endif // ENABLE_CONTROLLER_MODEL
-					}
-					break;
-				default:
-					break;
+			if (!m_IsControllerModelLoaded)
+			{
+				int eHand = 0; // reft:1, right:0
+				m_rHand[eHand].m_pRenderModel = FindOrLoadRenderModel(device.renderModelName.c_str());
+				if (m_rHand[eHand].m_pRenderModel == NULL)
+					std::cout << "ERROR: m_rHand[eHand].m_pRenderModel = NULL" << std::endl;
+				m_rHand[eHand].m_sRenderModelName = device.renderModelName;
+				m_IsControllerModelLoaded = true;
 			}
+#endif // ENABLE_CONTROLLER_MODEL
+		}
+		else if (device.sensor >= 0)
+		{
+			UpdateSensorPose(device.sensor, pose, 0.0f);
 		}
-	}
-}
 
-void OpenVR::PreProcess()
-{
-	for (int eyeIndex = 0; eyeIndex < m_NumEyes; eyeIndex++)
-	{
-		m_EyePose[eyeIndex] = ToGLM(m_HmdSession->GetEyeToHeadTransform(vr::EVREye(eyeIndex)));
+		if (device.sensor >= 0)
+		{
+			RecordPose(device.sensor, poseTime, pose);
+		}
 	}
 
-#ifdef USE_OVRVISION
-	m_OVRVision.PreStore();
-#endif // USE_OVRVISION
+	PublishControllerState();
 }
 
-void OpenVR::SubmitFrame(int eyeIndex)
-{
-//	const vr::Texture_t tex = { reinterpret_cast<void*>(intptr_t(m_TextureBuffer[eyeIndex])), vr::API_OpenGL, vr::ColorSpace_Gamma }; // openvr 1.0.3
-	const vr::Texture_t tex = { reinterpret_cast<void*>(intptr_t(m_TextureBuffer[eyeIndex])), vr::TextureType_OpenGL, vr::ColorSpace_Gamma }; // openvr 1.0.5
-	vr::VRCompositor()->Submit(vr::EVREye(eyeIndex), &tex);
-}
-
-void OpenVR::PostProcess()
-{
-	vr::VRCompositor()->PostPresentHandoff();
-
-	glBindFramebuffer(GL_DRAW_FRAMEBUFFER, GL_NONE);
-	glViewport(0, 0, m_WindowWidth, m_WindowHeight);
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-	glBlitFramebuffer(0, 0, m_FrameBufferWidth, m_FrameBufferHeight, 0, 0, m_WindowWidth, m_WindowHeight, GL_COLOR_BUFFER_BIT, GL_LINEAR);
-	glBindFramebuffer(GL_READ_FRAMEBUFFER, GL_NONE);
-
-	glfwSwapBuffers(m_Window);
-	glfwPollEvents();
-}
-
-void OpenVR::SetMatrix(int eyeIndex)
+void OpenVR::ProcessEvents()
 {
-	m_CurrentEyeIndex = eyeIndex;
-
-	glBindFramebuffer(GL_FRAMEBUFFER, m_FrameBuffer[eyeIndex]);
-	glViewport(0, 0, m_FrameBufferWidth, m_FrameBufferHeight);
-
-	glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-
-#ifdef USE_OVRVISION
-	m_OVRVision.DrawImege(eyeIndex);
-#endif // USE_OVRVISION
-
-	glEnable(GL_DEPTH_TEST);
+	bool isChanged = false;
+	vr::VREvent_t event;
+	while (m_HmdSession->PollNextEvent(&event, sizeof(event)))
+	{
+		switch (event.eventType)
+		{
+			case vr::VREvent_TrackedDeviceActivated:
+			case vr::VREvent_TrackedDeviceUpdated:
+				if (event.trackedDeviceIndex < vr::k_unMaxTrackedDeviceCount)
+				{
+					RefreshDevice(event.trackedDeviceIndex);
+					isChanged = true;
+				}
+				break;
+			case vr::VREvent_TrackedDeviceDeactivated:
+				if (event.trackedDeviceIndex < vr::k_unMaxTrackedDeviceCount)
+				{
+					m_Devices[event.trackedDeviceIndex].isActive = false;
+					isChanged = true;
+				}
+				break;
+			case vr::VREvent_TrackedDeviceRoleChanged:
+				// the event does not say which controllers swapped
+				for (vr::TrackedDeviceIndex_t nDevice = 0; nDevice < vr::k_unMaxTrackedDeviceCount; nDevice++)
+				{
+					if (m_Devices[nDevice].isActive && m_Devices[nDevice].deviceClass == vr::TrackedDeviceClass_Controller)
+					{
+						RefreshDevice(nDevice);
+					}
+				}
+				isChanged = true;
+				break;
+			default:
+				break;
+		}
+	}
 
-	glUseProgram(0);
-	glMatrixMode(GL_PROJECTION);
-	glLoadMatrixf(&(m_ProjectionMatrix[eyeIndex][0][0]));
-	glMatrixMode(GL_MODELVIEW);
-	glLoadMatrixf(&(glm::inverse(m_EyePose[eyeIndex] * m_HeadPose))[0][0]);
+	if (isChanged)
+	{
+		UpdateActiveDevices();
+	}
 }
 
-void OpenVR::Translate(float x, float y, float z)
+// head and right hand use the CAVE sensor numbers, other controllers and
+// trackers get the next free slot when they are first seen
+void OpenVR::RefreshDevice(vr::TrackedDeviceIndex_t nDevice)
 {
-	glm::mat4 currentMatrix = m_NavigationMatrix;
-	m_NavigationMatrix = glm::translate(glm::mat4(1.0f), glm::vec3(-x, -y, -z)) * currentMatrix;
-}
+	TrackedDevice& device = m_Devices[nDevice];
+	device.isActive = true;
+	device.deviceClass = m_HmdSession->GetTrackedDeviceClass(nDevice);
+	device.role = vr::TrackedControllerRole_Invalid;
+	device.sensor = -1;
 
-void OpenVR::Rotate(float angle_degree, char axis)
-{
-	float angle_radian = -angle_degree * (float)M_PI / 180.0f;
-	glm::mat4 currentMatrix = m_NavigationMatrix;
-	switch (tolower(axis))
+	switch (device.deviceClass)
 	{
-		case 'x':
-			m_NavigationMatrix = glm::rotate(glm::mat4(1.0f), angle_radian, glm::vec3(1.0f, 0.0f, 0.0f)) * currentMatrix;
+		case vr::TrackedDeviceClass_HMD:
+			device.sensor = SENSOR_HEAD;
 			break;
-		case 'y':
-			m_NavigationMatrix = glm::rotate(glm::mat4(1.0f), angle_radian, glm::vec3(0.0f, 1.0f, 0.0f)) * currentMatrix;
-			break;
-		case 'z':
-			m_NavigationMatrix = glm::rotate(glm::mat4(1.0f), angle_radian, glm::vec3(0.0f, 0.0f, 1.0f)) * currentMatrix;
+		case vr::TrackedDeviceClass_Controller:
+		case vr::TrackedDeviceClass_GenericTracker:
+			device.role = m_HmdSession->GetControllerRoleForTrackedDeviceIndex(nDevice);
+			if (device.role == vr::TrackedControllerRole_RightHand)
+			{
+				device.sensor = SENSOR_WAND;
+				device.renderModelName = GetHMDString(nDevice, vr::Prop_RenderModelName_String, nullptr);
+				break;
+			}
+			if (m_SensorIndex[nDevice] < 0 && m_NumSensors < MAX_SENSORS)
+			{
+				m_SensorIndex[nDevice] = m_NumSensors++;
+			}
+			device.sensor = m_SensorIndex[nDevice];
 			break;
 		default:
 			break;
 	}
 }
 
-void OpenVR::Scale(float x, float y, float z)
+void OpenVR::UpdateActiveDevices()
 {
-	glm::mat4 currentMatrix = m_NavigationMatrix;
-	m_NavigationMatrix = glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / x, 1.0f / y, 1.0f / z)) * currentMatrix;
-}
+	vr::TrackedDeviceIndex_t handDevice = vr::k_unTrackedDeviceIndexInvalid;
+	m_NumActiveDevices = 0;
+	for (vr::TrackedDeviceIndex_t nDevice = 0; nDevice < vr::k_unMaxTrackedDeviceCount; nDevice++)
+	{
+		const TrackedDevice& device = m_Devices[nDevice];
+		if (!device.isActive || device.sensor < 0) continue;
 
-void OpenVR::WorldTranslate(float x, float y, float z)
-{
-	m_NavigationMatrix = glm::translate(m_NavigationMatrix, glm::vec3(-x, -y, -z));
+		m_ActiveDevices[m_NumActiveDevices++] = nDevice;
+		if (device.sensor == SENSOR_WAND)
+		{
+			handDevice = nDevice;
+		}
+	}
+	m_HandDeviceIndex.store(handDevice);
 }
 
-void OpenVR::WorldRotate(float angle_degree, char axis)
+void OpenVR::PreProcess()
 {
-	float angle_radian = -angle_degree * (float)M_PI / 180.0f;
-	switch (tolower(axis))
+	for (int eyeIndex = 0; eyeIndex < m_NumEyes; eyeIndex++)
 	{
-		case 'x':
-			m_NavigationMatrix = glm::rotate(m_NavigationMatrix, angle_radian, glm::vec3(1.0f, 0.0f, 0.0f));
-			break;
-		case 'y':
-			m_NavigationMatrix = glm::rotate(m_NavigationMatrix, angle_radian, glm::vec3(0.0f, 1.0f, 0.0f));
-			break;
-		case 'z':
-			m_NavigationMatrix = glm::rotate(m_NavigationMatrix, angle_radian, glm::vec3(0.0f, 0.0f, 1.0f));
-			break;
-		default:
-			break;
+		m_EyePose[eyeIndex] = ToGLM(m_HmdSession->GetEyeToHeadTransform(vr::EVREye(eyeIndex)));
 	}
-}
 
-void OpenVR::WorldScale(float x, float y, float z)
-{
-	m_NavigationMatrix *= glm::scale(glm::mat4(1.0f), glm::vec3(1.0f / x, 1.0f / y, 1.0f / z));
+	m_OVRVision.PreStore();
+	frameTimer().Begin(STAGE_CAMERA_UPLOAD);
+	m_OVRVision.Upload();
+	frameTimer().End(STAGE_CAMERA_UPLOAD);
 }
 
-glm::mat4 OpenVR::GetNavigationMatrix()
+void OpenVR::SubmitFrame(int eyeIndex)
 {
-	return m_NavigationMatrix;
+//	const vr::Texture_t tex = { reinterpret_cast<void*>(intptr_t(m_TextureBuffer[eyeIndex])), vr::API_OpenGL, vr::ColorSpace_Gamma }; // openvr 1.0.3
+	const vr::Texture_t tex = { reinterpret_cast<void*>(intptr_t(m_TextureBuffer[eyeIndex])), vr::TextureType_OpenGL, vr::ColorSpace_Gamma }; // openvr 1.0.5
+	if (m_IsLateLatchEnabled.load(std::memory_order_relaxed))
+	{
+		// tell the compositor which pose the eye was rendered with
+		vr::VRTextureWithPose_t texWithPose;
+		static_cast<vr::Texture_t&>(texWithPose) = tex;
+		texWithPose.mDeviceToAbsoluteTracking = ToHmdMatrix34(m_RenderHeadPose[eyeIndex]);
+		vr::VRCompositor()->Submit(vr::EVREye(eyeIndex), &texWithPose, nullptr, vr::Submit_TextureWithPose);
+		return;
+	}
+	vr::VRCompositor()->Submit(vr::EVREye(eyeIndex), &tex);
 }
 
-void OpenVR::LoadNavigationMatrix(glm::mat4 matrix)
+// seconds until the frame being rendered is displayed
+float OpenVR::SecondsToPhotons()
 {
-	m_NavigationMatrix = matrix;
+	float secondsSinceLastVsync;
+	if (!m_HmdSession->GetTimeSinceLastVsync(&secondsSinceLastVsync, nullptr))
+	{
+		return HMD::SecondsToPhotons();
+	}
+	return 1.0f / m_DisplayFrequency - secondsSinceLastVsync + m_VsyncToPhotons;
 }
 
-void OpenVR::SetNavigationMatrix()
+bool OpenVR::PredictPoses(float secondsFromNow, glm::mat4* headPose, glm::mat4* handPose)
 {
-	glMatrixMode(GL_MODELVIEW);
-	glMultMatrixf(&m_NavigationMatrix[0][0]);
-}
+	vr::TrackedDevicePose_t trackedDevicePose[vr::k_unMaxTrackedDeviceCount];
+	m_HmdSession->GetDeviceToAbsoluteTrackingPose(vr::TrackingUniverseSeated, secondsFromNow, trackedDevicePose, vr::k_unMaxTrackedDeviceCount);
 
-void OpenVR::SetNavigationInverseMatrix()
-{
-	glMatrixMode(GL_MODELVIEW);
-	glMultMatrixf(&(glm::inverse(m_NavigationMatrix))[0][0]);
-}
+	const vr::TrackedDevicePose_t& head = trackedDevicePose[vr::k_unTrackedDeviceIndex_Hmd];
+	if (!head.bPoseIsValid) return false;
+	if (headPose != nullptr)
+	{
+		*headPose = ToGLM(head.mDeviceToAbsoluteTracking);
+	}
 
-void OpenVR::SetNavigationMatrixIdentity()
-{
-	m_NavigationMatrix = glm::mat4(1.0f);
+	vr::TrackedDeviceIndex_t hand = m_HandDeviceIndex.load();
+	if (handPose != nullptr && hand < vr::k_unMaxTrackedDeviceCount && trackedDevicePose[hand].bPoseIsValid)
+	{
+		*handPose = ToGLM(trackedDevicePose[hand].mDeviceToAbsoluteTracking);
+	}
+	return true;
 }
 
-void OpenVR::MultiNavigationMatrix(float matrix[4][4])
+void OpenVR::PostProcess()
 {
-	glm::mat4 InMatrix = glm::mat4(
-		matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0],
-		matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1],
-		matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2],
-		matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3]);
-	glm::mat4 currentMatrix = m_NavigationMatrix;
-	m_NavigationMatrix = InMatrix * currentMatrix;
+	vr::VRCompositor()->PostPresentHandoff();
+
+	if (IsMirrorFrame())
+	{
+		m_Mirror.Present(mirrorMode(), m_FrameBuffer, m_FrameBufferWidth, m_FrameBufferHeight);
+	}
+	glBindFramebuffer(GL_FRAMEBUFFER, GL_NONE);
 }
 
-void OpenVR::PreMultiNavigationMatrix(float matrix[4][4])
+void OpenVR::DrawBackground(int eyeIndex)
 {
-	glm::mat4 InMatrix = glm::mat4(
-		matrix[0][0], matrix[1][0], matrix[2][0], matrix[3][0],
-		matrix[0][1], matrix[1][1], matrix[2][1], matrix[3][1],
-		matrix[0][2], matrix[1][2], matrix[2][2], matrix[3][2],
-		matrix[0][3], matrix[1][3], matrix[2][3], matrix[3][3]);
-	m_NavigationMatrix *= InMatrix;
+	m_OVRVision.DrawImege(eyeIndex);
 }
 
 bool OpenVR::GetKey(int key)
@@ -825,145 +814,71 @@ int OpenVR::GetMouseButton(int button)
 	return result;
 }
 
-void OpenVR::StartThread()
-{
-	DWORD m_MainThreadID = GetCurrentThreadId();
-
-	m_HMutex = CreateMutex(NULL, FALSE, NULL);
-	m_HRender = (HANDLE)_beginthreadex(0, 0, MainThreadLauncherEX, reinterpret_cast<void*>(this), 0, 0);
-
-	while (!m_IsInitializedGLFW.load()); // waiting the initialization of GLFW
-}
-
-void OpenVR::StopThread()
-{
-	CloseHandle(m_HRender);
-	CloseHandle(m_HMutex);
-}
-
-void OpenVR::MainThreadEX()
+ControllerMapping OpenVR::MakeControllerMapping(DEVICE_TYPE type)
 {
-	DWORD m_DisplayThreadID = GetCurrentThreadId();
-
-	Init();
-	InitGL();
-	CreateBuffers();
-
-	m_IsInitializedGLFW.store(true);
-
-	while (m_IsThreadRunning)
+	ControllerMapping mapping;
+	for (int i = 0; i < MAX_CONTROLLER_BUTTONS; i++)
 	{
-		ExecInitCallback();
-		UpdateTrackingData();
-		ExecIdleCallback();
-		PreProcess();
-		for (int eyeIndex = 0; eyeIndex < m_NumEyes; eyeIndex++)
-		{
-			SetMatrix(eyeIndex);
-			glPushMatrix();
-			glScalef(FEET_PER_METER, FEET_PER_METER, FEET_PER_METER);
-			ExecDrawCallback();
-			glPopMatrix();
-
-#ifdef ENABLE_CONTROLLER_MODEL
-			DrawController(eyeIndex);
-#endif // ENABLE_CONTROLLER_MODEL 
-
-			SubmitFrame(eyeIndex);
-		}
-		PostProcess();
+		mapping.buttonMask[i] = 0;
+		mapping.buttonAxis[i] = -1;
 	}
 
-	ExecStopCallback();
-	Terminate();
-}
-
-unsigned __stdcall OpenVR::MainThreadLauncherEX(void *obj)
-{
-	reinterpret_cast<OpenVR*>(obj)->MainThreadEX();
-	_endthreadex(0);
-	return 0;
-}
-
-bool OpenVR::IsMainThread()
-{
-	if (GetCurrentThreadId() == m_MainThreadID)
+	if (type == OCULUS_RIFT_CV1)
 	{
-		return true;
+		mapping.buttonMask[0] = vr::ButtonMaskFromId(vr::EVRButtonId::k_EButton_A); // for Oculus
+		mapping.joystickTouch = 0;
+		mapping.joystickBlock = 0;
 	}
 	else
 	{
-		return false;
+		mapping.buttonMask[0] = vr::ButtonMaskFromId(vr::EVRButtonId::k_EButton_Grip); // for HTC VIVE (and Microsoft Mixed Reality)
+		mapping.joystickTouch = vr::ButtonMaskFromId(vr::EVRButtonId::k_EButton_SteamVR_Touchpad);
+		mapping.joystickBlock = vr::ButtonMaskFromId(vr::EVRButtonId::k_EButton_Axis0);
 	}
+	mapping.buttonAxis[1] = 1; // trigger
+	mapping.buttonMask[2] = vr::ButtonMaskFromId(vr::EVRButtonId::k_EButton_ApplicationMenu);
+	// button 4: not implemented
+	return mapping;
 }
 
-bool OpenVR::IsDisplayThread()
+void OpenVR::PublishControllerState()
 {
-	if (GetCurrentThreadId() == m_DisplayThreadID)
-	{
-		return true;
-	}
-	else
-	{
-		return false;
-	}
-}
-
-int OpenVR::GetButtonState(int buttonNumber)
-{
-	int state = -1;
-
-	uint64_t buttonState = m_ControllerState.ulButtonPressed;
-	uint64_t buttonMask;
+	const ControllerMapping& mapping = m_ControllerMapping;
+	const vr::VRControllerState_t& state = m_ControllerState;
 
-	switch (buttonNumber)
+	InputSnapshot snapshot;
+	snapshot.frameIndex = m_FrameIndex;
+	snapshot.time = GetTime();
+	snapshot.buttons = 0;
+	snapshot.mapped = 0;
+	snapshot.joystick[0] = snapshot.joystick[1] = 0.0f;
+	snapshot.isConnected = m_IsControllerConnected;
+	for (int i = 0; i < MAX_CONTROLLER_BUTTONS; i++)
 	{
-		case 1:
-			if (m_DeviceType == OCULUS_RIFT_CV1)
-			{
-				buttonMask = vr::ButtonMaskFromId(vr::EVRButtonId::k_EButton_A); // for Oculus
-			}
-			else
-			{
-				buttonMask = vr::ButtonMaskFromId(vr::EVRButtonId::k_EButton_Grip); // for HTC VIVE (and Microsoft Mixed Reality)
-			}
-			if (buttonState & buttonMask) state = 1;
-			else state = 0;
-			break;
-		case 2:
-			if (m_ControllerState.rAxis[1].x > 0.5f) state = 1;
-			else state = 0;
-			break;
-		case 3:
-			buttonMask = vr::ButtonMaskFromId(vr::EVRButtonId::k_EButton_ApplicationMenu);
-			if (buttonState & buttonMask) state = 1;
-			else state = 0;
-			break;
-		default:
-			break;
-	}
-
-	return state;
-}
-
-std::pair<float, float> OpenVR::GetJoyStickValue()
-{
-	if (m_DeviceType == OCULUS_RIFT_CV1)
-	{
-		return std::pair<float, float>(m_ControllerState.rAxis[0].x, m_ControllerState.rAxis[0].y);
+		if (mapping.buttonMask[i] != 0 || mapping.buttonAxis[i] >= 0)
+		{
+			snapshot.mapped |= 1u << i;
+		}
 	}
-	else
+	if (m_IsControllerConnected)
 	{
-		if (!(m_ControllerState.ulButtonPressed &
-			(vr::ButtonMaskFromId(vr::EVRButtonId::k_EButton_Axis0))))
+		for (int i = 0; i < MAX_CONTROLLER_BUTTONS; i++)
 		{
-			if (m_ControllerState.ulButtonTouched &
-				vr::ButtonMaskFromId(vr::EVRButtonId::k_EButton_SteamVR_Touchpad))
+			int axis = mapping.buttonAxis[i];
+			if ((state.ulButtonPressed & mapping.buttonMask[i]) ||
+				(axis >= 0 && state.rAxis[axis].x > 0.5f))
 			{
-				return std::pair<float, float>(m_ControllerState.rAxis[0].x, m_ControllerState.rAxis[0].y);
+				snapshot.buttons |= 1u << i;
 			}
 		}
+		if ((state.ulButtonTouched & mapping.joystickTouch) == mapping.joystickTouch &&
+			!(state.ulButtonPressed & mapping.joystickBlock))
+		{
+			snapshot.joystick[0] = state.rAxis[0].x;
+			snapshot.joystick[1] = state.rAxis[0].y;
+		}
 	}
-
-	return std::pair<float, float>(0.0f, 0.0f);
+	PublishInput(snapshot);
 }
+
+#endif // USE_OPENVR
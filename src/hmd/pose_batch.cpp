@@ -0,0 +1,235 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// pose_batch.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "pose_batch.h"
+
+#include <cmath>
+
+#include <glm/mat3x3.hpp> // glm::mat3
+#include <glm/gtc/matrix_inverse.hpp>
+
+#ifdef USE_SSE
+#include <emmintrin.h>
+#endif // USE_SSE
+
+PoseBatch::PoseBatch(int capacity)
+{
+	m_Capacity = capacity;
+	m_Stride = (capacity + 3) & ~3;
+	m_Size = 0;
+	m_Data.assign(NUM_FIELDS * m_Stride, 0.0f);
+
+	// identity poses, so unused lanes stay finite
+	for (int i = 0; i < m_Stride; i++)
+	{
+		field(IN_C0X)[i] = 1.0f;
+		field(IN_C1Y)[i] = 1.0f;
+		field(IN_C2Z)[i] = 1.0f;
+		field(IN_COS)[i] = 1.0f;
+	}
+}
+
+void PoseBatch::Set(int index, const glm::mat4& pose, float offsetAngle)
+{
+	if (index < 0 || index >= m_Capacity) return;
+
+	for (int column = 0; column < 3; column++)
+	{
+		for (int row = 0; row < 3; row++)
+		{
+			field(IN_C0X + column * 3 + row)[index] = pose[column][row];
+		}
+		field(IN_TX + column)[index] = pose[3][column];
+	}
+	field(IN_COS)[index] = cosf(offsetAngle);
+	field(IN_SIN)[index] = sinf(offsetAngle);
+
+	if (index >= m_Size)
+	{
+		m_Size = index + 1;
+	}
+}
+
+void PoseBatch::Transform(const glm::mat4& navInverse, float positionScale)
+{
+	float nav[12];
+	for (int column = 0; column < 4; column++)
+	{
+		for (int row = 0; row < 3; row++)
+		{
+			nav[column * 3 + row] = navInverse[column][row];
+		}
+	}
+
+	int first = 0;
+#ifdef USE_SSE
+	const __m128 scale = _mm_set1_ps(positionScale);
+	const __m128 zero  = _mm_setzero_ps();
+	__m128 n[12];
+	for (int i = 0; i < 12; i++)
+	{
+		n[i] = _mm_set1_ps(nav[i]);
+	}
+
+	// the last group may run into the padding lanes, which hold identity poses
+	for (; first < m_Size; first += 4)
+	{
+		__m128 c[3][3], t[3];
+		for (int k = 0; k < 3; k++)
+		{
+			t[k] = _mm_mul_ps(_mm_loadu_ps(field(IN_TX + k) + first), scale);
+			for (int j = 0; j < 3; j++)
+			{
+				c[k][j] = _mm_loadu_ps(field(IN_C0X + k * 3 + j) + first);
+			}
+		}
+
+		// rotate the up and front axes by the offset angle
+		__m128 cs = _mm_loadu_ps(field(IN_COS) + first);
+		__m128 sn = _mm_loadu_ps(field(IN_SIN) + first);
+		for (int j = 0; j < 3; j++)
+		{
+			__m128 up    = _mm_add_ps(_mm_mul_ps(c[1][j], cs), _mm_mul_ps(c[2][j], sn));
+			__m128 front = _mm_sub_ps(_mm_mul_ps(c[2][j], cs), _mm_mul_ps(c[1][j], sn));
+			c[1][j] = up;
+			c[2][j] = _mm_sub_ps(zero, front); // front is -z
+		}
+
+		for (int j = 0; j < 3; j++)
+		{
+			_mm_storeu_ps(field(OUT_T + j) + first, t[j]);
+			__m128 tn = _mm_add_ps(n[9 + j], _mm_add_ps(_mm_mul_ps(n[j], t[0]),
+				_mm_add_ps(_mm_mul_ps(n[3 + j], t[1]), _mm_mul_ps(n[6 + j], t[2]))));
+			_mm_storeu_ps(field(OUT_TN + j) + first, tn);
+		}
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			__m128* v = c[axis];
+			__m128 length = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(v[0], v[0]),
+				_mm_add_ps(_mm_mul_ps(v[1], v[1]), _mm_mul_ps(v[2], v[2]))));
+			__m128 vn[3];
+			for (int j = 0; j < 3; j++)
+			{
+				_mm_storeu_ps(field(OUT_V + axis * 3 + j) + first, _mm_div_ps(v[j], length));
+				vn[j] = _mm_add_ps(_mm_mul_ps(n[j], v[0]),
+					_mm_add_ps(_mm_mul_ps(n[3 + j], v[1]), _mm_mul_ps(n[6 + j], v[2])));
+			}
+			__m128 lengthNav = _mm_sqrt_ps(_mm_add_ps(_mm_mul_ps(vn[0], vn[0]),
+				_mm_add_ps(_mm_mul_ps(vn[1], vn[1]), _mm_mul_ps(vn[2], vn[2]))));
+			for (int j = 0; j < 3; j++)
+			{
+				_mm_storeu_ps(field(OUT_VN + axis * 3 + j) + first, _mm_div_ps(vn[j], lengthNav));
+			}
+		}
+	}
+#endif // USE_SSE
+
+	TransformRange(first, m_Size, nav, positionScale);
+}
+
+void PoseBatch::TransformScalar(const glm::mat4& navInverse, float positionScale)
+{
+	float nav[12];
+	for (int column = 0; column < 4; column++)
+	{
+		for (int row = 0; row < 3; row++)
+		{
+			nav[column * 3 + row] = navInverse[column][row];
+		}
+	}
+	TransformRange(0, m_Size, nav, positionScale);
+}
+
+void PoseBatch::TransformRange(int first, int last, const float nav[12], float positionScale)
+{
+	for (int i = first; i < last; i++)
+	{
+		float c[3][3], t[3];
+		for (int k = 0; k < 3; k++)
+		{
+			t[k] = field(IN_TX + k)[i] * positionScale;
+			for (int j = 0; j < 3; j++)
+			{
+				c[k][j] = field(IN_C0X + k * 3 + j)[i];
+			}
+		}
+
+		float cs = field(IN_COS)[i];
+		float sn = field(IN_SIN)[i];
+		for (int j = 0; j < 3; j++)
+		{
+			float up    = c[1][j] * cs + c[2][j] * sn;
+			float front = c[2][j] * cs - c[1][j] * sn;
+			c[1][j] = up;
+			c[2][j] = -front;
+		}
+
+		for (int j = 0; j < 3; j++)
+		{
+			field(OUT_T + j)[i] = t[j];
+			field(OUT_TN + j)[i] = nav[9 + j] + nav[j] * t[0] + nav[3 + j] * t[1] + nav[6 + j] * t[2];
+		}
+
+		for (int axis = 0; axis < 3; axis++)
+		{
+			const float* v = c[axis];
+			float length = sqrtf(v[0] * v[0] + v[1] * v[1] + v[2] * v[2]);
+			float vn[3];
+			for (int j = 0; j < 3; j++)
+			{
+				field(OUT_V + axis * 3 + j)[i] = v[j] / length;
+				vn[j] = nav[j] * v[0] + nav[3 + j] * v[1] + nav[6 + j] * v[2];
+			}
+			float lengthNav = sqrtf(vn[0] * vn[0] + vn[1] * vn[1] + vn[2] * vn[2]);
+			for (int j = 0; j < 3; j++)
+			{
+				field(OUT_VN + axis * 3 + j)[i] = vn[j] / lengthNav;
+			}
+		}
+	}
+}
+
+glm::vec3 PoseBatch::Get(int f, int index) const
+{
+	return glm::vec3(field(f)[index], field(f + 1)[index], field(f + 2)[index]);
+}
+
+glm::vec3 PoseBatch::translation(int index) const
+{
+	return Get(OUT_T, index);
+}
+
+glm::vec3 PoseBatch::translationNav(int index) const
+{
+	return Get(OUT_TN, index);
+}
+
+glm::vec3 PoseBatch::vector(int index, AXIS axis) const
+{
+	return Get(OUT_V + axis * 3, index);
+}
+
+glm::vec3 PoseBatch::vectorNav(int index, AXIS axis) const
+{
+	return Get(OUT_VN + axis * 3, index);
+}
+
+glm::mat4 PoseBatch::AffineInverse(const glm::mat4& matrix)
+{
+	glm::mat3 inverse = glm::inverse(glm::mat3(matrix));
+	glm::vec3 translation = -(inverse * glm::vec3(matrix[3][0], matrix[3][1], matrix[3][2]));
+	glm::mat4 result(inverse);
+	result[3] = glm::vec4(translation, 1.0f);
+	return result;
+}
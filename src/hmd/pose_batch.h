@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// pose_batch.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../settings.h"
+
+#include <vector>
+
+#include <glm/vec3.hpp> // glm::vec3
+#include <glm/mat4x4.hpp> // glm::mat4
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// PoseBatch: converts the poses of all tracked devices to CAVE coordinates
+// in one pass.
+//
+//   The poses are stored as structure of arrays (one array per matrix
+//   element), so four devices are converted at once with SSE. For each
+//   device it gives the position and the right / up / front vectors, in
+//   CAVE coordinates and through the navigation inverse.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class PoseBatch {
+public:
+	enum AXIS { AXIS_RIGHT = 0, AXIS_UP, AXIS_FRONT };
+
+	explicit PoseBatch(int capacity);
+
+	int capacity() const { return m_Capacity; }
+	int size() const { return m_Size; }
+
+	// pose in tracking space; offsetAngle rotates about the device x axis
+	void Set(int index, const glm::mat4& pose, float offsetAngle);
+
+	// positions are multiplied by positionScale
+	void Transform(const glm::mat4& navInverse, float positionScale);
+	// the same without SSE, the reference for clcl_microbench
+	void TransformScalar(const glm::mat4& navInverse, float positionScale);
+
+	glm::vec3 translation(int index) const;
+	glm::vec3 translationNav(int index) const;
+	glm::vec3 vector(int index, AXIS axis) const;
+	glm::vec3 vectorNav(int index, AXIS axis) const;
+
+	// inverse of a matrix without projection (rotation, scale, translation)
+	static glm::mat4 AffineInverse(const glm::mat4& matrix);
+
+private:
+	enum FIELD {
+		// inputs: rotation columns, translation, cos / sin of the offset angle
+		IN_C0X, IN_C0Y, IN_C0Z, IN_C1X, IN_C1Y, IN_C1Z, IN_C2X, IN_C2Y, IN_C2Z,
+		IN_TX, IN_TY, IN_TZ, IN_COS, IN_SIN,
+		// outputs
+		OUT_T, OUT_TN = OUT_T + 3,
+		OUT_V = OUT_TN + 3,       // [axis][xyz]
+		OUT_VN = OUT_V + 9,
+		NUM_FIELDS = OUT_VN + 9
+	};
+
+	int   m_Capacity;
+	int   m_Stride;   // capacity rounded up to 4
+	int   m_Size;     // highest index set + 1
+	std::vector<float> m_Data;
+
+	float* field(int f) { return &m_Data[f * m_Stride]; }
+	const float* field(int f) const { return &m_Data[f * m_Stride]; }
+	glm::vec3 Get(int f, int index) const;
+	void TransformRange(int first, int last, const float nav[12], float positionScale);
+};
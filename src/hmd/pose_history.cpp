@@ -0,0 +1,118 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// pose_history.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "pose_history.h"
+
+PoseHistory::PoseHistory()
+{
+	for (int i = 0; i < CAPACITY; i++)
+	{
+		m_Slots[i].sequence.store(0, std::memory_order_relaxed);
+		m_Slots[i].index = 0;
+	}
+	m_Count.store(0, std::memory_order_relaxed);
+}
+
+void PoseHistory::Push(double time, const glm::mat4& pose)
+{
+	uint64_t index = m_Count.load(std::memory_order_relaxed);
+	Slot& slot = m_Slots[index & MASK];
+
+	uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+	slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+	std::atomic_thread_fence(std::memory_order_release);
+
+	slot.index = index;
+	slot.sample.time = time;
+	slot.sample.position = glm::vec3(pose[3][0], pose[3][1], pose[3][2]);
+	slot.sample.rotation = glm::quat_cast(pose);
+
+	slot.sequence.store(sequence + 2, std::memory_order_release);
+	m_Count.store(index + 1, std::memory_order_release);
+}
+
+bool PoseHistory::Read(uint64_t index, PoseSample& sample) const
+{
+	const Slot& slot = m_Slots[index & MASK];
+	for (;;)
+	{
+		uint32_t before = slot.sequence.load(std::memory_order_acquire);
+		if (before & 1) continue; // being written
+		uint64_t slotIndex = slot.index;
+		sample = slot.sample;
+		std::atomic_thread_fence(std::memory_order_acquire);
+		if (slot.sequence.load(std::memory_order_relaxed) != before) continue;
+
+		// false if the writer has already reused the slot
+		return slotIndex == index;
+	}
+}
+
+bool PoseHistory::Latest(PoseSample& sample) const
+{
+	uint64_t count = m_Count.load(std::memory_order_acquire);
+	if (count == 0) return false;
+	return Read(count - 1, sample);
+}
+
+bool PoseHistory::Sample(double time, PoseSample& sample) const
+{
+	uint64_t count = m_Count.load(std::memory_order_acquire);
+	if (count == 0) return false;
+
+	PoseSample newer;
+	if (!Read(count - 1, newer)) return false;
+	if (time >= newer.time)
+	{
+		sample = newer;
+		return true;
+	}
+
+	// walk back from the newest pose, most queries are close to it
+	uint64_t oldest = count > CAPACITY ? count - CAPACITY : 0;
+	for (uint64_t index = count - 1; index > oldest; index--)
+	{
+		PoseSample older;
+		if (!Read(index - 1, older)) break; // overwritten while walking
+
+		if (older.time <= time)
+		{
+			double interval = newer.time - older.time;
+			float t = interval > 0.0 ? static_cast<float>((time - older.time) / interval) : 0.0f;
+			sample.time = time;
+			sample.position = glm::mix(older.position, newer.position, t);
+			sample.rotation = glm::slerp(older.rotation, newer.rotation, t);
+			return true;
+		}
+		newer = older;
+	}
+
+	// before the recorded range
+	sample = newer;
+	return true;
+}
+
+bool PoseHistory::Sample(double time, glm::mat4& pose) const
+{
+	PoseSample sample;
+	if (!Sample(time, sample)) return false;
+	pose = ToMatrix(sample);
+	return true;
+}
+
+glm::mat4 PoseHistory::ToMatrix(const PoseSample& sample)
+{
+	glm::mat4 pose = glm::mat4_cast(sample.rotation);
+	pose[3] = glm::vec4(sample.position, 1.0f);
+	return pose;
+}
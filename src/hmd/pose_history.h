@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// pose_history.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+#include <glm/vec3.hpp> // glm::vec3
+#include <glm/mat4x4.hpp> // glm::mat4
+#include <glm/gtc/quaternion.hpp> // glm::quat, glm::slerp
+
+struct PoseSample
+{
+	double    time;     // seconds, HMD::GetTime()
+	glm::vec3 position; // tracking space, meters
+	glm::quat rotation;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// PoseHistory: the last CAPACITY timestamped poses of one tracked device.
+//
+//   One writer (the display thread) pushes the poses in time order; any
+//   number of readers can sample them without blocking it. Each slot has a
+//   sequence counter which is odd while the slot is being written, and a
+//   reader retries a slot if the counter changed while it was copied.
+//
+//   Sample() interpolates between the two poses around the requested time
+//   (lerp for the position, slerp for the rotation) and clamps to the oldest
+//   and newest pose outside the recorded range.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class PoseHistory {
+public:
+	static const int CAPACITY = 128; // power of 2, about 1.4 s at 90 Hz
+
+	PoseHistory();
+
+	// writer
+	void Push(double time, const glm::mat4& pose);
+
+	// readers, return false if there is no pose yet
+	bool Latest(PoseSample& sample) const;
+	bool Sample(double time, PoseSample& sample) const;
+	bool Sample(double time, glm::mat4& pose) const;
+
+	uint64_t count() const { return m_Count.load(std::memory_order_acquire); } // poses pushed so far
+
+	static glm::mat4 ToMatrix(const PoseSample& sample);
+
+private:
+	static const uint64_t MASK = CAPACITY - 1;
+
+	struct Slot
+	{
+		std::atomic<uint32_t> sequence;
+		uint64_t   index; // which push the slot holds
+		PoseSample sample;
+	};
+
+	Slot m_Slots[CAPACITY];
+	std::atomic<uint64_t> m_Count;
+
+	bool Read(uint64_t index, PoseSample& sample) const;
+};
@@ -0,0 +1,227 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// replay_hmd.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "replay_hmd.h"
+
+#include <cstdlib>
+#include <cstdio>
+#include <cstring>
+
+#include <glm/gtc/quaternion.hpp> // glm::mat4_cast
+
+const int REPLAY_HMD_ESCKEY = 256; // CAVE_ESCKEY
+
+ReplayHMD::ReplayHMD()
+{
+	m_Speed = 1.0;
+	m_IsFinished = false;
+	m_NumFrames = 0;
+	m_Time.store(0.0);
+	m_FirstTime = 0.0;
+	m_IsResolutionSet = getenv("CLCL_NULL_RESOLUTION") != nullptr;
+	m_IsNavigationReplayed = true;
+	m_HasNavigation = false;
+
+	const char* env;
+	if ((env = getenv("CLCL_REPLAY")) != nullptr)
+	{
+		m_Path = env;
+	}
+	if ((env = getenv("CLCL_REPLAY_SPEED")) != nullptr)
+	{
+		m_Speed = atof(env);
+	}
+	if ((env = getenv("CLCL_REPLAY_NAVIGATION")) != nullptr)
+	{
+		m_IsNavigationReplayed = atoi(env) != 0;
+	}
+}
+
+ReplayHMD::~ReplayHMD()
+{
+}
+
+void ReplayHMD::Init()
+{
+	if (!m_Reader.Open(m_Path))
+	{
+		exit(EXIT_FAILURE);
+	}
+
+	const SessionFileHeader& header = m_Reader.header();
+	if (header.deviceType >= HTC_VIVE && header.deviceType <= WINDOWS_MR)
+	{
+		m_DeviceType = static_cast<DEVICE_TYPE>(header.deviceType);
+	}
+	if (header.displayFrequency > 0.0f)
+	{
+		m_DisplayFrequency = header.displayFrequency;
+	}
+	if (!m_IsResolutionSet && header.renderWidth > 0 && header.renderHeight > 0)
+	{
+		m_FrameBufferWidth  = header.renderWidth;
+		m_FrameBufferHeight = header.renderHeight;
+	}
+
+	// the clock starts at the first recorded frame
+	if (m_Reader.ReadFrame(m_Frame))
+	{
+		m_Time.store(m_Frame.time);
+	}
+	m_Reader.Rewind();
+
+	fprintf(stderr, "HMD: replay %s (%d x %d", m_Path.c_str(), m_FrameBufferWidth, m_FrameBufferHeight);
+	if (m_Speed > 0.0)
+	{
+		fprintf(stderr, ", speed %g)\n", m_Speed);
+	}
+	else
+	{
+		fprintf(stderr, ", unpaced)\n");
+	}
+}
+
+void ReplayHMD::UpdateTrackingData()
+{
+	if (!m_IsFinished && m_Reader.ReadFrame(m_Frame))
+	{
+		if (m_NumFrames == 0)
+		{
+			m_FirstTime = m_Frame.time;
+			m_StartTime = std::chrono::steady_clock::now();
+		}
+		WaitForFrame(m_Frame.time);
+		m_NumFrames++;
+		ApplyFrame(m_Frame);
+		ApplyNavigation();
+		return;
+	}
+
+	// past the end: the last poses are kept and the clock runs on
+	if (!m_IsFinished)
+	{
+		m_IsFinished = true;
+		fprintf(stderr, "Replay: end of %s (%lld frames)\n", m_Path.c_str(), m_NumFrames);
+	}
+	double now = GetTime() + 1.0 / (m_DisplayFrequency > 0.0f ? m_DisplayFrequency : 90.0f);
+	WaitForFrame(now);
+	m_Time.store(now, std::memory_order_relaxed);
+	m_FrameIndex++;
+	PushInput(INPUT_KEY, REPLAY_HMD_ESCKEY, BUTTON_PRESS, now);
+
+	InputSnapshot snapshot = inputSnapshot();
+	snapshot.frameIndex = m_FrameIndex;
+	snapshot.time = now;
+	PublishInput(snapshot);
+	ApplyNavigation();
+}
+
+void ReplayHMD::ApplyFrame(const SessionFrame& frame)
+{
+	m_Time.store(frame.time, std::memory_order_relaxed);
+	m_FrameIndex = frame.frameIndex;
+
+	float handOffsetAngle = 0.0f;
+	if (m_DeviceType == OCULUS_RIFT_CV1)
+	{
+		handOffsetAngle = static_cast<float>(-30.0 / 180.0 * M_PI); // as OpenVR
+	}
+	for (size_t i = 0; i < frame.poses.size(); i++)
+	{
+		const PoseRecord& record = frame.poses[i];
+		glm::mat4 pose = glm::mat4_cast(glm::quat(
+			record.rotation[3], record.rotation[0], record.rotation[1], record.rotation[2]));
+		pose[3] = glm::vec4(record.position[0], record.position[1], record.position[2], 1.0f);
+
+		if (record.sensor == SENSOR_HEAD)
+		{
+			m_HeadPose = pose;
+			UpdateHeadPose();
+		}
+		else if (record.sensor == SENSOR_WAND)
+		{
+			m_HandPose = pose;
+			UpdateHandPose(handOffsetAngle);
+		}
+		else if (record.sensor > SENSOR_WAND && record.sensor < MAX_SENSORS)
+		{
+			UpdateSensorPose(record.sensor, pose, 0.0f);
+		}
+		RecordPose(record.sensor, record.time, pose);
+	}
+
+	// the controller button events follow from the controller state
+	for (size_t i = 0; i < frame.events.size(); i++)
+	{
+		const EventRecord& event = frame.events[i];
+		if (event.device == INPUT_CONTROLLER_BUTTON) continue;
+		PushInput(static_cast<INPUT_DEVICE>(event.device), event.code, event.action, event.time);
+	}
+
+	InputSnapshot snapshot = inputSnapshot();
+	snapshot.frameIndex = m_FrameIndex;
+	snapshot.time = frame.time;
+	if (frame.hasInput)
+	{
+		snapshot.buttons = frame.input.buttons;
+		snapshot.joystick[0] = frame.input.joystick[0];
+		snapshot.joystick[1] = frame.input.joystick[1];
+		snapshot.isConnected = frame.input.isConnected != 0;
+		snapshot.mapped = frame.input.mapped != 0 ? frame.input.mapped : 0x7; // buttons 1-3, as OpenVR
+	}
+	m_IsControllerConnected = snapshot.isConnected;
+	PublishInput(snapshot);
+
+	// recorded only when it changed
+	if (frame.hasNavigation)
+	{
+		for (int j = 0; j < 4; j++)
+		{
+			for (int i = 0; i < 4; i++)
+			{
+				m_RecordedNavigation.matrix[j][i] = frame.navigation.matrix[j * 4 + i];
+			}
+		}
+		m_RecordedNavigation.inverse = glm::inverse(m_RecordedNavigation.matrix);
+		m_RecordedNavigation.version = frame.navigation.version;
+		m_HasNavigation = true;
+	}
+}
+
+// replaces the navigation latched from the application for this frame;
+// called before the poses are transformed
+void ReplayHMD::ApplyNavigation()
+{
+	if (m_IsNavigationReplayed && m_HasNavigation)
+	{
+		m_LatchedNavigation = m_RecordedNavigation;
+	}
+}
+
+// paces the frames as recorded, scaled by CLCL_REPLAY_SPEED
+void ReplayHMD::WaitForFrame(double time)
+{
+	if (m_Speed <= 0.0) return;
+
+	std::chrono::duration<double> offset((time - m_FirstTime) / m_Speed);
+	std::this_thread::sleep_until(m_StartTime + std::chrono::duration_cast<std::chrono::steady_clock::duration>(offset));
+}
+
+bool ReplayHMD::GetKey(int key)
+{
+	if (key == REPLAY_HMD_ESCKEY)
+	{
+		return m_IsFinished;
+	}
+	return false;
+}
@@ -0,0 +1,75 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// replay_hmd.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../null/nullhmd.h"
+#include "../../record/session_reader.h"
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// ReplayHMD: headless backend driven by a session recorded with CLCL_RECORD.
+//
+//   Rendering is the same as NullHMD. Each display frame applies one
+//   recorded frame: the poses of the tracked devices, the controller state
+//   and the key / mouse events, with the recorded frame number. GetTime()
+//   returns the recorded time of the frame, so CAVEGetTime(),
+//   CAVEGetPosition(), CAVEGetVector(), CAVEgetbutton() and
+//   CAVEGetFrameNumber() give the same values as in the recorded session.
+//   After the last frame CAVE_ESCKEY is reported.
+//
+//   The recorded navigation matrix replaces the one the application
+//   publishes, so the rendered views and the *_NAV vectors do not depend on
+//   how often the application loop ran. With CLCL_REPLAY_NAVIGATION=0 the
+//   application's own navigation is used instead.
+//
+//   Environment variables:
+//     CLCL_REPLAY            : the session file
+//     CLCL_REPLAY_SPEED      : 1 replays in real time (default), 2 twice as
+//                              fast, 0 as fast as possible
+//     CLCL_REPLAY_NAVIGATION : 1 replays the navigation (default), 0 not
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class ReplayHMD : public NullHMD {
+public:
+	ReplayHMD();
+	~ReplayHMD();
+
+	const char* name() const { return "replay"; }
+	void Init();
+	void UpdateTrackingData();
+	double GetTime() { return m_Time.load(std::memory_order_relaxed); }
+	bool PredictPoses(float secondsFromNow, glm::mat4* headPose, glm::mat4* handPose) { return false; }
+
+	bool GetKey(int key);
+
+private:
+	std::string   m_Path;
+	double        m_Speed;
+	SessionReader m_Reader;
+	SessionFrame  m_Frame;
+	bool          m_IsFinished;
+	llong         m_NumFrames;
+	std::atomic<double> m_Time;
+	double        m_FirstTime;
+	std::chrono::steady_clock::time_point m_StartTime;
+	bool          m_IsResolutionSet; // CLCL_NULL_RESOLUTION overrides the recorded size
+	bool          m_IsNavigationReplayed;
+	bool          m_HasNavigation;
+	NavigationState m_RecordedNavigation; // of the current frame
+
+	void WaitForFrame(double time);
+	void ApplyFrame(const SessionFrame& frame);
+	void ApplyNavigation();
+};
@@ -0,0 +1,136 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// session_format.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <cstdint>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Session recording file (CLCL_RECORD)
+//
+//   file   : SessionFileHeader, chunks, index
+//   chunk  : ChunkHeader, then the records of whole frames
+//   record : RecordHeader, then its payload; the records of a frame are
+//            followed by its RECORD_FRAME
+//   index  : IndexEntry for each chunk, then IndexFooter at the end of the
+//            file
+//
+//   The file is append-only. The index is written when the recording is
+//   closed; without it (e.g. after a crash) the chunks can still be found
+//   by following their headers. Values are little-endian.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+const char     SESSION_MAGIC[8] = { 'C', 'L', 'C', 'L', 'R', 'E', 'C', '1' };
+const char     SESSION_INDEX_MAGIC[8] = { 'C', 'L', 'C', 'L', 'I', 'D', 'X', '1' };
+const uint32_t SESSION_VERSION = 1;
+const uint32_t SESSION_CHUNK_MAGIC = 0x4B4E4843; // "CHNK"
+
+typedef enum {
+	RECORD_FRAME = 1,
+	RECORD_POSE,
+	RECORD_INPUT,
+	RECORD_EVENT,
+	RECORD_NAVIGATION
+} RECORD_TYPE;
+
+#pragma pack(push, 1)
+
+struct SessionFileHeader
+{
+	char     magic[8];
+	uint32_t version;
+	int32_t  deviceType;       // DEVICE_TYPE
+	float    displayFrequency; // Hz
+	uint32_t renderWidth;
+	uint32_t renderHeight;
+	uint32_t reserved;
+};
+
+struct ChunkHeader
+{
+	uint32_t magic;
+	uint32_t size;       // bytes of records after this header
+	int64_t  firstFrame;
+	int64_t  lastFrame;
+	double   firstTime;
+	uint32_t numRecords;
+	uint32_t reserved;
+};
+
+struct RecordHeader
+{
+	uint8_t  type; // RECORD_TYPE
+	uint8_t  reserved;
+	uint16_t size; // bytes of the payload
+};
+
+struct FrameRecord
+{
+	int64_t frameIndex;
+	double  time; // HMD::GetTime() after the tracking update
+};
+
+// the pose of a tracked device in tracking space
+struct PoseRecord
+{
+	double  time;
+	int32_t sensor;      // SENSOR_INDEX
+	float   position[3]; // meters
+	float   rotation[4]; // quaternion x, y, z, w
+};
+
+// InputSnapshot without the edges, which follow from the previous frame
+struct InputRecord
+{
+	uint32_t buttons;
+	float    joystick[2];
+	uint8_t  isConnected;
+	uint8_t  mapped;      // InputSnapshot::mapped; 0 in older recordings
+	uint8_t  reserved[2];
+};
+
+// InputEvent
+struct EventRecord
+{
+	double  time;
+	int64_t frameIndex;
+	int16_t device;
+	int16_t code;
+	int16_t action;
+	int16_t reserved;
+};
+
+// the navigation matrix latched for the frame, when it has changed
+struct NavigationRecord
+{
+	int64_t version;
+	float   matrix[16]; // column-major
+};
+
+struct IndexEntry
+{
+	int64_t  firstFrame;
+	double   firstTime;
+	uint64_t offset; // of the ChunkHeader
+};
+
+struct IndexFooter
+{
+	uint64_t indexOffset;
+	uint64_t numEntries;
+	char     magic[8];
+};
+
+#pragma pack(pop)
@@ -0,0 +1,243 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// session_reader.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "session_reader.h"
+
+#include <cstdio>
+#include <cstring>
+
+// 64-bit file offsets; long is 32 bits on Windows
+static bool Seek(FILE* fp, uint64_t offset)
+{
+#ifdef _WIN32
+	return _fseeki64(fp, static_cast<__int64>(offset), SEEK_SET) == 0;
+#else
+	return fseeko(fp, static_cast<off_t>(offset), SEEK_SET) == 0;
+#endif // _WIN32
+}
+
+static uint64_t FileSize(FILE* fp)
+{
+#ifdef _WIN32
+	if (_fseeki64(fp, 0, SEEK_END) != 0) return 0;
+	__int64 size = _ftelli64(fp);
+#else
+	if (fseeko(fp, 0, SEEK_END) != 0) return 0;
+	off_t size = ftello(fp);
+#endif // _WIN32
+	return size > 0 ? static_cast<uint64_t>(size) : 0;
+}
+
+static bool ReadAt(FILE* fp, uint64_t offset, void* data, size_t size)
+{
+	return Seek(fp, offset) && fread(data, 1, size, fp) == size;
+}
+
+SessionReader::SessionReader()
+{
+	p_File = nullptr;
+	memset(&m_Header, 0, sizeof(m_Header));
+	m_ChunksEnd = 0;
+	Rewind();
+}
+
+SessionReader::~SessionReader()
+{
+	Close();
+}
+
+bool SessionReader::Open(const std::string& path)
+{
+	Close();
+
+	p_File = fopen(path.c_str(), "rb");
+	if (p_File == nullptr)
+	{
+		fprintf(stderr, "ERROR: cannot open %s\n", path.c_str());
+		return false;
+	}
+	uint64_t size = FileSize(p_File);
+	if (size <= sizeof(m_Header) || !ReadAt(p_File, 0, &m_Header, sizeof(m_Header)))
+	{
+		fprintf(stderr, "ERROR: cannot read %s\n", path.c_str());
+		Close();
+		return false;
+	}
+	if (memcmp(m_Header.magic, SESSION_MAGIC, sizeof(m_Header.magic)) != 0 ||
+		m_Header.version != SESSION_VERSION)
+	{
+		fprintf(stderr, "ERROR: %s is not a CLCL session (version %u)\n", path.c_str(), SESSION_VERSION);
+		Close();
+		return false;
+	}
+
+	m_ChunksEnd = size;
+	IndexFooter footer;
+	if (size >= sizeof(m_Header) + sizeof(footer) &&
+		ReadAt(p_File, size - sizeof(footer), &footer, sizeof(footer)) &&
+		memcmp(footer.magic, SESSION_INDEX_MAGIC, sizeof(footer.magic)) == 0 &&
+		footer.indexOffset >= sizeof(m_Header) &&
+		footer.numEntries <= size / sizeof(IndexEntry) &&
+		footer.indexOffset + footer.numEntries * sizeof(IndexEntry) + sizeof(footer) == size)
+	{
+		m_Index.resize(static_cast<size_t>(footer.numEntries));
+		if (m_Index.empty() ||
+			ReadAt(p_File, footer.indexOffset, &m_Index[0], m_Index.size() * sizeof(IndexEntry)))
+		{
+			m_ChunksEnd = footer.indexOffset;
+		}
+		else
+		{
+			m_Index.clear();
+		}
+	}
+	if (m_Index.empty())
+	{
+		fprintf(stderr, "WARNING: %s has no index; reading up to the last complete chunk\n", path.c_str());
+	}
+
+	Rewind();
+	return true;
+}
+
+void SessionReader::Close()
+{
+	if (p_File != nullptr)
+	{
+		fclose(p_File);
+		p_File = nullptr;
+	}
+	m_Index.clear();
+	m_Chunk.clear();
+	m_Chunk.shrink_to_fit();
+	m_ChunksEnd = 0;
+	Rewind();
+}
+
+void SessionReader::Rewind()
+{
+	m_NextEntry = 0;
+	m_NextChunk = sizeof(m_Header);
+	m_Offset = 0;
+	m_ChunkEnd = 0;
+}
+
+bool SessionReader::NextChunk()
+{
+	if (!m_Index.empty())
+	{
+		// the index lists complete chunks; a damaged one is skipped
+		while (m_NextEntry < m_Index.size())
+		{
+			if (ReadChunk(m_Index[m_NextEntry++].offset)) return true;
+		}
+		return false;
+	}
+
+	if (!ReadChunk(m_NextChunk))
+	{
+		// the rest was not written completely
+		m_NextChunk = m_ChunksEnd;
+		return false;
+	}
+	m_NextChunk += sizeof(ChunkHeader) + m_ChunkEnd;
+	return true;
+}
+
+bool SessionReader::ReadChunk(uint64_t offset)
+{
+	m_Offset = 0;
+	m_ChunkEnd = 0;
+	if (offset < sizeof(m_Header) || offset + sizeof(ChunkHeader) > m_ChunksEnd) return false;
+
+	ChunkHeader header;
+	if (!ReadAt(p_File, offset, &header, sizeof(header))) return false;
+	if (header.magic != SESSION_CHUNK_MAGIC || offset + sizeof(header) + header.size > m_ChunksEnd) return false;
+
+	if (m_Chunk.size() < header.size)
+	{
+		m_Chunk.resize(header.size);
+	}
+	if (header.size > 0 && fread(&m_Chunk[0], 1, header.size, p_File) != header.size) return false;
+	m_ChunkEnd = header.size;
+	return true;
+}
+
+bool SessionReader::ReadFrame(SessionFrame& frame)
+{
+	frame.poses.clear();
+	frame.events.clear();
+	frame.hasInput = false;
+	frame.hasNavigation = false;
+
+	for (;;)
+	{
+		if (m_Offset + sizeof(RecordHeader) > m_ChunkEnd)
+		{
+			// a chunk holds whole frames: the records read so far are dropped
+			frame.poses.clear();
+			frame.events.clear();
+			frame.hasInput = false;
+			frame.hasNavigation = false;
+			if (!NextChunk()) return false;
+			continue;
+		}
+
+		RecordHeader record;
+		memcpy(&record, &m_Chunk[m_Offset], sizeof(record));
+		m_Offset += sizeof(record);
+		if (m_Offset + record.size > m_ChunkEnd)
+		{
+			m_Offset = m_ChunkEnd; // broken chunk
+			continue;
+		}
+
+		switch (record.type)
+		{
+			case RECORD_FRAME:
+			{
+				FrameRecord payload;
+				ReadPayload(record.size, payload);
+				m_Offset += record.size;
+				frame.frameIndex = payload.frameIndex;
+				frame.time = payload.time;
+				return true;
+			}
+			case RECORD_POSE:
+			{
+				PoseRecord payload;
+				ReadPayload(record.size, payload);
+				frame.poses.push_back(payload);
+				break;
+			}
+			case RECORD_INPUT:
+				ReadPayload(record.size, frame.input);
+				frame.hasInput = true;
+				break;
+			case RECORD_EVENT:
+			{
+				EventRecord payload;
+				ReadPayload(record.size, payload);
+				frame.events.push_back(payload);
+				break;
+			}
+			case RECORD_NAVIGATION:
+				ReadPayload(record.size, frame.navigation);
+				frame.hasNavigation = true;
+				break;
+			default:
+				break; // unknown records are skipped
+		}
+		m_Offset += record.size;
+	}
+}
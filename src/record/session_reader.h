@@ -0,0 +1,88 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// session_reader.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../settings.h"
+#include "session_format.h"
+
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+
+// the records of one frame of a session file
+struct SessionFrame
+{
+	llong  frameIndex;
+	double time;
+	std::vector<PoseRecord>  poses;
+	std::vector<EventRecord> events;
+	bool   hasInput;
+	InputRecord input;
+	bool   hasNavigation;
+	NavigationRecord navigation;
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// SessionReader: reads the frames of a file written by SessionRecorder.
+//
+//   Open() reads the header and the index; the chunks are then read one at
+//   a time, seeking to them through the index, so a session of any length
+//   (64-bit offsets, also on Windows) needs the memory of one chunk. A file
+//   without the index (e.g. the recording process crashed) is read by
+//   following the chunk headers up to its last complete chunk.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class SessionReader {
+public:
+	SessionReader();
+	~SessionReader();
+
+	bool Open(const std::string& path);
+	void Close();
+	bool IsOpen() const { return p_File != nullptr; }
+
+	const SessionFileHeader& header() const { return m_Header; }
+	size_t numChunks() const { return m_Index.size(); } // 0 if the index is missing
+
+	// the next frame; false at the end of the session. The vectors of
+	// "frame" are reused, so reading does not allocate once they are grown.
+	bool ReadFrame(SessionFrame& frame);
+	void Rewind();
+
+private:
+	FILE*    p_File;
+	SessionFileHeader m_Header;
+	std::vector<IndexEntry> m_Index;
+	uint64_t m_ChunksEnd;  // offset of the index, or the file size
+	size_t   m_NextEntry;  // of m_Index, if there is one
+	uint64_t m_NextChunk;  // offset of the next ChunkHeader otherwise
+
+	std::vector<unsigned char> m_Chunk; // records of the current chunk
+	size_t   m_Offset;     // of the next record in m_Chunk
+	size_t   m_ChunkEnd;
+
+	bool NextChunk();
+	bool ReadChunk(uint64_t offset); // false if it is not complete
+	template <class T>
+	void ReadPayload(size_t size, T& payload)
+	{
+		// older or newer records may differ in size: copy what both have
+		memset(&payload, 0, sizeof(payload));
+		memcpy(&payload, &m_Chunk[m_Offset], size < sizeof(payload) ? size : sizeof(payload));
+	}
+};
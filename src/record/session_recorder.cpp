@@ -0,0 +1,281 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// session_recorder.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "session_recorder.h"
+
+#include <chrono>
+#include <cstring>
+
+#include <glm/gtc/quaternion.hpp> // glm::quat_cast
+
+SessionRecorder::SessionRecorder()
+{
+	m_IsOpen = false;
+	p_Current = nullptr;
+	m_NumChunks = 0;
+	p_FullChunks = nullptr;
+	p_FreeChunks = nullptr;
+	m_DroppedChunks.store(0);
+	m_File = nullptr;
+	m_Offset = 0;
+	m_IsThreadRunning.store(false);
+}
+
+SessionRecorder::~SessionRecorder()
+{
+	Close();
+}
+
+bool SessionRecorder::Open(const std::string& path, const SessionFileHeader& header)
+{
+	if (m_IsOpen) return false;
+
+	m_File = fopen(path.c_str(), "wb");
+	if (m_File == nullptr)
+	{
+		fprintf(stderr, "ERROR: cannot open %s\n", path.c_str());
+		return false;
+	}
+	m_Path = path;
+	fwrite(&header, sizeof(header), 1, m_File);
+	m_Offset = sizeof(header);
+	m_Index.clear();
+
+	p_FullChunks = new SPSCRing<Chunk*>(MAX_CHUNKS);
+	p_FreeChunks = new SPSCRing<Chunk*>(MAX_CHUNKS);
+	for (int i = 0; i < 4; i++)
+	{
+		p_FreeChunks->Push(NewChunk());
+	}
+	p_FreeChunks->Pop(p_Current);
+
+	m_IsOpen = true;
+	m_IsThreadRunning.store(true);
+	m_Thread = std::thread(&SessionRecorder::WriterThread, this);
+
+	fprintf(stderr, "Record: %s\n", path.c_str());
+	return true;
+}
+
+void SessionRecorder::Close()
+{
+	if (!m_IsOpen) return;
+
+	Flush();
+	m_IsThreadRunning.store(false);
+	if (m_Thread.joinable())
+	{
+		m_Thread.join();
+	}
+
+	IndexFooter footer;
+	footer.indexOffset = m_Offset;
+	footer.numEntries = m_Index.size();
+	memcpy(footer.magic, SESSION_INDEX_MAGIC, sizeof(footer.magic));
+	if (!m_Index.empty())
+	{
+		fwrite(&m_Index[0], sizeof(IndexEntry), m_Index.size(), m_File);
+	}
+	fwrite(&footer, sizeof(footer), 1, m_File);
+	fclose(m_File);
+	m_File = nullptr;
+
+	fprintf(stderr, "Record: wrote %s (%zu chunks, %llu dropped)\n", m_Path.c_str(),
+		m_Index.size(), static_cast<unsigned long long>(droppedChunks()));
+
+	Chunk* chunk;
+	while (p_FreeChunks->Pop(chunk))
+	{
+		delete chunk;
+	}
+	delete p_Current;
+	p_Current = nullptr;
+	delete p_FullChunks;
+	delete p_FreeChunks;
+	p_FullChunks = p_FreeChunks = nullptr;
+	m_NumChunks = 0;
+	m_IsOpen = false;
+}
+
+void SessionRecorder::RecordPose(int sensor, double time, const glm::mat4& pose)
+{
+	if (!m_IsOpen) return;
+
+	PoseRecord record;
+	glm::quat rotation = glm::quat_cast(pose);
+	record.time = time;
+	record.sensor = sensor;
+	record.position[0] = pose[3][0];
+	record.position[1] = pose[3][1];
+	record.position[2] = pose[3][2];
+	record.rotation[0] = rotation.x;
+	record.rotation[1] = rotation.y;
+	record.rotation[2] = rotation.z;
+	record.rotation[3] = rotation.w;
+	Append(RECORD_POSE, &record, sizeof(record));
+}
+
+void SessionRecorder::RecordInput(const InputSnapshot& snapshot)
+{
+	if (!m_IsOpen) return;
+
+	InputRecord record;
+	memset(&record, 0, sizeof(record));
+	record.buttons = snapshot.buttons;
+	record.joystick[0] = snapshot.joystick[0];
+	record.joystick[1] = snapshot.joystick[1];
+	record.isConnected = snapshot.isConnected ? 1 : 0;
+	record.mapped = static_cast<uint8_t>(snapshot.mapped);
+	Append(RECORD_INPUT, &record, sizeof(record));
+}
+
+void SessionRecorder::RecordEvent(const InputEvent& event)
+{
+	if (!m_IsOpen) return;
+
+	EventRecord record;
+	record.time = event.time;
+	record.frameIndex = event.frameIndex;
+	record.device = static_cast<int16_t>(event.device);
+	record.code = static_cast<int16_t>(event.code);
+	record.action = static_cast<int16_t>(event.action);
+	record.reserved = 0;
+	Append(RECORD_EVENT, &record, sizeof(record));
+}
+
+void SessionRecorder::RecordNavigation(llong version, const glm::mat4& matrix)
+{
+	if (!m_IsOpen) return;
+
+	NavigationRecord record;
+	record.version = version;
+	for (int j = 0; j < 4; j++)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			record.matrix[j * 4 + i] = matrix[j][i];
+		}
+	}
+	Append(RECORD_NAVIGATION, &record, sizeof(record));
+}
+
+void SessionRecorder::EndFrame(llong frameIndex, double time)
+{
+	if (!m_IsOpen) return;
+
+	FrameRecord record;
+	record.frameIndex = frameIndex;
+	record.time = time;
+
+	ChunkHeader& header = p_Current->header;
+	if (header.firstFrame < 0)
+	{
+		header.firstFrame = frameIndex;
+		header.firstTime = time;
+	}
+	header.lastFrame = frameIndex;
+	Append(RECORD_FRAME, &record, sizeof(record));
+
+	if (p_Current->data.size() >= CHUNK_SIZE)
+	{
+		Flush();
+	}
+}
+
+void SessionRecorder::Append(RECORD_TYPE type, const void* payload, size_t size)
+{
+	RecordHeader record;
+	record.type = static_cast<uint8_t>(type);
+	record.reserved = 0;
+	record.size = static_cast<uint16_t>(size);
+
+	std::vector<unsigned char>& data = p_Current->data;
+	size_t offset = data.size();
+	data.resize(offset + sizeof(record) + size); // within the reserved size
+	memcpy(&data[offset], &record, sizeof(record));
+	memcpy(&data[offset + sizeof(record)], payload, size);
+	p_Current->header.numRecords++;
+}
+
+// hands the current chunk to the writer and takes an empty one
+void SessionRecorder::Flush()
+{
+	if (p_Current->data.empty()) return;
+
+	Chunk* next = nullptr;
+	if (!p_FreeChunks->Pop(next) && m_NumChunks < MAX_CHUNKS)
+	{
+		next = NewChunk();
+	}
+	if (next == nullptr)
+	{
+		// the writer is MAX_CHUNKS behind: lose this chunk rather than wait
+		m_DroppedChunks.fetch_add(1, std::memory_order_relaxed);
+		Reset(p_Current);
+		return;
+	}
+
+	p_Current->header.size = static_cast<uint32_t>(p_Current->data.size());
+	p_FullChunks->Push(p_Current); // never full: it holds at most every chunk
+	p_Current = next;
+}
+
+void SessionRecorder::Reset(Chunk* chunk)
+{
+	chunk->data.clear();
+	chunk->header.numRecords = 0;
+	chunk->header.firstFrame = -1;
+}
+
+SessionRecorder::Chunk* SessionRecorder::NewChunk()
+{
+	Chunk* chunk = new Chunk;
+	memset(&chunk->header, 0, sizeof(chunk->header));
+	chunk->header.magic = SESSION_CHUNK_MAGIC;
+	Reset(chunk);
+	chunk->data.reserve(CHUNK_SIZE * 2);
+	m_NumChunks++;
+	return chunk;
+}
+
+void SessionRecorder::WriterThread()
+{
+	for (;;)
+	{
+		bool isRunning = m_IsThreadRunning.load();
+		Chunk* chunk;
+		if (p_FullChunks->Pop(chunk))
+		{
+			WriteChunk(chunk);
+			Reset(chunk);
+			p_FreeChunks->Push(chunk);
+			continue;
+		}
+		if (!isRunning) break; // stopped, and everything before was written
+		std::this_thread::sleep_for(std::chrono::milliseconds(10));
+	}
+	fflush(m_File);
+}
+
+void SessionRecorder::WriteChunk(Chunk* chunk)
+{
+	IndexEntry entry;
+	entry.firstFrame = chunk->header.firstFrame;
+	entry.firstTime = chunk->header.firstTime;
+	entry.offset = m_Offset;
+	m_Index.push_back(entry);
+
+	fwrite(&chunk->header, sizeof(chunk->header), 1, m_File);
+	fwrite(&chunk->data[0], 1, chunk->data.size(), m_File);
+	m_Offset += sizeof(chunk->header) + chunk->data.size();
+}
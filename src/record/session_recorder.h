@@ -0,0 +1,92 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// session_recorder.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../settings.h"
+#include "../sync/spsc_ring.h"
+#include "../hmd/input_queue.h"
+#include "session_format.h"
+
+#include <atomic>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <glm/mat4x4.hpp> // glm::mat4
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// SessionRecorder: records the tracking, input and navigation of every
+// frame to a file (see session_format.h).
+//
+//   Enabled by the environment variable CLCL_RECORD, which names the file.
+//   The display thread appends the records of a frame to a chunk in memory;
+//   a full chunk goes through a lock-free ring to a writer thread, and the
+//   empty buffers come back through another ring, so the display thread
+//   never waits for the disk and does not allocate once enough buffers are
+//   in use. If the writer falls too far behind, chunks are dropped and
+//   counted rather than blocking the frame loop.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class SessionRecorder {
+public:
+	SessionRecorder();
+	~SessionRecorder();
+
+	bool Open(const std::string& path, const SessionFileHeader& header);
+	void Close(); // writes the rest and the index
+	bool IsOpen() const { return m_IsOpen; }
+
+	// display thread
+	void RecordPose(int sensor, double time, const glm::mat4& pose);
+	void RecordInput(const InputSnapshot& snapshot);
+	void RecordEvent(const InputEvent& event);
+	void RecordNavigation(llong version, const glm::mat4& matrix);
+	void EndFrame(llong frameIndex, double time);
+
+	uint64_t droppedChunks() const { return m_DroppedChunks.load(std::memory_order_relaxed); }
+
+private:
+	static const size_t CHUNK_SIZE = 64 * 1024; // a chunk is closed after the frame that fills it
+	static const int    MAX_CHUNKS = 64;
+
+	struct Chunk
+	{
+		ChunkHeader header;
+		std::vector<unsigned char> data;
+	};
+
+	bool   m_IsOpen;
+	Chunk* p_Current;
+	int    m_NumChunks;
+	SPSCRing<Chunk*>* p_FullChunks;  // display thread -> writer
+	SPSCRing<Chunk*>* p_FreeChunks;  // writer -> display thread
+	std::atomic<uint64_t> m_DroppedChunks;
+
+	std::string m_Path;
+	FILE*  m_File;
+	uint64_t m_Offset;
+	std::vector<IndexEntry> m_Index; // writer thread
+	std::thread m_Thread;
+	std::atomic<bool> m_IsThreadRunning;
+
+	void   Append(RECORD_TYPE type, const void* payload, size_t size);
+	void   Flush();
+	Chunk* NewChunk();
+	static void Reset(Chunk* chunk);
+	void   WriterThread();
+	void   WriteChunk(Chunk* chunk);
+};
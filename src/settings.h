@@ -18,6 +18,44 @@ typedef unsigned long ulong;
 typedef unsigned char uchar;
 typedef long long     llong;
 
+////////////////////////////////////////////////////////////////////////////////
+//
+// Entries for HMD backends
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// If you use OpenVR (SteamVR), enable USE_OPENVR.
+// The headless null HMD is always available. It is used when USE_OPENVR is
+// disabled, or when the environment variable CLCL_HMD is set to "null".
+//
+#ifdef _WIN32
+#define USE_OPENVR
+#endif // _WIN32
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Entries for SIMD
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// USE_SSE enables the SSE2 paths of the pose and navigation batches.
+// It is set for x64 and for x86 builds with /arch:SSE2 or later.
+//
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define USE_SSE
+#endif
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// Entries for benchmarking
+//
+////////////////////////////////////////////////////////////////////////////////
+//
+// COUNT_ALLOCATIONS replaces the global operator new/delete with counting
+// versions, so that CLCL_BENCH reports the allocations per frame.
+//
+//#define COUNT_ALLOCATIONS
+
 ////////////////////////////////////////////////////////////////////////////////
 //
 // Entries for OVRVision / OVRVision Pro
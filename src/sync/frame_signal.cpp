@@ -0,0 +1,57 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// frame_signal.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "frame_signal.h"
+
+#include <chrono>
+
+FrameSignal::FrameSignal()
+{
+	m_Count = 0;
+	m_IsStopped = false;
+}
+
+void FrameSignal::Notify()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_Count++;
+	}
+	m_Condition.notify_all();
+}
+
+void FrameSignal::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_Mutex);
+		m_IsStopped = true;
+	}
+	m_Condition.notify_all();
+}
+
+llong FrameSignal::Wait(llong& seen, double timeoutSeconds)
+{
+	std::unique_lock<std::mutex> lock(m_Mutex);
+	m_Condition.wait_for(lock, std::chrono::duration<double>(timeoutSeconds),
+		[&]() { return m_Count != seen || m_IsStopped; });
+
+	llong frames = m_Count - seen;
+	seen = m_Count;
+	return frames;
+}
+
+llong FrameSignal::count()
+{
+	std::lock_guard<std::mutex> lock(m_Mutex);
+	return m_Count;
+}
@@ -0,0 +1,53 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// frame_signal.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../settings.h"
+
+#include <condition_variable>
+#include <mutex>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// FrameSignal: wakes the threads waiting for the next display frame.
+//
+//   The display thread calls Notify() once per frame, after the poses of the
+//   frame are published. Wait() blocks on a condition variable until a frame
+//   newer than the one the caller has seen is notified, so the application
+//   thread runs right after each pose update instead of polling with a
+//   sleep. Stop() releases the waiters when the display thread ends.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class FrameSignal {
+public:
+	FrameSignal();
+
+	// display thread
+	void Notify();
+	void Stop();
+
+	// other threads; "seen" is the count of the caller's previous Wait().
+	// Returns the number of frames notified since then, 0 on timeout or
+	// after Stop().
+	llong Wait(llong& seen, double timeoutSeconds);
+
+	llong count();
+
+private:
+	std::mutex m_Mutex;
+	std::condition_variable m_Condition;
+	llong m_Count;
+	bool  m_IsStopped;
+};
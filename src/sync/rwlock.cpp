@@ -0,0 +1,148 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// rwlock.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "rwlock.h"
+
+#include <thread>
+#ifdef _WIN32
+#include <intrin.h>
+#elif defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+static inline void CPUPause()
+{
+#if defined(_WIN32) || defined(__i386__) || defined(__x86_64__)
+	_mm_pause();
+#endif
+}
+
+RWSpinLock::RWSpinLock()
+{
+	m_State.store(0);
+	m_WriteStart = 0;
+	ResetStats();
+}
+
+void RWSpinLock::Backoff(int& count)
+{
+	if (count < 64)
+	{
+		for (int i = 0; i < (1 << (count >> 3)); i++)
+		{
+			CPUPause();
+		}
+	}
+	else if (count < 128)
+	{
+		std::this_thread::yield();
+	}
+	else
+	{
+		std::this_thread::sleep_for(std::chrono::microseconds(50));
+	}
+	count++;
+}
+
+void RWSpinLock::LockReadSlow()
+{
+	// the reader count was already raised by LockRead(), back out and wait
+	// for the writer to leave before trying again
+	uint64_t start = Now();
+	int count = 0;
+	for (;;)
+	{
+		m_State.fetch_sub(READER, std::memory_order_relaxed);
+		while (m_State.load(std::memory_order_relaxed) & WRITER)
+		{
+			Backoff(count);
+		}
+		if (!(m_State.fetch_add(READER, std::memory_order_acquire) & WRITER)) break;
+	}
+	m_ReadContended.fetch_add(1, std::memory_order_relaxed);
+	m_ReadWaitNS.fetch_add(Now() - start, std::memory_order_relaxed);
+	if ((m_ReadLocks.fetch_add(1, std::memory_order_relaxed) & (READ_SAMPLE_INTERVAL - 1)) == 0)
+	{
+		BeginReadSample();
+	}
+}
+
+void RWSpinLock::BeginReadSample()
+{
+	ReadSample& sample = readSample();
+	if (sample.lock != nullptr) return; // another read hold of this thread is timed
+	sample.lock = this;
+	sample.start = Now();
+}
+
+void RWSpinLock::EndReadSample()
+{
+	ReadSample& sample = readSample();
+	uint64_t hold = Now() - sample.start;
+	sample.lock = nullptr;
+
+	m_ReadHoldSamples.fetch_add(1, std::memory_order_relaxed);
+	m_ReadHoldNS.fetch_add(hold, std::memory_order_relaxed);
+	uint64_t max = m_MaxReadHoldNS.load(std::memory_order_relaxed);
+	while (hold > max && !m_MaxReadHoldNS.compare_exchange_weak(max, hold, std::memory_order_relaxed))
+	{
+	}
+}
+
+void RWSpinLock::LockWriteSlow()
+{
+	uint64_t start = Now();
+	int count = 0;
+	for (;;)
+	{
+		uint32_t expected = 0;
+		if (m_State.load(std::memory_order_relaxed) == 0 &&
+			m_State.compare_exchange_weak(expected, WRITER, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			break;
+		}
+		Backoff(count);
+	}
+	m_WriteContended.fetch_add(1, std::memory_order_relaxed);
+	m_WriteWaitNS.fetch_add(Now() - start, std::memory_order_relaxed);
+}
+
+void RWSpinLock::GetStats(RWLockStats* stats) const
+{
+	stats->readLocks      = m_ReadLocks.load(std::memory_order_relaxed);
+	stats->writeLocks     = m_WriteLocks.load(std::memory_order_relaxed);
+	stats->readContended  = m_ReadContended.load(std::memory_order_relaxed);
+	stats->writeContended = m_WriteContended.load(std::memory_order_relaxed);
+	stats->readWaitNS     = m_ReadWaitNS.load(std::memory_order_relaxed);
+	stats->writeWaitNS    = m_WriteWaitNS.load(std::memory_order_relaxed);
+	stats->writeHoldNS    = m_WriteHoldNS.load(std::memory_order_relaxed);
+	stats->maxWriteHoldNS = m_MaxWriteHoldNS.load(std::memory_order_relaxed);
+	stats->readHoldSamples = m_ReadHoldSamples.load(std::memory_order_relaxed);
+	stats->readHoldNS     = m_ReadHoldNS.load(std::memory_order_relaxed);
+	stats->maxReadHoldNS  = m_MaxReadHoldNS.load(std::memory_order_relaxed);
+}
+
+void RWSpinLock::ResetStats()
+{
+	m_ReadLocks.store(0, std::memory_order_relaxed);
+	m_WriteLocks.store(0, std::memory_order_relaxed);
+	m_ReadContended.store(0, std::memory_order_relaxed);
+	m_WriteContended.store(0, std::memory_order_relaxed);
+	m_ReadWaitNS.store(0, std::memory_order_relaxed);
+	m_WriteWaitNS.store(0, std::memory_order_relaxed);
+	m_WriteHoldNS.store(0, std::memory_order_relaxed);
+	m_MaxWriteHoldNS.store(0, std::memory_order_relaxed);
+	m_ReadHoldSamples.store(0, std::memory_order_relaxed);
+	m_ReadHoldNS.store(0, std::memory_order_relaxed);
+	m_MaxReadHoldNS.store(0, std::memory_order_relaxed);
+}
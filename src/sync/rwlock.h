@@ -0,0 +1,150 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// rwlock.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// RWSpinLock: reader-biased reader/writer spin lock used by CAVENewLock().
+//
+//   The state word holds the number of readers and a writer bit. A reader
+//   takes the lock with one fetch_add when no writer holds it, so the display
+//   thread never enters the kernel unless it has to wait. A waiting writer
+//   does not block new readers (reader bias), which suits the CAVE pattern
+//   of one writer and one or two readers that must keep the frame rate.
+//   Waiters spin with a pause, then yield, then sleep.
+//
+//   Counters are updated with relaxed atomics. The clock is read only on
+//   contended paths, for the write hold time and for one in
+//   READ_SAMPLE_INTERVAL read holds, so the uncontended read path is
+//   three atomic adds (lock, counter, unlock) and a thread-local check.
+//   The sampled read hold times estimate the total as
+//   readHoldNS * readLocks / readHoldSamples.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+struct RWLockStats
+{
+	uint64_t readLocks;
+	uint64_t writeLocks;
+	uint64_t readContended;
+	uint64_t writeContended;
+	uint64_t readWaitNS;
+	uint64_t writeWaitNS;
+	uint64_t writeHoldNS;
+	uint64_t maxWriteHoldNS;
+	uint64_t readHoldSamples; // read holds timed
+	uint64_t readHoldNS;      // of the timed read holds
+	uint64_t maxReadHoldNS;
+};
+
+class RWSpinLock {
+public:
+	RWSpinLock();
+
+	void LockRead()
+	{
+		uint32_t state = m_State.fetch_add(READER, std::memory_order_acquire);
+		if (state & WRITER)
+		{
+			LockReadSlow();
+			return;
+		}
+		if ((m_ReadLocks.fetch_add(1, std::memory_order_relaxed) & (READ_SAMPLE_INTERVAL - 1)) == 0)
+		{
+			BeginReadSample();
+		}
+	}
+
+	void UnlockRead()
+	{
+		if (readSample().lock == this)
+		{
+			EndReadSample();
+		}
+		m_State.fetch_sub(READER, std::memory_order_release);
+	}
+
+	void LockWrite()
+	{
+		uint32_t expected = 0;
+		if (!m_State.compare_exchange_strong(expected, WRITER, std::memory_order_acquire, std::memory_order_relaxed))
+		{
+			LockWriteSlow();
+		}
+		m_WriteLocks.fetch_add(1, std::memory_order_relaxed);
+		m_WriteStart = Now();
+	}
+
+	void UnlockWrite()
+	{
+		uint64_t hold = Now() - m_WriteStart;
+		m_WriteHoldNS.fetch_add(hold, std::memory_order_relaxed);
+		if (hold > m_MaxWriteHoldNS.load(std::memory_order_relaxed))
+		{
+			m_MaxWriteHoldNS.store(hold, std::memory_order_relaxed);
+		}
+		m_State.fetch_and(~WRITER, std::memory_order_release);
+	}
+
+	void GetStats(RWLockStats* stats) const;
+	void ResetStats();
+
+private:
+	static const uint32_t WRITER = 0x80000000u;
+	static const uint32_t READER = 1;
+	static const uint64_t READ_SAMPLE_INTERVAL = 16; // a power of two
+
+	// the read hold being timed on this thread, one at a time
+	struct ReadSample
+	{
+		const RWSpinLock* lock;
+		uint64_t start;
+	};
+	static ReadSample& readSample()
+	{
+		static thread_local ReadSample sample = { nullptr, 0 };
+		return sample;
+	}
+	void BeginReadSample();
+	void EndReadSample();
+
+	static uint64_t Now()
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now().time_since_epoch()).count();
+	}
+	static void Backoff(int& count);
+
+	void LockReadSlow();
+	void LockWriteSlow();
+
+	std::atomic<uint32_t> m_State;
+	uint64_t m_WriteStart; // only touched by the writer holding the lock
+
+	std::atomic<uint64_t> m_ReadLocks;
+	std::atomic<uint64_t> m_WriteLocks;
+	std::atomic<uint64_t> m_ReadContended;
+	std::atomic<uint64_t> m_WriteContended;
+	std::atomic<uint64_t> m_ReadWaitNS;
+	std::atomic<uint64_t> m_WriteWaitNS;
+	std::atomic<uint64_t> m_WriteHoldNS;
+	std::atomic<uint64_t> m_MaxWriteHoldNS;
+	std::atomic<uint64_t> m_ReadHoldSamples;
+	std::atomic<uint64_t> m_ReadHoldNS;
+	std::atomic<uint64_t> m_MaxReadHoldNS;
+};
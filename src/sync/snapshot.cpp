@@ -0,0 +1,171 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// snapshot.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "snapshot.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+
+SharedSnapshot::SharedSnapshot()
+{
+	m_IsEnabled.store(false);
+	m_NumRegions.store(0);
+	m_Version.store(0);
+	for (int i = 0; i < 3; i++)
+	{
+		m_SlotVersion[i] = 0;
+	}
+	m_LatchedVersion.store(0);
+}
+
+SharedSnapshot::~SharedSnapshot()
+{
+	int numRegions = m_NumRegions.load();
+	for (int i = 0; i < numRegions; i++)
+	{
+		free(m_Regions[i].work);
+	}
+}
+
+void* SharedSnapshot::Allocate(size_t size)
+{
+	if (!IsEnabled() || size == 0)
+	{
+		return malloc(size);
+	}
+
+	// a freed region the display thread no longer reads, or a new one
+	int numRegions = m_NumRegions.load(std::memory_order_relaxed);
+	llong latchedVersion = m_LatchedVersion.load(std::memory_order_acquire);
+	int index = numRegions;
+	for (int i = 0; i < numRegions; i++)
+	{
+		if (!m_Regions[i].isAlive && m_Regions[i].freedVersion <= latchedVersion)
+		{
+			index = i;
+			break;
+		}
+	}
+	if (index >= SNAPSHOT_MAX_REGIONS)
+	{
+		std::cerr << "WARNING: too many snapshot regions, CAVEMalloc falls back to malloc" << std::endl;
+		return malloc(size);
+	}
+
+	// the working copy and the three slots are allocated as one block, each
+	// aligned as malloc() would align it
+	const size_t alignment = alignof(std::max_align_t);
+	size_t stride = (size + alignment - 1) / alignment * alignment;
+	char* block = static_cast<char*>(calloc(4, stride));
+	if (block == nullptr) return nullptr;
+
+	Region& region = m_Regions[index];
+	if (index < numRegions)
+	{
+		free(region.work);
+	}
+	region.work = block;
+	for (int i = 0; i < 3; i++)
+	{
+		region.slot[i] = block + (i + 1) * stride;
+	}
+	region.isAlive = true;
+	region.freedVersion = 0;
+	region.size.store(size, std::memory_order_release);
+
+	if (index == numRegions)
+	{
+		m_NumRegions.store(index + 1, std::memory_order_release);
+	}
+
+	return region.work;
+}
+
+void SharedSnapshot::Free(void* ptr)
+{
+	const Region* region = Find(ptr);
+	if (region == nullptr)
+	{
+		free(ptr);
+		return;
+	}
+
+	// keep the memory: the display thread may still be reading the latched
+	// copy, until it latches the next version
+	Region* freed = const_cast<Region*>(region);
+	freed->size.store(0, std::memory_order_relaxed);
+	freed->isAlive = false;
+	freed->freedVersion = m_Version.load(std::memory_order_relaxed) + 1;
+}
+
+void SharedSnapshot::Publish()
+{
+	if (!IsEnabled()) return;
+
+	int back = m_Index.back();
+	int numRegions = m_NumRegions.load(std::memory_order_relaxed);
+	for (int i = 0; i < numRegions; i++)
+	{
+		Region& region = m_Regions[i];
+		if (region.isAlive)
+		{
+			memcpy(region.slot[back], region.work, region.size.load(std::memory_order_relaxed));
+		}
+	}
+	llong version = m_Version.load(std::memory_order_relaxed) + 1;
+	m_SlotVersion[back] = version;
+	m_Version.store(version, std::memory_order_relaxed);
+
+	m_Index.Publish();
+}
+
+bool SharedSnapshot::Latch()
+{
+	if (!IsEnabled()) return false;
+
+	if (m_Index.Acquire())
+	{
+		// the regions freed before this version can be recycled from now on
+		m_LatchedVersion.store(m_SlotVersion[m_Index.front()], std::memory_order_release);
+		return true;
+	}
+	return false;
+}
+
+void* SharedSnapshot::Translate(void* ptr) const
+{
+	if (!IsEnabled()) return ptr;
+
+	const Region* region = Find(ptr);
+	if (region == nullptr) return ptr;
+
+	size_t offset = static_cast<char*>(ptr) - region->work;
+	return region->slot[m_Index.front()] + offset;
+}
+
+const SharedSnapshot::Region* SharedSnapshot::Find(const void* ptr) const
+{
+	const char* p = static_cast<const char*>(ptr);
+	int numRegions = m_NumRegions.load(std::memory_order_acquire);
+	for (int i = 0; i < numRegions; i++)
+	{
+		const Region& region = m_Regions[i];
+		size_t size = region.size.load(std::memory_order_acquire);
+		if (size != 0 && p >= region.work && p < region.work + size)
+		{
+			return &region;
+		}
+	}
+	return nullptr;
+}
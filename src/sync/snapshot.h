@@ -0,0 +1,79 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// snapshot.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../settings.h"
+#include "triple_buffer.h"
+
+#include <cstddef>
+
+const int SNAPSHOT_MAX_REGIONS = 256;
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// SharedSnapshot: triple-buffered CAVEMalloc memory.
+//
+//   When enabled, each region returned by Allocate() is the application
+//   thread's working copy and has three more copies behind it. Publish()
+//   copies all working copies into the back slots and flips them together,
+//   so the display thread always sees one consistent simulation step.
+//   Latch() is called by the display thread at the start of each frame, and
+//   Translate() maps a pointer into a working copy to the same address in
+//   the latched copy.
+//
+//   A freed region keeps its memory until the display thread has latched a
+//   version published after the Free(), because until then the latched
+//   copy may still be read. The next Allocate() then recycles it.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class SharedSnapshot {
+public:
+	SharedSnapshot();
+	~SharedSnapshot();
+
+	void  SetEnabled(bool enabled) { m_IsEnabled.store(enabled); }
+	bool  IsEnabled() const { return m_IsEnabled.load(std::memory_order_relaxed); }
+
+	// application thread
+	void* Allocate(size_t size);
+	void  Free(void* ptr);
+	void  Publish();
+	llong version() const { return m_Version.load(std::memory_order_relaxed); }
+
+	// display thread
+	bool  Latch();
+	void* Translate(void* ptr) const;
+	llong latchedVersion() const { return m_LatchedVersion.load(std::memory_order_relaxed); }
+
+private:
+	struct Region
+	{
+		char*  work;
+		char*  slot[3];
+		std::atomic<size_t> size; // 0 once freed; work and slot are set before it
+		bool   isAlive;
+		llong  freedVersion; // the first version without the region
+	};
+
+	std::atomic<bool> m_IsEnabled;
+	Region m_Regions[SNAPSHOT_MAX_REGIONS];
+	std::atomic<int>   m_NumRegions;
+	std::atomic<llong> m_Version;
+	TripleBufferIndex  m_Index;
+	llong  m_SlotVersion[3];
+	std::atomic<llong> m_LatchedVersion;
+
+	const Region* Find(const void* ptr) const;
+};
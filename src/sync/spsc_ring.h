@@ -0,0 +1,95 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// spsc_ring.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// SPSCRing: bounded lock-free queue for one producer and one consumer.
+//
+//   The capacity is rounded up to a power of two and the storage is
+//   allocated once by the constructor, so Push() and Pop() never allocate.
+//   Push() returns false when the ring is full.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+template <typename T>
+class SPSCRing {
+public:
+	explicit SPSCRing(size_t capacity)
+	{
+		size_t size = 1;
+		while (size < capacity) size <<= 1;
+		m_Buffer.resize(size);
+		m_Mask = size - 1;
+		m_Head.store(0);
+		m_Tail.store(0);
+	}
+
+	size_t capacity() const { return m_Mask + 1; }
+
+	size_t size() const
+	{
+		return m_Tail.load(std::memory_order_acquire) - m_Head.load(std::memory_order_acquire);
+	}
+
+	bool IsEmpty() const { return size() == 0; }
+
+	// producer
+	bool Push(const T& value)
+	{
+		size_t tail = m_Tail.load(std::memory_order_relaxed);
+		if (tail - m_Head.load(std::memory_order_acquire) > m_Mask) return false;
+		m_Buffer[tail & m_Mask] = value;
+		m_Tail.store(tail + 1, std::memory_order_release);
+		return true;
+	}
+
+	// consumer: copies up to maxCount values, oldest first, without
+	// removing them; returns the number copied
+	size_t CopyTo(T* values, size_t maxCount) const
+	{
+		size_t head = m_Head.load(std::memory_order_relaxed);
+		size_t count = m_Tail.load(std::memory_order_acquire) - head;
+		if (count > maxCount) count = maxCount;
+		for (size_t i = 0; i < count; i++)
+		{
+			values[i] = m_Buffer[(head + i) & m_Mask];
+		}
+		return count;
+	}
+
+	// consumer
+	bool Pop(T& value)
+	{
+		size_t head = m_Head.load(std::memory_order_relaxed);
+		if (head == m_Tail.load(std::memory_order_acquire)) return false;
+		value = m_Buffer[head & m_Mask];
+		m_Head.store(head + 1, std::memory_order_release);
+		return true;
+	}
+
+private:
+	std::vector<T> m_Buffer;
+	size_t m_Mask;
+
+	// head and tail are kept on separate cache lines to avoid false sharing
+	char m_Padding0[64];
+	std::atomic<size_t> m_Head;
+	char m_Padding1[64 - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t> m_Tail;
+};
@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// triple_buffer.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// TripleBufferIndex: wait-free slot exchange between one writer and one reader.
+//
+//   The writer fills the back slot and publishes it; the reader acquires the
+//   newest published slot as its front slot. The middle slot is exchanged with
+//   a single atomic operation, so neither side ever waits for the other.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class TripleBufferIndex {
+public:
+	TripleBufferIndex() : m_Middle(1), m_Back(2), m_Front(0) {}
+
+	int back() const { return m_Back; }
+	int front() const { return m_Front; }
+
+	// writer: make the back slot the newest version
+	void Publish()
+	{
+		m_Back = m_Middle.exchange(static_cast<uint8_t>(m_Back | FRESH), std::memory_order_acq_rel) & INDEX_MASK;
+	}
+
+	// reader: take the newest version if there is one, returns false if not
+	bool Acquire()
+	{
+		if (!(m_Middle.load(std::memory_order_relaxed) & FRESH)) return false;
+		m_Front = m_Middle.exchange(static_cast<uint8_t>(m_Front), std::memory_order_acq_rel) & INDEX_MASK;
+		return true;
+	}
+
+private:
+	static const uint8_t INDEX_MASK = 0x03;
+	static const uint8_t FRESH = 0x04;
+
+	std::atomic<uint8_t> m_Middle;
+	int m_Back;  // owned by the writer
+	int m_Front; // owned by the reader
+};
+
+template <typename T>
+class TripleBuffer {
+public:
+	TripleBuffer() {}
+	explicit TripleBuffer(const T& value) { m_Buffer[0] = m_Buffer[1] = m_Buffer[2] = value; }
+
+	// fill all slots, only before the buffer is shared
+	void Reset(const T& value) { m_Buffer[0] = m_Buffer[1] = m_Buffer[2] = value; }
+
+	// writer side
+	T&   back() { return m_Buffer[m_Index.back()]; }
+	void Publish() { m_Index.Publish(); }
+	void Publish(const T& value) { back() = value; m_Index.Publish(); }
+
+	// reader side
+	bool Acquire() { return m_Index.Acquire(); }
+	const T& front() const { return m_Buffer[m_Index.front()]; }
+
+private:
+	T m_Buffer[3];
+	TripleBufferIndex m_Index;
+};
@@ -0,0 +1,80 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// alloc_counter.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "alloc_counter.h"
+
+#ifdef COUNT_ALLOCATIONS
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+static std::atomic<uint64_t> s_AllocationCount(0);
+
+void* operator new(size_t size)
+{
+	s_AllocationCount.fetch_add(1, std::memory_order_relaxed);
+	void* p = malloc(size > 0 ? size : 1);
+	if (p == nullptr)
+	{
+		throw std::bad_alloc();
+	}
+	return p;
+}
+
+void* operator new[](size_t size)
+{
+	return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept
+{
+	s_AllocationCount.fetch_add(1, std::memory_order_relaxed);
+	return malloc(size > 0 ? size : 1);
+}
+
+void* operator new[](size_t size, const std::nothrow_t&) noexcept
+{
+	return operator new(size, std::nothrow);
+}
+
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+void operator delete(void* p, const std::nothrow_t&) noexcept { free(p); }
+void operator delete[](void* p, const std::nothrow_t&) noexcept { free(p); }
+
+bool IsAllocationCounted()
+{
+	return true;
+}
+
+uint64_t AllocationCount()
+{
+	return s_AllocationCount.load(std::memory_order_relaxed);
+}
+
+#else
+
+bool IsAllocationCounted()
+{
+	return false;
+}
+
+uint64_t AllocationCount()
+{
+	return 0;
+}
+
+#endif // COUNT_ALLOCATIONS
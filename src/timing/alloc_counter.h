@@ -0,0 +1,23 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// alloc_counter.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../settings.h"
+
+#include <cstdint>
+
+// calls of the global operator new in the whole process so far;
+// counted only if COUNT_ALLOCATIONS is defined (see settings.h)
+bool     IsAllocationCounted();
+uint64_t AllocationCount();
@@ -0,0 +1,134 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// bench_report.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "bench_report.h"
+#include "alloc_counter.h"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+BenchReport::BenchReport()
+{
+	m_DrawScale = 1;
+	m_Warmup = 30;
+	m_NumFrames = 0;
+	m_DroppedFrames = 0;
+	m_StartTicks = m_LastTicks = 0;
+	m_StartAllocations = m_LastAllocations = 0;
+
+	const char* env;
+	if ((env = getenv("CLCL_BENCH")) != nullptr)
+	{
+		m_Path = env;
+	}
+	if (!IsEnabled()) return;
+
+	if ((env = getenv("CLCL_BENCH_WARMUP")) != nullptr)
+	{
+		m_Warmup = std::max(0LL, atoll(env));
+	}
+	if ((env = getenv("CLCL_BENCH_SCALE")) != nullptr)
+	{
+		m_DrawScale = std::max(1, atoi(env));
+	}
+	m_FrameTimes.reserve(MAX_FRAMES);
+}
+
+void BenchReport::BeginFrame(llong applicationTicks)
+{
+	if (!IsEnabled()) return;
+
+	std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+	m_NumFrames++;
+	if (m_NumFrames == m_Warmup + 1)
+	{
+		m_StartTime = now;
+		m_StartTicks = applicationTicks;
+		m_StartAllocations = AllocationCount();
+	}
+	else if (m_NumFrames > m_Warmup + 1)
+	{
+		if (m_FrameTimes.size() < MAX_FRAMES)
+		{
+			std::chrono::duration<float, std::milli> interval = now - m_LastTime;
+			m_FrameTimes.push_back(interval.count());
+		}
+		else
+		{
+			m_DroppedFrames++;
+		}
+	}
+	m_LastTime = now;
+	m_LastTicks = applicationTicks;
+	m_LastAllocations = AllocationCount();
+}
+
+bool BenchReport::Write(const char* backend, int width, int height)
+{
+	if (!IsEnabled()) return false;
+
+	FILE* file = fopen(m_Path.c_str(), "w");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "ERROR: cannot open %s\n", m_Path.c_str());
+		return false;
+	}
+
+	llong numFrames = static_cast<llong>(m_FrameTimes.size()) + m_DroppedFrames;
+	std::vector<float> sorted(m_FrameTimes);
+	std::sort(sorted.begin(), sorted.end());
+	double sum = 0.0;
+	for (size_t i = 0; i < sorted.size(); i++)
+	{
+		sum += sorted[i];
+	}
+	double elapsed = std::chrono::duration<double>(m_LastTime - m_StartTime).count();
+
+	fprintf(file, "{\n");
+	fprintf(file, "  \"backend\": \"%s\",\n", backend);
+	fprintf(file, "  \"render_width\": %d,\n", width);
+	fprintf(file, "  \"render_height\": %d,\n", height);
+	fprintf(file, "  \"scale\": %d,\n", m_DrawScale);
+	fprintf(file, "  \"warmup\": %lld,\n", m_Warmup);
+	fprintf(file, "  \"frames\": %lld,\n", numFrames);
+	fprintf(file, "  \"frame_time_ms\": {\"mean\": %.4f, \"p50\": %.4f, \"p95\": %.4f, \"p99\": %.4f, \"max\": %.4f},\n",
+		sorted.empty() ? 0.0 : sum / sorted.size(),
+		Percentile(sorted, 0.50), Percentile(sorted, 0.95), Percentile(sorted, 0.99),
+		sorted.empty() ? 0.0 : sorted.back());
+	fprintf(file, "  \"app_rate_hz\": %.3f,\n", elapsed > 0.0 ? (m_LastTicks - m_StartTicks) / elapsed : 0.0);
+	if (IsAllocationCounted() && numFrames > 0)
+	{
+		fprintf(file, "  \"allocations_per_frame\": %.3f\n",
+			static_cast<double>(m_LastAllocations - m_StartAllocations) / numFrames);
+	}
+	else
+	{
+		fprintf(file, "  \"allocations_per_frame\": null\n");
+	}
+	fprintf(file, "}\n");
+	fclose(file);
+
+	fprintf(stderr, "Bench: wrote %s (%lld frames)\n", m_Path.c_str(), numFrames);
+	return true;
+}
+
+// nearest rank
+double BenchReport::Percentile(const std::vector<float>& sorted, double p)
+{
+	if (sorted.empty()) return 0.0;
+
+	size_t rank = static_cast<size_t>(std::ceil(p * sorted.size()));
+	return sorted[rank > 0 ? rank - 1 : 0];
+}
@@ -0,0 +1,68 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// bench_report.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../settings.h"
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// BenchReport: frame time statistics of a run, written as JSON on exit.
+//
+//   Enabled by the environment variable CLCL_BENCH, which names the output
+//   file. The display thread stores the interval between the starts of its
+//   frames in a preallocated array; the first CLCL_BENCH_WARMUP frames
+//   (default 30) are not measured. The report holds the percentiles of the
+//   frame time, the application thread rate (CAVEUSleep() calls per
+//   second) and, with COUNT_ALLOCATIONS, the allocations per frame.
+//
+//   CLCL_BENCH_SCALE calls the draw callback the given number of times per
+//   eye, to scale the rendering workload of an application.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class BenchReport {
+public:
+	BenchReport();
+
+	bool IsEnabled() const { return !m_Path.empty(); }
+	int  drawScale() const { return m_DrawScale; }
+
+	// display thread, at the start of every frame
+	void BeginFrame(llong applicationTicks);
+	bool Write(const char* backend, int width, int height);
+
+private:
+	static const size_t MAX_FRAMES = 1 << 20;
+
+	std::string m_Path;
+	int         m_DrawScale;
+	llong       m_Warmup;
+	llong       m_NumFrames;     // frames begun
+	std::vector<float> m_FrameTimes; // ms
+	llong       m_DroppedFrames;
+
+	std::chrono::steady_clock::time_point m_StartTime;
+	std::chrono::steady_clock::time_point m_LastTime;
+	llong       m_StartTicks;
+	llong       m_LastTicks;
+	uint64_t    m_StartAllocations;
+	uint64_t    m_LastAllocations;
+
+	static double Percentile(const std::vector<float>& sorted, double p);
+};
@@ -0,0 +1,327 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// frame_timer.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "frame_timer.h"
+
+#include <cstdlib>
+#include <cstring>
+
+static const char* STAGE_NAMES[NUM_TIMING_STAGES] = {
+	"Frame",
+	"UpdateTrackingData",
+	"IdleCallback",
+	"PreProcess",
+	"SetMatrix",
+	"DrawCallback",
+	"DrawDevices",
+	"SubmitFrame",
+	"PostProcess",
+	"CameraUpload",
+	"GPU"
+};
+
+FrameTimer::FrameTimer()
+{
+	m_IsEnabled = false;
+	m_IsMeasuring = false;
+	m_IsGPUEnabled = false;
+	m_IsDumpKeyPressed = false;
+	m_NumDumps = 0;
+	m_StartTime = std::chrono::steady_clock::now();
+	p_Events = nullptr;
+	m_NumDumpEvents = 0;
+	m_IsDumping.store(false);
+	m_FrameIndex = 0;
+	for (int i = 0; i < NUM_TIMING_STAGES; i++)
+	{
+		m_StageStart[i] = 0;
+	}
+	m_LastFrameInterval = 0;
+	m_LastGPUTime[0] = m_LastGPUTime[1] = 0;
+	for (int i = 0; i < QUERY_LATENCY; i++)
+	{
+		m_QueryFrame[i] = 0;
+		for (int eyeIndex = 0; eyeIndex < 2; eyeIndex++)
+		{
+			m_Queries[i][eyeIndex] = 0;
+			m_IsQueryPending[i][eyeIndex] = false;
+			m_QueryStart[i][eyeIndex] = 0;
+		}
+	}
+}
+
+FrameTimer::~FrameTimer()
+{
+	JoinDumpThread();
+	delete p_Events;
+}
+
+void FrameTimer::Init()
+{
+	const char* env;
+	if ((env = getenv("CLCL_TIMING")) == nullptr || env[0] == '\0') return;
+
+	m_Path = env;
+	size_t numEvents = 1 << 16;
+	if ((env = getenv("CLCL_TIMING_EVENTS")) != nullptr && atoi(env) > 0)
+	{
+		numEvents = atoi(env);
+	}
+	p_Events = new SPSCRing<TimingEvent>(numEvents);
+	m_DumpEvents.resize(p_Events->capacity());
+	m_IsEnabled = true;
+
+	fprintf(stderr, "Timing: %s (%d records)\n", m_Path.c_str(), static_cast<int>(p_Events->capacity()));
+}
+
+void FrameTimer::InitGL()
+{
+	// the queries are created even when not recording, the HUD may need them
+	// GL_TIME_ELAPSED queries are core since OpenGL 3.3
+	if (!GLEW_ARB_timer_query) return;
+	glGenQueries(QUERY_LATENCY * 2, &m_Queries[0][0]);
+	m_IsGPUEnabled = true;
+}
+
+void FrameTimer::TerminateGL()
+{
+	if (!m_IsGPUEnabled) return;
+
+	glDeleteQueries(QUERY_LATENCY * 2, &m_Queries[0][0]);
+	m_IsGPUEnabled = false;
+}
+
+void FrameTimer::BeginFrame(llong frameIndex)
+{
+	if (!IsActive()) return;
+
+	uint64_t now = Now();
+	if (m_StageStart[STAGE_FRAME] != 0)
+	{
+		m_LastFrameInterval = now - m_StageStart[STAGE_FRAME];
+	}
+	m_FrameIndex = frameIndex;
+	m_StageStart[STAGE_FRAME] = now;
+
+	// the queries of this slot were issued QUERY_LATENCY frames ago
+	if (m_IsGPUEnabled)
+	{
+		ReadQueries(static_cast<int>(frameIndex % QUERY_LATENCY));
+	}
+}
+
+void FrameTimer::EndFrame()
+{
+	End(STAGE_FRAME);
+}
+
+void FrameTimer::BeginGPU(int eyeIndex)
+{
+	if (!m_IsGPUEnabled || !IsActive()) return;
+
+	int slot = static_cast<int>(m_FrameIndex % QUERY_LATENCY);
+	m_QueryFrame[slot] = m_FrameIndex;
+	m_QueryStart[slot][eyeIndex] = Now();
+	glBeginQuery(GL_TIME_ELAPSED, m_Queries[slot][eyeIndex]);
+}
+
+void FrameTimer::EndGPU(int eyeIndex)
+{
+	if (!m_IsGPUEnabled || !IsActive()) return;
+
+	int slot = static_cast<int>(m_FrameIndex % QUERY_LATENCY);
+	glEndQuery(GL_TIME_ELAPSED);
+	m_IsQueryPending[slot][eyeIndex] = true;
+}
+
+void FrameTimer::ReadQueries(int slot)
+{
+	for (int eyeIndex = 0; eyeIndex < 2; eyeIndex++)
+	{
+		if (!m_IsQueryPending[slot][eyeIndex]) continue;
+
+		GLuint64 elapsed = 0;
+		glGetQueryObjectui64v(m_Queries[slot][eyeIndex], GL_QUERY_RESULT, &elapsed);
+		m_IsQueryPending[slot][eyeIndex] = false;
+		m_LastGPUTime[eyeIndex] = elapsed;
+		if (!m_IsEnabled) continue;
+
+		// GPU records are placed at the CPU time the eye was started
+		TimingEvent event;
+		event.frame = m_QueryFrame[slot];
+		event.start = m_QueryStart[slot][eyeIndex];
+		event.duration = elapsed;
+		event.stage = STAGE_GPU_EYE;
+		event.eye = static_cast<int16_t>(eyeIndex);
+		if (!p_Events->Push(event))
+		{
+			TimingEvent oldest;
+			p_Events->Pop(oldest);
+			p_Events->Push(event);
+		}
+	}
+}
+
+void FrameTimer::Record(int stage, int eyeIndex, uint64_t start, uint64_t duration)
+{
+	TimingEvent event;
+	event.frame = m_FrameIndex;
+	event.start = start;
+	event.duration = duration;
+	event.stage = static_cast<int16_t>(stage);
+	event.eye = static_cast<int16_t>(eyeIndex);
+
+	// the display thread is also the consumer, so it may drop the oldest record
+	if (!p_Events->Push(event))
+	{
+		TimingEvent oldest;
+		p_Events->Pop(oldest);
+		p_Events->Push(event);
+	}
+}
+
+void FrameTimer::CheckDumpKey(bool isPressed)
+{
+	if (!m_IsEnabled) return;
+
+	if (isPressed && !m_IsDumpKeyPressed)
+	{
+		if (m_IsDumping.load())
+		{
+			fprintf(stderr, "Timing: the previous dump is still being written\n");
+			m_IsDumpKeyPressed = isPressed;
+			return;
+		}
+		JoinDumpThread();
+
+		// "trace.json" -> "trace_1.json", "trace_2.json", ...
+		char suffix[32];
+		sprintf(suffix, "_%d", ++m_NumDumps);
+		std::string path = m_Path;
+		size_t dot = path.find_last_of('.');
+		size_t slash = path.find_last_of("/\\");
+		if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+		{
+			path += suffix;
+		}
+		else
+		{
+			path.insert(dot, suffix);
+		}
+
+		// the records stay in the ring; the file is written off the display thread
+		m_NumDumpEvents = p_Events->CopyTo(m_DumpEvents.data(), m_DumpEvents.size());
+		m_DumpPath = path;
+		m_IsDumping.store(true);
+		m_DumpThread = std::thread([this]() {
+			Write(m_DumpPath, m_DumpEvents.data(), m_NumDumpEvents);
+			m_IsDumping.store(false);
+		});
+	}
+	m_IsDumpKeyPressed = isPressed;
+}
+
+void FrameTimer::JoinDumpThread()
+{
+	if (m_DumpThread.joinable())
+	{
+		m_DumpThread.join();
+	}
+}
+
+bool FrameTimer::Dump()
+{
+	return Dump(m_Path);
+}
+
+// on the calling thread; the ring is drained
+bool FrameTimer::Dump(const std::string& path)
+{
+	if (!m_IsEnabled) return false;
+
+	JoinDumpThread();
+	m_NumDumpEvents = 0;
+	TimingEvent event;
+	while (m_NumDumpEvents < m_DumpEvents.size() && p_Events->Pop(event))
+	{
+		m_DumpEvents[m_NumDumpEvents++] = event;
+	}
+	return Write(path, m_DumpEvents.data(), m_NumDumpEvents);
+}
+
+bool FrameTimer::Write(const std::string& path, const TimingEvent* events, size_t numEvents)
+{
+	FILE* file = fopen(path.c_str(), "w");
+	if (file == nullptr)
+	{
+		fprintf(stderr, "ERROR: cannot open %s\n", path.c_str());
+		return false;
+	}
+
+	bool isCSV = path.size() >= 4 && path.compare(path.size() - 4, 4, ".csv") == 0;
+	bool result = isCSV ? WriteCSV(file, events, numEvents) : WriteTrace(file, events, numEvents);
+	fclose(file);
+
+	fprintf(stderr, "Timing: wrote %s\n", path.c_str());
+	return result;
+}
+
+bool FrameTimer::WriteTrace(FILE* file, const TimingEvent* events, size_t numEvents)
+{
+	fprintf(file, "{\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":1,\"args\":{\"name\":\"display thread\"}},\n");
+	fprintf(file, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":2,\"args\":{\"name\":\"GPU\"}}");
+
+	for (size_t i = 0; i < numEvents; i++)
+	{
+		const TimingEvent& event = events[i];
+		char name[64];
+		if (event.eye >= 0)
+		{
+			sprintf(name, "%s[%d]", stageName(event.stage), event.eye);
+		}
+		else
+		{
+			strcpy(name, stageName(event.stage));
+		}
+		fprintf(file, ",\n{\"name\":\"%s\",\"cat\":\"%s\",\"ph\":\"X\",\"ts\":%.3f,\"dur\":%.3f,\"pid\":1,\"tid\":%d,\"args\":{\"frame\":%lld}}",
+			name, event.stage == STAGE_GPU_EYE ? "gpu" : "cpu",
+			event.start / 1000.0, event.duration / 1000.0,
+			event.stage == STAGE_GPU_EYE ? 2 : 1, event.frame);
+	}
+	fprintf(file, "\n]}\n");
+
+	return !ferror(file);
+}
+
+bool FrameTimer::WriteCSV(FILE* file, const TimingEvent* events, size_t numEvents)
+{
+	fprintf(file, "frame,stage,eye,start_us,duration_us\n");
+
+	for (size_t i = 0; i < numEvents; i++)
+	{
+		const TimingEvent& event = events[i];
+		fprintf(file, "%lld,%s,%d,%.3f,%.3f\n",
+			event.frame, stageName(event.stage), event.eye,
+			event.start / 1000.0, event.duration / 1000.0);
+	}
+
+	return !ferror(file);
+}
+
+const char* FrameTimer::stageName(int stage)
+{
+	if (stage < 0 || stage >= NUM_TIMING_STAGES) return "Unknown";
+	return STAGE_NAMES[stage];
+}
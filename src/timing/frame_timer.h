@@ -0,0 +1,161 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// frame_timer.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../settings.h"
+#include "../sync/spsc_ring.h"
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+#include <vector>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+// dumps the timing records while the display thread is running
+const int TIMING_DUMP_KEY = 301; // GLFW_KEY_F12
+
+typedef enum {
+	STAGE_FRAME = 0,
+	STAGE_TRACKING,
+	STAGE_IDLE,
+	STAGE_PREPROCESS,
+	STAGE_SETMATRIX,
+	STAGE_DRAW,
+	STAGE_DEVICES,
+	STAGE_SUBMIT,
+	STAGE_POSTPROCESS,
+	STAGE_CAMERA_UPLOAD,
+	STAGE_GPU_EYE,
+	NUM_TIMING_STAGES
+} TIMING_STAGE;
+
+struct TimingEvent
+{
+	llong    frame;
+	uint64_t start;    // ns since the timer was created
+	uint64_t duration; // ns
+	int16_t  stage;
+	int16_t  eye;      // -1 if the stage is not per eye
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// FrameTimer: per-stage timing of the display thread.
+//
+//   Enabled by the environment variable CLCL_TIMING, which names the output
+//   file (".csv" for CSV, otherwise Chrome trace JSON, which can be opened
+//   with chrome://tracing). CPU stages are measured with steady_clock, and
+//   each eye's GPU time with a GL_TIME_ELAPSED query that is read a few
+//   frames later so that the display thread never waits for the GPU.
+//
+//   The last frame interval and GPU times are also kept for the HUD, which
+//   turns on measuring without recording.
+//
+//   Records go to a preallocated lock-free ring. The display thread is the
+//   producer; the ring is dumped on exit and copied when TIMING_DUMP_KEY is
+//   pressed. The copy is written to a numbered file by a separate thread,
+//   after the frame has ended, and the records stay in the ring for the
+//   dump on exit. When the ring is full the oldest records are dropped, so
+//   a dump always holds the most recent frames.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class FrameTimer {
+public:
+	FrameTimer();
+	~FrameTimer();
+
+	void Init();
+	void InitGL();
+	void TerminateGL();
+	bool IsEnabled() const { return m_IsEnabled; }
+
+	// frame and GPU times without recording (used by the HUD)
+	void SetMeasuring(bool measuring) { m_IsMeasuring = measuring; }
+	double lastFrameInterval() const { return m_LastFrameInterval * 1.0e-9; }
+	double lastGPUTime(int eyeIndex) const { return m_LastGPUTime[eyeIndex] * 1.0e-9; }
+
+	void BeginFrame(llong frameIndex);
+	void EndFrame();
+
+	void Begin(TIMING_STAGE stage, int eyeIndex = -1)
+	{
+		if (!m_IsEnabled) return;
+		m_StageStart[stage] = Now();
+	}
+	void End(TIMING_STAGE stage, int eyeIndex = -1)
+	{
+		if (!m_IsEnabled) return;
+		uint64_t now = Now();
+		Record(stage, eyeIndex, m_StageStart[stage], now - m_StageStart[stage]);
+	}
+
+	void BeginGPU(int eyeIndex);
+	void EndGPU(int eyeIndex);
+
+	// checks the hotkey state once per frame and dumps on its press
+	void CheckDumpKey(bool isPressed);
+	bool Dump();
+	bool Dump(const std::string& path);
+
+	static const char* stageName(int stage);
+
+private:
+	static const int QUERY_LATENCY = 4; // frames before a query is read back
+
+	bool     m_IsEnabled;   // recording
+	bool     m_IsMeasuring;
+	bool     m_IsGPUEnabled;
+	bool     m_IsDumpKeyPressed;
+	std::string m_Path;
+	int      m_NumDumps;
+	std::chrono::steady_clock::time_point m_StartTime;
+
+	SPSCRing<TimingEvent>* p_Events;
+
+	// copy of the ring for TIMING_DUMP_KEY, written by m_DumpThread
+	std::vector<TimingEvent> m_DumpEvents;
+	size_t   m_NumDumpEvents;
+	std::string m_DumpPath;
+	std::thread m_DumpThread;
+	std::atomic<bool> m_IsDumping;
+
+	llong    m_FrameIndex;
+	uint64_t m_StageStart[NUM_TIMING_STAGES];
+	uint64_t m_LastFrameInterval;
+	uint64_t m_LastGPUTime[2];
+
+	GLuint   m_Queries[QUERY_LATENCY][2];
+	bool     m_IsQueryPending[QUERY_LATENCY][2];
+	llong    m_QueryFrame[QUERY_LATENCY];
+	uint64_t m_QueryStart[QUERY_LATENCY][2];
+
+	uint64_t Now() const
+	{
+		return std::chrono::duration_cast<std::chrono::nanoseconds>(
+			std::chrono::steady_clock::now() - m_StartTime).count();
+	}
+	void Record(int stage, int eyeIndex, uint64_t start, uint64_t duration);
+	void ReadQueries(int slot);
+	void JoinDumpThread();
+	bool Write(const std::string& path, const TimingEvent* events, size_t numEvents);
+	bool WriteTrace(FILE* file, const TimingEvent* events, size_t numEvents);
+	bool WriteCSV(FILE* file, const TimingEvent* events, size_t numEvents);
+	bool IsActive() const { return m_IsEnabled || m_IsMeasuring; }
+};
@@ -0,0 +1,286 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// hud.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#define _CRT_SECURE_NO_WARNINGS
+#include "hud.h"
+
+#include <cstdio>
+#include <cstddef>
+
+#include <glm/gtc/matrix_transform.hpp> // glm::translate, glm::scale
+
+// colors (0xRRGGBBAA)
+static const uint32_t COLOR_BACKGROUND = 0x000000B0;
+static const uint32_t COLOR_APP        = 0x40FF40FF;
+static const uint32_t COLOR_FRAME      = 0xFFFFFFFF;
+static const uint32_t COLOR_GPU        = 0x40E0FFFF;
+static const uint32_t COLOR_BAR        = 0x40C040FF;
+static const uint32_t COLOR_BAR_LATE   = 0xFF4040FF;
+static const uint32_t COLOR_DEADLINE   = 0xFFFF40FF;
+
+// segments a-g of the digits 0-9 (bit 0: a, ..., bit 6: g)
+static const uint8_t SEGMENTS[10] = { 0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F };
+
+// panel layout in panel units (1.0 x 0.5)
+static const float PANEL_WIDTH  = 1.0f;
+static const float PANEL_HEIGHT = 0.5f;
+static const float DIGIT_HEIGHT = 0.06f;
+static const float GRAPH_X0 = 0.02f, GRAPH_Y0 = 0.03f;
+static const float GRAPH_X1 = 0.98f, GRAPH_Y1 = 0.33f;
+
+PerformanceHUD::PerformanceHUD()
+{
+	m_Buffer = 0;
+	p_Mapped = nullptr;
+	p_Staging = nullptr;
+	for (int i = 0; i < NUM_REGIONS; i++)
+	{
+		m_Fence[i] = 0;
+	}
+	m_Region = 0;
+	m_NumVertices = 0;
+	for (int i = 0; i < HISTORY_SIZE; i++)
+	{
+		m_History[i] = 0.0f;
+	}
+	m_HistoryIndex = 0;
+	p_Vertices = nullptr;
+	m_Count = 0;
+}
+
+PerformanceHUD::~PerformanceHUD()
+{
+	delete[] p_Staging;
+}
+
+void PerformanceHUD::InitGL()
+{
+	GLsizeiptr size = sizeof(Vertex) * MAX_VERTICES * NUM_REGIONS;
+
+	glGenBuffers(1, &m_Buffer);
+	glBindBuffer(GL_ARRAY_BUFFER, m_Buffer);
+	if (GLEW_ARB_buffer_storage)
+	{
+		GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+		glBufferStorage(GL_ARRAY_BUFFER, size, nullptr, flags);
+		p_Mapped = static_cast<Vertex*>(glMapBufferRange(GL_ARRAY_BUFFER, 0, size, flags));
+	}
+	if (p_Mapped == nullptr)
+	{
+		glBufferData(GL_ARRAY_BUFFER, size, nullptr, GL_STREAM_DRAW);
+		p_Staging = new Vertex[MAX_VERTICES];
+	}
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+}
+
+void PerformanceHUD::TerminateGL()
+{
+	for (int i = 0; i < NUM_REGIONS; i++)
+	{
+		if (m_Fence[i] != 0)
+		{
+			glDeleteSync(m_Fence[i]);
+			m_Fence[i] = 0;
+		}
+	}
+	if (p_Mapped != nullptr)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, m_Buffer);
+		glUnmapBuffer(GL_ARRAY_BUFFER);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		p_Mapped = nullptr;
+	}
+	glDeleteBuffers(1, &m_Buffer);
+	m_Buffer = 0;
+}
+
+void PerformanceHUD::Update(const HUDStats& stats)
+{
+	if (m_Buffer == 0) return;
+
+	m_History[m_HistoryIndex] = static_cast<float>(stats.frameTime);
+	m_HistoryIndex = (m_HistoryIndex + 1) % HISTORY_SIZE;
+
+	// the region written three frames ago is free once its fence has passed
+	int region = (m_Region + 1) % NUM_REGIONS;
+	if (p_Mapped != nullptr)
+	{
+		if (m_Fence[region] != 0)
+		{
+			glClientWaitSync(m_Fence[region], GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000);
+			glDeleteSync(m_Fence[region]);
+			m_Fence[region] = 0;
+		}
+		p_Vertices = p_Mapped + region * MAX_VERTICES;
+	}
+	else
+	{
+		p_Vertices = p_Staging;
+	}
+	m_Count = 0;
+
+	AddRect(0.0f, 0.0f, PANEL_WIDTH, PANEL_HEIGHT, COLOR_BACKGROUND);
+
+	float y = 0.40f;
+	AddRect(0.01f, y, 0.03f, y + DIGIT_HEIGHT, COLOR_APP);
+	AddNumber(0.05f, y, DIGIT_HEIGHT, stats.applicationRate, 0, COLOR_APP);
+	AddRect(0.26f, y, 0.28f, y + DIGIT_HEIGHT, COLOR_FRAME);
+	AddNumber(0.30f, y, DIGIT_HEIGHT, stats.frameTime * 1000.0, 2, COLOR_FRAME);
+	AddRect(0.51f, y, 0.53f, y + DIGIT_HEIGHT, COLOR_GPU);
+	AddNumber(0.55f, y, DIGIT_HEIGHT, stats.gpuTime[0] * 1000.0, 2, COLOR_GPU);
+	AddNumber(0.77f, y, DIGIT_HEIGHT, stats.gpuTime[1] * 1000.0, 2, COLOR_GPU);
+
+	// the deadline is at 2/3 of the graph height
+	float deadline = stats.deadline > 0.0 ? static_cast<float>(stats.deadline) : 1.0f / 90.0f;
+	float scale = (GRAPH_Y1 - GRAPH_Y0) / (1.5f * deadline);
+	float barWidth = (GRAPH_X1 - GRAPH_X0) / HISTORY_SIZE;
+	for (int i = 0; i < HISTORY_SIZE; i++)
+	{
+		float value = m_History[(m_HistoryIndex + i) % HISTORY_SIZE];
+		float height = value * scale;
+		if (height > GRAPH_Y1 - GRAPH_Y0) height = GRAPH_Y1 - GRAPH_Y0;
+		if (height <= 0.0f) continue;
+		float x = GRAPH_X0 + i * barWidth;
+		AddRect(x, GRAPH_Y0, x + barWidth * 0.8f, GRAPH_Y0 + height, value > deadline ? COLOR_BAR_LATE : COLOR_BAR);
+	}
+	float yDeadline = GRAPH_Y0 + deadline * scale;
+	AddRect(GRAPH_X0, yDeadline - 0.002f, GRAPH_X1, yDeadline + 0.002f, COLOR_DEADLINE);
+
+	if (p_Mapped == nullptr)
+	{
+		glBindBuffer(GL_ARRAY_BUFFER, m_Buffer);
+		glBufferSubData(GL_ARRAY_BUFFER, sizeof(Vertex) * region * MAX_VERTICES, sizeof(Vertex) * m_Count, p_Staging);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	m_Region = region;
+	m_NumVertices = m_Count;
+}
+
+void PerformanceHUD::Draw(const glm::mat4& projection, const glm::mat4& eyeFromHead)
+{
+	if (m_Buffer == 0 || m_NumVertices == 0) return;
+
+	// 0.5 m wide, 1 m ahead and 0.3 m below the eyes
+	glm::mat4 model = eyeFromHead;
+	model = glm::translate(model, glm::vec3(0.0f, -0.3f, -1.0f));
+	model = glm::scale(model, glm::vec3(0.5f, 0.5f, 0.5f));
+	model = glm::translate(model, glm::vec3(-PANEL_WIDTH * 0.5f, -PANEL_HEIGHT * 0.5f, 0.0f));
+
+	glPushAttrib(GL_ENABLE_BIT | GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_CURRENT_BIT);
+	glPushClientAttrib(GL_CLIENT_VERTEX_ARRAY_BIT);
+	glUseProgram(0);
+	glDisable(GL_DEPTH_TEST);
+	glDisable(GL_LIGHTING);
+	glDisable(GL_TEXTURE_2D);
+	glDisable(GL_CULL_FACE);
+	glEnable(GL_BLEND);
+	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+
+	glMatrixMode(GL_PROJECTION);
+	glPushMatrix();
+	glLoadMatrixf(&projection[0][0]);
+	glMatrixMode(GL_MODELVIEW);
+	glPushMatrix();
+	glLoadMatrixf(&model[0][0]);
+
+	glBindBuffer(GL_ARRAY_BUFFER, m_Buffer);
+	glEnableClientState(GL_VERTEX_ARRAY);
+	glEnableClientState(GL_COLOR_ARRAY);
+	glVertexPointer(2, GL_FLOAT, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, x)));
+	glColorPointer(4, GL_UNSIGNED_BYTE, sizeof(Vertex), reinterpret_cast<void*>(offsetof(Vertex, r)));
+	glDrawArrays(GL_TRIANGLES, m_Region * MAX_VERTICES, m_NumVertices);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+
+	glMatrixMode(GL_PROJECTION);
+	glPopMatrix();
+	glMatrixMode(GL_MODELVIEW);
+	glPopMatrix();
+	glPopClientAttrib();
+	glPopAttrib();
+
+	// the fence after the last eye guards the region until the GPU is done with it
+	if (p_Mapped != nullptr)
+	{
+		if (m_Fence[m_Region] != 0)
+		{
+			glDeleteSync(m_Fence[m_Region]);
+		}
+		m_Fence[m_Region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	}
+}
+
+void PerformanceHUD::AddRect(float x0, float y0, float x1, float y1, uint32_t color)
+{
+	if (m_Count + 6 > MAX_VERTICES) return;
+
+	uint8_t r = (color >> 24) & 0xFF;
+	uint8_t g = (color >> 16) & 0xFF;
+	uint8_t b = (color >>  8) & 0xFF;
+	uint8_t a = (color      ) & 0xFF;
+	const float corners[6][2] = {
+		{ x0, y0 }, { x1, y0 }, { x1, y1 },
+		{ x0, y0 }, { x1, y1 }, { x0, y1 }
+	};
+	for (int i = 0; i < 6; i++)
+	{
+		Vertex& vertex = p_Vertices[m_Count++];
+		vertex.x = corners[i][0];
+		vertex.y = corners[i][1];
+		vertex.r = r;
+		vertex.g = g;
+		vertex.b = b;
+		vertex.a = a;
+	}
+}
+
+void PerformanceHUD::AddNumber(float x, float y, float height, double value, int decimals, uint32_t color)
+{
+	if (value < 0.0) value = 0.0;
+	if (value > 9999.0) value = 9999.0;
+
+	char text[32];
+	snprintf(text, sizeof(text), "%.*f", decimals, value);
+
+	float width = height * 0.5f;
+	for (const char* c = text; *c != '\0'; c++)
+	{
+		if (*c == '.')
+		{
+			float t = height * 0.12f;
+			AddRect(x, y, x + t, y + t, color);
+			x += t * 2.0f;
+		}
+		else if (*c >= '0' && *c <= '9')
+		{
+			AddDigit(x, y, height, *c - '0', color);
+			x += width * 1.4f;
+		}
+	}
+}
+
+void PerformanceHUD::AddDigit(float x, float y, float height, int digit, uint32_t color)
+{
+	float w = height * 0.5f;
+	float h = height * 0.5f;
+	float t = height * 0.12f;
+	uint8_t segments = SEGMENTS[digit];
+
+	if (segments & 0x01) AddRect(x,         y + 2 * h - t, x + w, y + 2 * h,     color); // a
+	if (segments & 0x02) AddRect(x + w - t, y + h,         x + w, y + 2 * h,     color); // b
+	if (segments & 0x04) AddRect(x + w - t, y,             x + w, y + h,         color); // c
+	if (segments & 0x08) AddRect(x,         y,             x + w, y + t,         color); // d
+	if (segments & 0x10) AddRect(x,         y,             x + t, y + h,         color); // e
+	if (segments & 0x20) AddRect(x,         y + h,         x + t, y + 2 * h,     color); // f
+	if (segments & 0x40) AddRect(x,         y + h - t / 2, x + w, y + h + t / 2, color); // g
+}
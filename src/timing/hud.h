@@ -0,0 +1,90 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// hud.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../settings.h"
+
+#include <cstdint>
+
+#define GLEW_STATIC
+#include <GL/glew.h>
+
+#include <glm/mat4x4.hpp> // glm::mat4
+
+struct HUDStats
+{
+	double applicationRate; // Hz, measured from CAVEUSleep() calls
+	double frameTime;       // seconds between display frames
+	double gpuTime[2];      // seconds per eye
+	double deadline;        // seconds, 1 / display frequency
+};
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// PerformanceHUD: the CAVE_SIM_DRAWTIMING overlay.
+//
+//   A head-locked panel below the line of sight shows four numbers with
+//   seven segment digits, each after a colored marker:
+//     green: application thread rate (Hz)
+//     white: display frame time (ms)
+//     cyan : GPU time of the left and right eye (ms)
+//   and a rolling graph of the frame time, with bars over the compositor
+//   deadline drawn in red and the deadline itself as a yellow line.
+//
+//   Update() builds the vertices once per frame into a persistently mapped
+//   buffer (three regions guarded by fences), and Draw() issues a single
+//   glDrawArrays per eye.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class PerformanceHUD {
+public:
+	PerformanceHUD();
+	~PerformanceHUD();
+
+	void InitGL();
+	void TerminateGL();
+	bool IsInitializedGL() const { return m_Buffer != 0; }
+
+	void Update(const HUDStats& stats);
+	void Draw(const glm::mat4& projection, const glm::mat4& eyeFromHead);
+
+private:
+	static const int HISTORY_SIZE = 120;
+	static const int MAX_VERTICES = 4096;
+	static const int NUM_REGIONS  = 3;
+
+	struct Vertex
+	{
+		float   x, y;
+		uint8_t r, g, b, a;
+	};
+
+	GLuint   m_Buffer;
+	Vertex*  p_Mapped;   // persistent mapping, or nullptr
+	Vertex*  p_Staging;  // used when persistent mapping is not available
+	GLsync   m_Fence[NUM_REGIONS];
+	int      m_Region;
+	int      m_NumVertices;
+
+	float    m_History[HISTORY_SIZE];
+	int      m_HistoryIndex;
+
+	Vertex*  p_Vertices; // vertices being built
+	int      m_Count;
+
+	void AddRect(float x0, float y0, float x1, float y1, uint32_t color);
+	void AddNumber(float x, float y, float height, double value, int decimals, uint32_t color);
+	void AddDigit(float x, float y, float height, int digit, uint32_t color);
+};
@@ -0,0 +1,105 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// rate_timer.cpp
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#include "rate_timer.h"
+
+#include <thread>
+
+#ifdef _WIN32
+#ifndef CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#define CREATE_WAITABLE_TIMER_HIGH_RESOLUTION 0x00000002 // Windows SDK 10.0.17134
+#endif // CREATE_WAITABLE_TIMER_HIGH_RESOLUTION
+#endif // _WIN32
+
+RateTimer::RateTimer()
+{
+	m_Rate = 0.0;
+	m_Period = Clock::duration::zero();
+	m_IsStarted = false;
+#ifdef _WIN32
+	m_Timer = NULL;
+#endif // _WIN32
+}
+
+RateTimer::~RateTimer()
+{
+#ifdef _WIN32
+	if (m_Timer != NULL)
+	{
+		CloseHandle(m_Timer);
+	}
+#endif // _WIN32
+}
+
+void RateTimer::SetRate(double rate)
+{
+	m_Rate = rate > 0.0 ? rate : 0.0;
+	m_IsStarted = false;
+	if (m_Rate > 0.0)
+	{
+		m_Period = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / m_Rate));
+	}
+}
+
+llong RateTimer::Wait()
+{
+	if (m_Rate <= 0.0) return 0;
+
+	Clock::time_point now = Clock::now();
+	if (!m_IsStarted)
+	{
+		m_Next = now;
+		m_IsStarted = true;
+	}
+
+	m_Next += m_Period;
+	llong periods = 1;
+	if (now - m_Next >= m_Period)
+	{
+		// behind by a period or more: skip the missed ticks
+		periods += (now - m_Next) / m_Period;
+		m_Next = now;
+	}
+	SleepUntil(m_Next);
+	return periods;
+}
+
+void RateTimer::SleepUntil(Clock::time_point time)
+{
+#ifdef _WIN32
+	if (m_Timer == NULL)
+	{
+		m_Timer = CreateWaitableTimerExW(NULL, NULL, CREATE_WAITABLE_TIMER_HIGH_RESOLUTION, TIMER_ALL_ACCESS);
+		if (m_Timer == NULL)
+		{
+			m_Timer = CreateWaitableTimerExW(NULL, NULL, 0, TIMER_ALL_ACCESS);
+		}
+	}
+	if (m_Timer != NULL)
+	{
+		Clock::duration remaining = time - Clock::now();
+		if (remaining <= Clock::duration::zero()) return;
+
+		// relative due time, in 100 ns units
+		LARGE_INTEGER dueTime;
+		dueTime.QuadPart = -static_cast<LONGLONG>(
+			std::chrono::duration_cast<std::chrono::nanoseconds>(remaining).count() / 100);
+		if (SetWaitableTimer(m_Timer, &dueTime, 0, NULL, NULL, FALSE))
+		{
+			WaitForSingleObject(m_Timer, INFINITE);
+			return;
+		}
+	}
+#endif // _WIN32
+	std::this_thread::sleep_until(time);
+}
@@ -0,0 +1,67 @@
+////////////////////////////////////////////////////////////////////////////////
+//
+// rate_timer.h
+//
+//   CLCL: CAVELib Compatible Library
+//
+//     Copyright 2015-2019 Shintaro Kawahara(kawahara@jamstec.go.jp).
+//     All rights reserved.
+//
+//   Please read the file "LICENCE.txt" before you use this software.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+#pragma once
+
+#include "../settings.h"
+
+#include <chrono>
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif // WIN32_LEAN_AND_MEAN
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif // NOMINMAX
+#include <windows.h>
+#endif // _WIN32
+
+////////////////////////////////////////////////////////////////////////////////
+//
+// RateTimer: wakes a thread at a fixed rate.
+//
+//   The ticks are on an absolute schedule, so the rate does not drift with
+//   the time the thread spends between two Wait() calls. If the thread falls
+//   more than a period behind, the schedule restarts from now and the missed
+//   periods are counted. On Windows the wait uses a high-resolution waitable
+//   timer (Windows 10 1803 or later; a normal waitable timer otherwise)
+//   instead of Sleep(), whose granularity is about 15 ms.
+//
+////////////////////////////////////////////////////////////////////////////////
+
+class RateTimer {
+public:
+	RateTimer();
+	~RateTimer();
+
+	void   SetRate(double rate); // Hz; 0 disables
+	double rate() const { return m_Rate; }
+
+	// waits for the next tick; returns the number of periods since the
+	// previous call (1 if the caller kept up)
+	llong Wait();
+
+private:
+	typedef std::chrono::steady_clock Clock;
+
+	double m_Rate;
+	Clock::duration   m_Period;
+	Clock::time_point m_Next;
+	bool   m_IsStarted;
+#ifdef _WIN32
+	HANDLE m_Timer;
+#endif // _WIN32
+
+	void SleepUntil(Clock::time_point time);
+};